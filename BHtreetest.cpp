@@ -11,60 +11,458 @@
  */
 
 #include "file.h"
+#include "binary_file.h"
 #include "tree.h"
+#include "direct_sum.h"
+#include "solver.h"
+#include "snapshot_writer.h"
+#include "checkpoint.h"
+#include "snapshot_stream.h"
+#include "vtk_writer.h"
+#include "initial_conditions.h"
+#include "ewald.h"
+#include "tuning.h"
+#include "accuracy_controller.h"
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <memory>
+#include <type_traits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace barnes_hut;
 
 void print_usage(const char* program_name) {
-    std::cout << "Usage: " << program_name << " <filename> <theta> <particles_per_leaf>\n"
-              << "  filename: Input file with particle data\n"
+    std::cout << "Usage: " << program_name << " <filename> <theta> <particles_per_leaf> [options]\n"
+              << "       " << program_name << " <filename> --config <settings> [options]\n"
+              << "       " << program_name << " --restart <checkpoint> [options]\n"
+              << "  filename: Input file with particle data (text or binary, see convert_particles),\n"
+              << "            or <model>:<count> to generate uniform, plummer, hernquist, disk or\n"
+              << "            clustered initial conditions in memory\n"
               << "  theta: Barnes-Hut opening angle (e.g., 0.5)\n"
               << "  particles_per_leaf: Max particles in leaf node (e.g., 10)\n"
+              << "  settings: theta, leaf size, opening criterion and softening written by\n"
+              << "            tune_barnes_hut; later options override them\n"
+              << "\nOptions:\n"
+              << "  --seed <n>              Seed of generated initial conditions [default: 1]\n"
+              << "  --mass <M>              Total mass of generated models [default: 1]\n"
+              << "  --scale <a>             Scale length of generated models [default: 1]\n"
+              << "  --end-time <t>          End time of a generated run [default: 1]\n"
+              << "  --time-step <dt>        Time step of a generated run [default: 0.01]\n"
+              << "  --dim <2|3>             Spatial dimension (quadtree or octree) [default: 3, or binary file's]\n"
+              << "  --periodic <box_size>   Periodic box [0, box_size)^dim with Ewald corrections (3D)\n"
+              << "  --ewald-cache <file>    Ewald table cache [default: ewald_table.bin]\n"
+              << "  --no-ewald              Periodic minimum-image forces only\n"
+              << "  --energy                Track energy, momentum and centre of mass each step\n"
+              << "  --backend <name>        Force backend: auto, tree or direct [default: auto]\n"
+              << "  --mac <name>            Tree opening criterion: geometric, offset or bmax\n"
+              << "                          [default: geometric]\n"
+              << "  --deterministic         Bitwise identical results for any thread count (auto picks\n"
+              << "                          the backend by particle count instead of timing)\n"
+              << "  --accuracy-target <e>   Adapt theta (tree backend) to hold the sampled relative\n"
+              << "                          force error percentile at e [default: off]\n"
+              << "  --accuracy-percentile <q> Error percentile that is controlled [default: 99]\n"
+              << "  --accuracy-interval <n> Steps between error measurements [default: 10]\n"
+              << "  --accuracy-sample <n>   Particles with exact forces per measurement [default: 1000,\n"
+              << "                          100 with --step-budget]\n"
+              << "  --step-budget <s>       Deadline mode: adapt theta (tree backend, 0.2 to 1.0) so each\n"
+              << "                          step takes at most s seconds, and report the sampled force\n"
+              << "                          error set by the other --accuracy options [default: off]\n"
+              << "  --softening <name>      Force law: plummer, spline or none [default: plummer]\n"
+              << "  --softening-length <h>  Softening length [default: 1e-5 plummer, 2.8e-5 spline]\n"
+              << "  --snapshot-format <f>   text (force files), columnar (compressed .bhs), or gnuplot /\n"
+              << "                          gnuplot-float (binary mass, position, velocity .bin records),\n"
+              << "                          or vtu (ParaView .vtu files indexed by a .pvd) [default: text]\n"
+              << "  --pvd <file>            ParaView series index for vtu snapshots [default: snapshots.pvd]\n"
+              << "  --vtu-tree              Also write the tree node boxes with each vtu snapshot\n"
+              << "  --snapshot-fields <l>   Columnar fields: position,velocity,force,potential,id\n"
+              << "                          [default: position,force]\n"
+              << "  --snapshot-tolerance <t> Columnar relative rounding tolerance, 0 = lossless [default: 0]\n"
+              << "  --position-stream <file> Also write positions to a delta-coded stream (.bhss)\n"
+              << "  --stream-interval <n>   Steps between stream frames [default: 1]\n"
+              << "  --stream-quantum <q>    Stream position resolution [default: 1e-6]\n"
+              << "  --stream-keyframes <n>  Frames per keyframe [default: 32]\n"
+              << "  --checkpoint <file>     Write a restart checkpoint to file during the run\n"
+              << "  --checkpoint-interval <n> Steps between checkpoints [default: 100]\n"
+              << "  --checkpoint-mode <m>   sync, or fork (a child process writes while the run continues)\n"
+              << "                          [default: sync]\n"
+              << "  --restart <checkpoint>  Resume a run exactly; particles, configuration and\n"
+              << "                          force setup come from the checkpoint\n"
               << "\nExample:\n"
-              << "  " << program_name << " data.dat 0.5 10\n";
+              << "  " << program_name << " data.dat 0.5 10\n"
+              << "  " << program_name << " data.dat 0.5 10 --periodic 10.0\n"
+              << "  " << program_name << " plummer:100000 0.5 10 --seed 7\n"
+              << "  " << program_name << " data.dat 0.5 10 --checkpoint run.bhc\n"
+              << "  " << program_name << " data.dat --config tuned.cfg\n"
+              << "  " << program_name << " --restart run.bhc --checkpoint run.bhc\n";
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        print_usage(argv[0]);
-        return 1;
+enum class SnapshotFormat {
+    Text,
+    Columnar,
+    Gnuplot,
+    GnuplotFloat,
+    Vtu
+};
+
+// Command-line options
+struct SimulationOptions {
+    std::string filename;
+    std::optional<InitialConditions> generate;  // Instead of reading filename
+    SimulationConfig generated_config;          // Times of a generated run
+    Real theta = 0.5;
+    OpeningCriterion opening_criterion = OpeningCriterion::Geometric;
+    Index particles_per_leaf = 1;
+    int dimension = NDIM;
+    Real box_size = 0.0;
+    std::string ewald_cache = "ewald_table.bin";
+    bool use_ewald = true;
+    bool track_energy = false;
+    std::string backend_name = "auto";
+    bool deterministic = false;
+    std::string softening = "plummer";
+    Real softening_length = -1.0;  // < 0: the policy's default
+    SnapshotFormat snapshot_format = SnapshotFormat::Text;
+    ColumnSnapshotOptions snapshot;
+    std::string pvd_file = "snapshots.pvd";
+    bool vtu_tree = false;              // Tree node boxes with vtu snapshots
+    std::string position_stream;        // Empty: no position stream
+    Index stream_interval = 1;
+    SnapshotStreamOptions stream;
+    std::string checkpoint_file;        // Empty: no checkpoints
+    Index checkpoint_interval = 100;
+    bool fork_checkpoints = false;
+    std::string restart_file;           // Empty: start from filename
+    std::optional<AccuracyControlOptions> accuracy;  // Adaptive theta
+    double step_budget = 0.0;           // Seconds per step, 0: fixed theta
+    std::optional<AccuracyControlOptions> error_estimate;  // Sampled force error in deadline mode
+};
+
+// Advance the particles from state.time to config.end_time with any force
+// backend, writing ten snapshots in the background and checkpoints if asked.
+// A tree solver may come with an AccuracyController that adapts its theta.
+// Returns the number of steps taken.
+template <NBodySolver Solver, typename Accuracy = std::nullptr_t>
+Index run_simulation(Solver& solver, std::vector<typename Solver::Particle>& particles,
+                     CheckpointState& state, const SimulationOptions& options, Accuracy accuracy = nullptr) {
+    const SimulationConfig& config = state.config;
+    const bool track_energy = options.track_energy;
+    const bool checkpointing = !options.checkpoint_file.empty();
+
+    const Real output_interval = (config.end_time - config.start_time) / 10.0;
+    const Index first_step = state.step;
+
+    // Listed by the snapshot writer's thread once a .vtu is written, so it
+    // outlives the writer
+    PvdSeries pvd(options.pvd_file);
+    if (options.snapshot_format == SnapshotFormat::Vtu && state.step > 0) {
+        pvd.resume(state.time);
     }
 
-    const std::string filename = argv[1];
-    const Real theta = std::stod(argv[2]);
-    const Index particles_per_leaf = std::stoull(argv[3]);
+    AsyncSnapshotWriter<Solver::dimension> snapshot_writer;
+    ForkedCheckpointWriter forked_checkpoints;
 
-    std::cout << "=== Modern Barnes-Hut N-Body Simulation ===\n\n";
+    // Node boxes come from the tree the step built, so only tree backends have them
+    constexpr bool has_tree = requires(const Solver& tree) { tree.root(); };
+    if (options.vtu_tree && !has_tree) {
+        std::cerr << "Warning: --vtu-tree needs the tree backend, no node boxes written\n";
+    }
+
+    std::optional<SnapshotStreamWriter<Solver::dimension>> position_stream;
+    double stream_seconds = 0.0;
+    auto write_stream_frame = [&] {
+        Timer stream_timer;
+        if (position_stream && !position_stream->write_frame(particles, state.time)) {
+            position_stream.reset();
+        }
+        stream_seconds += stream_timer.elapsed();
+    };
 
-    // Read configuration
-    auto config_opt = read_config_file(filename);
-    if (!config_opt) {
-        std::cerr << "Error: Failed to read configuration from " << filename << "\n";
-        return 2;
+    // A resumed run continues its stream after the last frame the checkpoint
+    // had reached, rather than replacing it
+    if (!options.position_stream.empty()) {
+        position_stream = (state.step > 0)
+            ? SnapshotStreamWriter<Solver::dimension>::resume(options.position_stream, particles.size(),
+                                                              options.stream, state.time)
+            : SnapshotStreamWriter<Solver::dimension>::create(options.position_stream, particles.size(),
+                                                              options.stream);
+        if (!position_stream) {
+            return 0;
+        }
+        if (position_stream->frame_count() == 0) {
+            write_stream_frame();
+        }
+        else {
+            std::cout << "Continuing position stream " << options.position_stream << " after frame "
+                      << position_stream->frame_count() - 1 << "\n";
+        }
     }
 
-    auto config = *config_opt;
-    config.theta = theta;
-    config.particles_per_leaf = particles_per_leaf;
+    // Simulation loop
+    while (state.time < config.end_time) {
+        constexpr bool controlled = !std::is_null_pointer_v<Accuracy>;
+        bool measuring = false;
+        if constexpr (controlled) {
+            measuring = accuracy->due(state.step);
+            if (measuring) {
+                accuracy->sample(particles, state.step);
+            }
+        }
+
+        // Perform one simulation step
+        solver.simulation_step();
+
+        state.time += config.time_step;
+        state.step++;
+
+        // Print statistics
+        const auto& stats = solver.get_statistics();
+
+        if constexpr (ENABLE_TIMING) {
+            std::cout << "Step " << std::setw(4) << state.step
+                      << " | Time: " << std::fixed << std::setprecision(3) << state.time
+                      << " | Load: " << std::setprecision(4) << stats.time_load << "s"
+                      << " | Upward: " << stats.time_upward << "s"
+                      << " | Force: " << stats.time_force << "s"
+                      << " | Total: " << stats.time_total << "s"
+                      << " | Direct: " << stats.direct_force_count
+                      << " | P-C: " << stats.particle_cell_interactions;
+            if (stats.step_budget > 0.0) {
+                std::cout << " | Theta: " << stats.theta << " (budget " << stats.step_budget << "s)";
+                if (stats.time_error > 0.0) {
+                    std::cout << " | p" << std::defaultfloat << options.error_estimate->percentile
+                              << " error: " << std::scientific << std::setprecision(3) << stats.force_error
+                              << std::fixed;
+                }
+            }
+            std::cout << "\n";
+        }
+
+        if (track_energy) {
+            // A run resumed from a checkpoint without energies starts a new reference
+            if (state.step == 1 || state.initial_energy == 0.0) {
+                state.initial_energy = stats.total_energy;
+            }
+
+            std::cout << "           | E: " << std::scientific << std::setprecision(6) << stats.total_energy
+                      << " | dE/E0: " << (stats.total_energy - state.initial_energy) / std::abs(state.initial_energy)
+                      << " | |P|: " << stats.linear_momentum.magnitude()
+                      << " | |L|: " << stats.angular_momentum.magnitude()
+                      << std::fixed << "\n";
+        }
+
+        // The next steps use the adapted theta (and checkpoints record it)
+        if constexpr (controlled) {
+            if (measuring) {
+                const Real theta = accuracy->adjust(particles, state.config.theta);
+                std::cout << "           | p" << std::defaultfloat << accuracy->options().percentile
+                          << " force error: " << std::scientific << std::setprecision(3) << accuracy->last_error()
+                          << " | theta: " << std::fixed << state.config.theta << " -> " << theta << "\n";
+                state.config.theta = theta;
+                solver.set_theta(theta);
+            }
+        }
+
+        // Deadline mode moves theta inside the tree
+        if constexpr (has_tree) {
+            state.config.theta = solver.theta();
+        }
+
+        // Write snapshot if needed (the writer thread formats it while we continue)
+        if (state.time >= state.next_output_time) {
+            if (options.snapshot_format == SnapshotFormat::Columnar) {
+                snapshot_writer.submit_columns(
+                    particles,
+                    snapshot_filename("snapshot", particles.size(), config.theta,
+                                      config.particles_per_leaf, state.snapshot_number++, ".bhs"),
+                    solver.get_statistics_string(),
+                    state.time,
+                    options.snapshot
+                );
+            }
+            else if (options.snapshot_format == SnapshotFormat::Vtu) {
+                const std::string particle_file = snapshot_filename("snapVTU", particles.size(), config.theta,
+                                                                    config.particles_per_leaf,
+                                                                    state.snapshot_number, ".vtu");
+
+                // The tree is cleared below, so its boxes are written now
+                std::string tree_file;
+                if constexpr (has_tree) {
+                    if (options.vtu_tree) {
+                        tree_file = snapshot_filename("treeVTU", particles.size(), config.theta,
+                                                      config.particles_per_leaf, state.snapshot_number, ".vtu");
+                        if (!write_vtu_tree(tree_file, solver.root())) {
+                            tree_file.clear();
+                        }
+                    }
+                }
+
+                // Both parts are listed only once the particles are on disk,
+                // so the index never names a missing or partial file
+                snapshot_writer.submit_vtu(particles, particle_file,
+                    [&pvd, time = state.time, particle_file, tree_file] {
+                        pvd.add(time, particle_file);
+                        if (!tree_file.empty()) {
+                            pvd.add(time, tree_file, 1);
+                        }
+                    });
+                state.snapshot_number++;
+            }
+            else if (options.snapshot_format != SnapshotFormat::Text) {
+                snapshot_writer.submit_gnuplot(
+                    particles,
+                    snapshot_filename("snapPV", particles.size(), config.theta,
+                                      config.particles_per_leaf, state.snapshot_number++, ".bin"),
+                    options.snapshot_format == SnapshotFormat::GnuplotFloat
+                );
+            }
+            else {
+                snapshot_writer.submit_forces(
+                    particles,
+                    solver.get_statistics_string(),
+                    config.theta,
+                    config.particles_per_leaf,
+                    state.snapshot_number++
+                );
+            }
 
-    // Read particle data
-    auto particles_opt = read_particle_file(filename, config);
+            state.next_output_time += output_interval;
+        }
+
+        if (state.step % options.stream_interval == 0) {
+            write_stream_frame();
+        }
+
+        // Clear tree for next iteration
+        solver.clear_tree();
+
+        forked_checkpoints.poll();
+
+        if (checkpointing && (state.step % options.checkpoint_interval == 0 || state.time >= config.end_time)) {
+            const std::span<const typename Solver::Particle> checkpoint_particles(particles);
+            if (options.fork_checkpoints) {
+                forked_checkpoints.submit(options.checkpoint_file, state, checkpoint_particles);
+            }
+            else {
+                Timer checkpoint_timer;
+                if (write_checkpoint(options.checkpoint_file, state, checkpoint_particles)) {
+                    std::cout << "Wrote checkpoint at step " << state.step << " to: " << options.checkpoint_file
+                              << " (" << checkpoint_timer.elapsed() << "s)\n";
+                }
+            }
+        }
+    }
+
+    if (position_stream) {
+        const double raw_bytes = static_cast<double>(position_stream->frame_count() * particles.size() *
+                                                     Solver::dimension * sizeof(Real));
+        std::cout << "Wrote " << position_stream->frame_count() << " frames to: " << options.position_stream
+                  << " (" << position_stream->bytes_written() << " bytes, "
+                  << raw_bytes / static_cast<double>(position_stream->bytes_written())
+                  << "x smaller than raw, " << stream_seconds << "s)\n";
+    }
+
+    if (options.fork_checkpoints && checkpointing) {
+        forked_checkpoints.wait();
+        std::cout << "Checkpoint forks took " << forked_checkpoints.fork_seconds() << "s, stalled for "
+                  << forked_checkpoints.stall_seconds() << "s\n";
+    }
+
+    if (!snapshot_writer.flush()) {
+        std::cerr << "Error: Failed to write snapshots\n";
+    }
+    std::cout << "Snapshot writer stalled for " << snapshot_writer.stall_seconds() << "s\n";
+
+    return state.step - first_step;
+}
+
+// Set up and run the simulation in Dim dimensions with the given force law
+template <int Dim, typename Softening>
+int run(const SimulationOptions& options) {
+    const std::string& filename = options.filename;
+    const Real theta = options.theta;
+    const Index particles_per_leaf = options.particles_per_leaf;
+    const bool use_ewald = options.use_ewald;
+    // Potentials are needed for energy tracking and for potential snapshots
+    const bool compute_potential = options.track_energy ||
+                                   (options.snapshot_format == SnapshotFormat::Columnar && options.snapshot.potential);
+    const Real softening_length = (options.softening_length >= 0.0)
+                                  ? options.softening_length : Softening::default_length;
+
+    const bool restarting = !options.restart_file.empty();
+    const std::string& input = restarting ? options.restart_file : filename;
+
+    // Read configuration (or the whole run state of a checkpoint)
+    CheckpointState state;
+    if (restarting) {
+        auto state_opt = read_checkpoint_state(input);
+        if (!state_opt) {
+            std::cerr << "Error: Failed to read checkpoint " << input << "\n";
+            return 2;
+        }
+        state = std::move(*state_opt);
+    }
+    else {
+        auto config_opt = options.generate ? std::optional(options.generated_config) : read_config_file(filename);
+        if (!config_opt) {
+            std::cerr << "Error: Failed to read configuration from " << filename << "\n";
+            return 2;
+        }
+
+        state.config = *config_opt;
+        state.config.theta = theta;
+        state.config.particles_per_leaf = particles_per_leaf;
+        if (options.box_size > 0.0) {
+            state.config.box_size = options.box_size;
+        }
+        state.dimension = Dim;
+        state.softening = Softening::name;
+        state.softening_length = softening_length;
+        state.use_ewald = use_ewald;
+        state.opening_criterion = options.opening_criterion;
+        state.time = state.config.start_time;
+        state.next_output_time = state.config.start_time + (state.config.end_time - state.config.start_time) / 10.0;
+    }
+    const SimulationConfig& config = state.config;
+
+    // Read (or generate) particle data
+    Timer input_timer;
+    auto particles_opt = restarting         ? read_checkpoint_particles<Dim>(input)
+                         : options.generate ? std::optional(generate_particles<Dim>(*options.generate))
+                                            : read_particle_file<Dim>(filename, config);
     if (!particles_opt) {
-        std::cerr << "Error: Failed to read particle data from " << filename << "\n";
+        std::cerr << "Error: Failed to read particle data from " << input << "\n";
         return 3;
     }
 
     auto particles = std::move(*particles_opt);
 
+    if (options.generate && !restarting) {
+        std::cout << "Generated " << particles.size() << " " << to_string(options.generate->model)
+                  << " particles (seed " << options.generate->seed << ", " << input_timer.elapsed() << "s)\n";
+    }
+
+    if (restarting) {
+        std::cout << "Resuming from checkpoint " << input << " at step " << state.step
+                  << " (t=" << state.time << ")\n";
+    }
+
     std::cout << "Starting Barnes-Hut simulation for " << particles.size() << " particles\n"
               << "  Time: " << config.start_time << " -> " << config.end_time
               << " (dt=" << config.time_step << ")\n"
-              << "  Theta: " << theta << "\n"
-              << "  Max particles per leaf: " << particles_per_leaf << "\n";
+              << "  Theta: " << theta << " (" << to_string(state.opening_criterion) << " opening criterion)\n"
+              << "  Max particles per leaf: " << particles_per_leaf << "\n"
+              << "  Dimension: " << Dim << "D (" << SUBCELLS<Dim> << "-way tree)\n"
+              << "  Softening: " << Softening::name << " (h=" << softening_length << ")\n";
+
+    if (config.box_size > 0.0) {
+        std::cout << "  Periodic box: " << config.box_size
+                  << (use_ewald && Dim == 3 ? " (Ewald corrections)" : " (minimum image only)") << "\n";
+    }
 
 #ifdef _OPENMP
     #pragma omp parallel
@@ -76,67 +474,433 @@ int main(int argc, char* argv[]) {
     std::cout << "  OpenMP not enabled (serial execution)\n";
 #endif
 
-    std::cout << "\n";
+    // Choose the force backend; only the tree supports periodic boundaries
+    ForceBackend backend = ForceBackend::Tree;
+    if (options.backend_name == "direct") {
+        if (config.box_size > 0.0) {
+            std::cerr << "Error: The direct backend does not support periodic boundaries\n";
+            return 1;
+        }
+        backend = ForceBackend::Direct;
+    }
+    else if (options.backend_name == "auto" && config.box_size <= 0.0) {
+        const auto selection = select_force_backend<Dim, Softening>(
+            particles, theta, particles_per_leaf, softening_length, state.opening_criterion,
+            !options.deterministic);
+        backend = selection.backend;
+        if (selection.measured) {
+            std::cout << "  Measured force time: tree " << selection.tree_seconds
+                      << "s, direct " << selection.direct_seconds << "s\n";
+        }
+    }
 
-    // Create Barnes-Hut tree
-    BarnesHutTree tree(particles, config.time_step, theta, particles_per_leaf);
+    if (options.step_budget > 0.0 && backend != ForceBackend::Tree) {
+        std::cerr << "Warning: The step budget adapts the tree's theta, ignored with the direct backend\n";
+    }
+    else if (options.step_budget > 0.0 && state.opening_criterion == OpeningCriterion::Geometric) {
+        std::cout << "  Deadline mode keeps theta <= " << 1.0 / std::sqrt(static_cast<Real>(Dim))
+                  << " with the geometric criterion (larger cells could contain the particle); --mac bmax allows 1.0\n";
+    }
+    if (options.error_estimate && backend == ForceBackend::Tree) {
+        if (config.box_size > 0.0) {
+            std::cout << "  Deadline mode: no force error estimate with periodic boundaries\n";
+        }
+        else {
+            std::cout << "  Deadline mode: p" << options.error_estimate->percentile << " force error estimated every "
+                      << options.error_estimate->interval << " steps on " << options.error_estimate->sample
+                      << " particles\n";
+        }
+    }
 
-    // Simulation loop
-    Index step = 0;
-    Real current_time = config.start_time;
+    if (options.accuracy) {
+        if (config.box_size > 0.0) {
+            std::cerr << "Error: Accuracy control needs open boundaries (exact forces ignore periodic images)\n";
+            return 1;
+        }
+        if (backend != ForceBackend::Tree) {
+            std::cerr << "Warning: Accuracy control adapts the tree's theta, ignored with the direct backend\n";
+        }
+        else {
+            std::cout << "  Accuracy control: p" << options.accuracy->percentile << " force error "
+                      << options.accuracy->target << ", every " << options.accuracy->interval << " steps on "
+                      << options.accuracy->sample << " particles\n";
+        }
+    }
 
-    const Real output_interval = (config.end_time - config.start_time) / 10.0;
-    Real next_output_time = config.start_time + output_interval;
+    std::cout << "  Force backend: " << to_string(backend)
+              << (options.deterministic ? " (deterministic)" : "") << "\n\n";
+    state.backend = backend;
+
+    std::shared_ptr<const EwaldTable> ewald;
+    if (config.box_size > 0.0 && use_ewald && Dim == 3) {
+        ewald = EwaldTable::load_or_compute(options.ewald_cache);
+    }
 
     Timer simulation_timer;
 
-    while (current_time < config.end_time) {
-        // Perform one simulation step
-        tree.simulation_step();
+    Index steps = 0;
+    if (backend == ForceBackend::Direct) {
+        BasicDirectSummation<Dim, Softening> direct(particles, config.time_step);
+        direct.set_softening_length(softening_length);
+        direct.set_compute_potential(compute_potential);
+        direct.set_deterministic(options.deterministic);
+        steps = run_simulation(direct, particles, state, options);
+    }
+    else {
+        BasicBarnesHutTree<Dim, Softening> tree(particles, config.time_step, theta, particles_per_leaf);
+        tree.set_softening_length(softening_length);
+        tree.set_opening_criterion(state.opening_criterion);
 
-        current_time += config.time_step;
-        step++;
+        if (config.box_size > 0.0) {
+            tree.enable_periodic_boundaries(config.box_size, ewald);
+        }
 
-        // Print statistics
-        const auto& stats = tree.get_statistics();
+        tree.set_compute_potential(compute_potential);
+        tree.set_step_budget(options.step_budget);
+        if (options.error_estimate) {
+            tree.set_error_sampling(options.error_estimate->interval, options.error_estimate->sample,
+                                    options.error_estimate->percentile);
+        }
+        if (options.accuracy) {
+            AccuracyController<Dim, Softening> accuracy(*options.accuracy, softening_length);
+            steps = run_simulation(tree, particles, state, options, &accuracy);
+            std::cout << "Accuracy control: " << accuracy.measurements() << " measurements, "
+                      << accuracy.seconds() << "s, final theta " << state.config.theta << "\n";
+        }
+        else {
+            steps = run_simulation(tree, particles, state, options);
+        }
+    }
 
-        if constexpr (ENABLE_TIMING) {
-            std::cout << "Step " << std::setw(4) << step
-                      << " | Time: " << std::fixed << std::setprecision(3) << current_time
-                      << " | Load: " << std::setprecision(4) << stats.time_load << "s"
-                      << " | Upward: " << stats.time_upward << "s"
-                      << " | Force: " << stats.time_force << "s"
-                      << " | Total: " << stats.time_total << "s"
-                      << " | Direct: " << stats.direct_force_count
-                      << " | P-C: " << stats.particle_cell_interactions
-                      << "\n";
+    const double total_simulation_time = simulation_timer.elapsed();
+
+    std::cout << "\n=== Simulation Complete ===\n"
+              << "Total steps: " << steps << "\n"
+              << "Total time: " << total_simulation_time << " seconds\n"
+              << "Average time per step: " << (steps > 0 ? total_simulation_time / steps : 0.0) << " seconds\n";
+
+    return 0;
+}
+
+// Pick the force-law instantiation named on the command line
+template <int Dim>
+int run_with_softening(const SimulationOptions& options) {
+    if (options.softening == SplineSoftening::name) {
+        return run<Dim, SplineSoftening>(options);
+    }
+    if (options.softening == NoSoftening::name) {
+        return run<Dim, NoSoftening>(options);
+    }
+    return run<Dim, PlummerSoftening>(options);
+}
+
+int main(int argc, char* argv[]) {
+    const bool restarting = (argc >= 3 && std::string(argv[1]) == "--restart");
+    if (argc < 4 && !restarting) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    SimulationOptions options;
+    bool dimension_given = false;
+    bool accuracy_target_given = false;
+    bool accuracy_sample_given = false;
+    int first_option = 4;
+    if (restarting) {
+        options.restart_file = argv[2];
+        first_option = 3;
+    }
+    else {
+        options.filename = argv[1];
+        if (std::string(argv[2]) == "--config") {
+            const auto settings = read_tuned_settings(argv[3]);
+            if (!settings) {
+                return 1;
+            }
+            options.theta = settings->theta;
+            options.particles_per_leaf = settings->particles_per_leaf;
+            options.opening_criterion = settings->opening_criterion;
+            options.softening = settings->softening;
+            options.softening_length = settings->softening_length;
+            options.backend_name = settings->backend;
+        }
+        else {
+            options.theta = std::stod(argv[2]);
+            options.particles_per_leaf = std::stoull(argv[3]);
+        }
+
+        // <model>:<count> generates the initial conditions instead of reading a file
+        const auto colon = options.filename.find(':');
+        if (colon != std::string::npos) {
+            if (const auto model = parse_initial_model(std::string_view(options.filename).substr(0, colon))) {
+                options.generate = InitialConditions{};
+                options.generate->model = *model;
+                options.generate->particle_count = std::stoull(options.filename.substr(colon + 1));
+                options.generated_config.end_time = 1.0;
+                options.generated_config.time_step = 0.01;
+            }
         }
+    }
 
-        // Write snapshot if needed
-        if (current_time >= next_output_time) {
-            std::ostringstream message;
-            message << tree.get_statistics_string();
+    for (int i = first_option; i < argc; ++i) {
+        const std::string arg = argv[i];
 
-            write_particle_forces(
-                particles,
-                message.str(),
-                theta,
-                particles_per_leaf
-            );
+        if (arg == "--periodic" && i + 1 < argc) {
+            options.box_size = std::stod(argv[++i]);
+            if (options.box_size <= 0.0) {
+                std::cerr << "Error: Periodic box size must be > 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--ewald-cache" && i + 1 < argc) {
+            options.ewald_cache = argv[++i];
+        }
+        else if (arg == "--no-ewald") {
+            options.use_ewald = false;
+        }
+        else if (arg == "--energy") {
+            options.track_energy = true;
+        }
+        else if (arg == "--deterministic") {
+            options.deterministic = true;
+        }
+        else if ((arg == "--seed" || arg == "--mass" || arg == "--scale" ||
+                  arg == "--end-time" || arg == "--time-step") && i + 1 < argc) {
+            if (!options.generate) {
+                std::cerr << "Error: " << arg << " applies to generated initial conditions (<model>:<count>)\n";
+                return 1;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--seed") {
+                options.generate->seed = std::stoull(value);
+            }
+            else if (arg == "--mass") {
+                options.generate->total_mass = std::stod(value);
+            }
+            else if (arg == "--scale") {
+                options.generate->scale_length = std::stod(value);
+            }
+            else if (arg == "--end-time") {
+                options.generated_config.end_time = std::stod(value);
+            }
+            else {
+                options.generated_config.time_step = std::stod(value);
+            }
+        }
+        else if (arg == "--dim" && i + 1 < argc) {
+            options.dimension = std::stoi(argv[++i]);
+            dimension_given = true;
+            if (options.dimension != 2 && options.dimension != 3) {
+                std::cerr << "Error: Dimension must be 2 or 3\n";
+                return 1;
+            }
+        }
+        else if (arg == "--softening" && i + 1 < argc) {
+            options.softening = argv[++i];
+            if (options.softening != PlummerSoftening::name &&
+                options.softening != SplineSoftening::name &&
+                options.softening != NoSoftening::name) {
+                std::cerr << "Error: Unknown softening: " << options.softening << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--softening-length" && i + 1 < argc) {
+            options.softening_length = std::stod(argv[++i]);
+            if (options.softening_length < 0.0) {
+                std::cerr << "Error: Softening length must be >= 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--snapshot-format" && i + 1 < argc) {
+            const std::string format = argv[++i];
+            if (format == "text") {
+                options.snapshot_format = SnapshotFormat::Text;
+            }
+            else if (format == "columnar") {
+                options.snapshot_format = SnapshotFormat::Columnar;
+            }
+            else if (format == "gnuplot") {
+                options.snapshot_format = SnapshotFormat::Gnuplot;
+            }
+            else if (format == "gnuplot-float") {
+                options.snapshot_format = SnapshotFormat::GnuplotFloat;
+            }
+            else if (format == "vtu") {
+                options.snapshot_format = SnapshotFormat::Vtu;
+            }
+            else {
+                std::cerr << "Error: Unknown snapshot format: " << format << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--pvd" && i + 1 < argc) {
+            options.pvd_file = argv[++i];
+        }
+        else if (arg == "--vtu-tree") {
+            options.vtu_tree = true;
+        }
+        else if (arg == "--snapshot-fields" && i + 1 < argc) {
+            if (!parse_snapshot_fields(argv[++i], options.snapshot)) {
+                return 1;
+            }
+        }
+        else if (arg == "--snapshot-tolerance" && i + 1 < argc) {
+            options.snapshot.tolerance = std::stod(argv[++i]);
+            if (options.snapshot.tolerance < 0.0) {
+                std::cerr << "Error: Snapshot tolerance must be >= 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--position-stream" && i + 1 < argc) {
+            options.position_stream = argv[++i];
+        }
+        else if (arg == "--stream-interval" && i + 1 < argc) {
+            options.stream_interval = std::stoull(argv[++i]);
+            if (options.stream_interval == 0) {
+                std::cerr << "Error: Stream interval must be > 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--stream-quantum" && i + 1 < argc) {
+            options.stream.quantum = std::stod(argv[++i]);
+            if (!(options.stream.quantum > 0.0)) {
+                std::cerr << "Error: Stream quantum must be > 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--stream-keyframes" && i + 1 < argc) {
+            options.stream.keyframe_interval = std::stoull(argv[++i]);
+            if (options.stream.keyframe_interval == 0) {
+                std::cerr << "Error: Keyframe interval must be > 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc) {
+            options.checkpoint_file = argv[++i];
+        }
+        else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+            options.checkpoint_interval = std::stoull(argv[++i]);
+            if (options.checkpoint_interval == 0) {
+                std::cerr << "Error: Checkpoint interval must be > 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--checkpoint-mode" && i + 1 < argc) {
+            const std::string mode = argv[++i];
+            if (mode != "sync" && mode != "fork") {
+                std::cerr << "Error: Unknown checkpoint mode: " << mode << "\n";
+                return 1;
+            }
+            options.fork_checkpoints = (mode == "fork");
+        }
+        else if (arg == "--mac" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            const auto criterion = parse_opening_criterion(name);
+            if (!criterion) {
+                std::cerr << "Error: Unknown opening criterion: " << name << "\n";
+                return 1;
+            }
+            options.opening_criterion = *criterion;
+        }
+        else if ((arg == "--accuracy-target" || arg == "--accuracy-percentile" ||
+                  arg == "--accuracy-interval" || arg == "--accuracy-sample") && i + 1 < argc) {
+            if (!options.accuracy) {
+                options.accuracy = AccuracyControlOptions{};
+            }
+            const std::string value = argv[++i];
+            bool valid = true;
+            if (arg == "--accuracy-target") {
+                accuracy_target_given = true;
+                options.accuracy->target = std::stod(value);
+                valid = options.accuracy->target > 0.0;
+            }
+            else if (arg == "--accuracy-percentile") {
+                options.accuracy->percentile = std::stod(value);
+                valid = options.accuracy->percentile > 0.0 && options.accuracy->percentile <= 100.0;
+            }
+            else if (arg == "--accuracy-interval") {
+                options.accuracy->interval = std::stoull(value);
+                valid = options.accuracy->interval > 0;
+            }
+            else {
+                accuracy_sample_given = true;
+                options.accuracy->sample = std::stoull(value);
+                valid = options.accuracy->sample > 0;
+            }
+            if (!valid) {
+                std::cerr << "Error: Invalid value for " << arg << ": " << value << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--step-budget" && i + 1 < argc) {
+            options.step_budget = std::stod(argv[++i]);
+            if (!(options.step_budget > 0.0)) {
+                std::cerr << "Error: Step budget must be > 0\n";
+                return 1;
+            }
+        }
+        else if (arg == "--backend" && i + 1 < argc) {
+            options.backend_name = argv[++i];
+            if (options.backend_name != "auto" && options.backend_name != "tree" && options.backend_name != "direct") {
+                std::cerr << "Error: Unknown backend: " << options.backend_name << "\n";
+                return 1;
+            }
+        }
+        else {
+            std::cerr << "Error: Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
 
-            next_output_time += output_interval;
+    if (options.step_budget > 0.0) {
+        if (accuracy_target_given) {
+            std::cerr << "Error: --step-budget and --accuracy-target both adapt theta; use one\n";
+            return 1;
+        }
+        // The other --accuracy options set up the error estimate of deadline
+        // mode, with a smaller default sample: it is paid for in wall time
+        options.error_estimate = options.accuracy.value_or(AccuracyControlOptions{});
+        if (!accuracy_sample_given) {
+            options.error_estimate->sample = 100;
         }
+        options.accuracy.reset();
+    }
 
-        // Clear tree for next iteration
-        tree.clear_tree();
+    // A checkpoint fixes everything that determines the trajectory
+    if (restarting) {
+        const auto state = read_checkpoint_state(options.restart_file);
+        if (!state) {
+            return 2;
+        }
+        options.dimension = state->dimension;
+        options.theta = state->config.theta;
+        options.particles_per_leaf = state->config.particles_per_leaf;
+        options.box_size = state->config.box_size;
+        options.softening = state->softening;
+        options.softening_length = state->softening_length;
+        options.backend_name = to_string(state->backend);
+        options.opening_criterion = state->opening_criterion;
+        options.use_ewald = state->use_ewald;
+    }
+    // Binary particle files record their dimension
+    else if (!dimension_given && is_binary_particle_file(options.filename)) {
+        if (const auto file = BinaryParticleFile::open(options.filename)) {
+            options.dimension = file->dimension();
+        }
     }
 
-    const double total_simulation_time = simulation_timer.elapsed();
+    if (options.generate) {
+        options.generated_config.particle_count = options.generate->particle_count;
+        if (!options.generated_config.is_valid() ||
+            !(options.generate->total_mass > 0.0) || !(options.generate->scale_length > 0.0)) {
+            std::cerr << "Error: Invalid generated run: need count > 0, end time > 0, time step > 0, "
+                         "mass > 0, scale > 0\n";
+            return 1;
+        }
+    }
 
-    std::cout << "\n=== Simulation Complete ===\n"
-              << "Total steps: " << step << "\n"
-              << "Total time: " << total_simulation_time << " seconds\n"
-              << "Average time per step: " << (total_simulation_time / step) << " seconds\n";
+    std::cout << "=== Modern Barnes-Hut N-Body Simulation ===\n\n";
 
-    return 0;
+    return (options.dimension == 2) ? run_with_softening<2>(options) : run_with_softening<3>(options);
 }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "particle.h"
+#include "softening.h"
+#include "stdinc.h"
+#include <algorithm>
+#include <span>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+// Force accuracy measurement shared by bench_accuracy and tune_barnes_hut
+
+// count evenly spaced indices of n particles, all if count is 0 (the
+// generators and input files do not order particles by position)
+[[nodiscard]] inline std::vector<Index> sample_targets(Index n, Index count) {
+    const Index sampled = (count == 0) ? n : std::min(count, n);
+    std::vector<Index> targets(sampled);
+    for (Index k = 0; k < sampled; ++k) {
+        targets[k] = k * n / sampled;
+    }
+    return targets;
+}
+
+// Exact forces on particles[targets[k]] from all other particles: the tree's
+// force law per pair (with per-particle lengths where the policy has them),
+// summed in long double
+template <int Dim, typename Softening>
+[[nodiscard]] std::vector<BasicVector<Dim>> reference_forces(std::span<const BasicParticle<Dim>> particles,
+                                                             const std::vector<Index>& targets,
+                                                             Real softening_length) {
+    std::vector<BasicVector<Dim>> forces(targets.size());
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 16)
+    #endif
+    for (Index k = 0; k < targets.size(); ++k) {
+        const auto& target = particles[targets[k]];
+        long double sum[Dim] = {};
+
+        for (Index j = 0; j < particles.size(); ++j) {
+            if (j == targets[k]) {
+                continue;
+            }
+            const auto r_vec = target.position() - particles[j].position();
+            Real length = softening_length;
+            if constexpr (Softening::per_particle) {
+                length = std::max({softening_length, target.softening(), particles[j].softening()});
+            }
+            const Real factor = Softening::force(r_vec.squared_magnitude(), length);
+            const long double scale = static_cast<long double>(particles[j].mass()) * factor;
+            for (int dim = 0; dim < Dim; ++dim) {
+                sum[dim] -= scale * r_vec[dim];
+            }
+        }
+
+        for (int dim = 0; dim < Dim; ++dim) {
+            forces[k][dim] = static_cast<Real>(static_cast<long double>(GRAVITY) * target.mass() * sum[dim]);
+        }
+    }
+    return forces;
+}
+
+// |F - F_exact| / |F_exact| of particles[targets[k]] against exact[k], sorted
+template <int Dim>
+[[nodiscard]] std::vector<double> relative_force_errors(std::span<const BasicParticle<Dim>> particles,
+                                                        const std::vector<Index>& targets,
+                                                        const std::vector<BasicVector<Dim>>& exact) {
+    std::vector<double> errors(targets.size());
+    for (Index k = 0; k < targets.size(); ++k) {
+        const Real exact_magnitude = exact[k].magnitude();
+        const Real difference = (particles[targets[k]].force() - exact[k]).magnitude();
+        errors[k] = exact_magnitude > 0.0 ? difference / exact_magnitude : difference;
+    }
+    std::sort(errors.begin(), errors.end());
+    return errors;
+}
+
+} // namespace barnes_hut
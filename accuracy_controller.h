@@ -0,0 +1,105 @@
+#pragma once
+
+#include "accuracy.h"
+#include "benchmark.h"
+#include "particle.h"
+#include "stdinc.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace barnes_hut {
+
+struct AccuracyControlOptions {
+    double target = 0.01;      // Relative force error to hold
+    double percentile = 99.0;  // Of the sampled errors
+    Index interval = 10;       // Steps between measurements
+    Index sample = 1000;       // Particles measured
+    Real min_theta = 0.1;
+    Real max_theta = 1.2;
+    double tolerance = 0.2;    // No change while the error is within this fraction of the target
+    std::uint64_t seed = 1;
+};
+
+// Closed-loop control of the opening angle. Every interval steps, exact
+// forces on a random sample of particles measure the error of the tree
+// forces, and theta is scaled towards the value that brings the error
+// percentile to the target. A measured step goes:
+//   sample(particles, step)   exact forces at the positions the step sees
+//   tree.simulation_step()
+//   adjust(particles, theta)  compare, return the theta for the next steps
+// The sample depends only on the seed and the step, so a resumed run makes
+// the same choices.
+template <int Dim, typename Softening>
+class AccuracyController {
+public:
+    using Particle = BasicParticle<Dim>;
+
+    // Monopole force errors grow roughly as theta^3 (PERFORMANCE.md §18)
+    static constexpr double ERROR_EXPONENT = 3.0;
+    // Largest change of theta per measurement
+    static constexpr double MAX_STEP_FACTOR = 1.25;
+
+    AccuracyController(const AccuracyControlOptions& options, Real softening_length)
+        : options_(options), softening_length_(softening_length) {}
+
+    // Whether the step after `step` completed steps is measured
+    [[nodiscard]] bool due(Index step) const noexcept {
+        return (step + 1) % options_.interval == 0;
+    }
+
+    void sample(std::span<const Particle> particles, Index step) {
+        Timer timer;
+        std::mt19937_64 random(options_.seed ^ (step * 0x9E3779B97F4A7C15ull));
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+        // Selection sampling (Knuth's algorithm S): indices in order, no repeats
+        const Index n = particles.size();
+        Index needed = std::min(options_.sample, n);
+        targets_.clear();
+        for (Index i = 0; i < n && needed > 0; ++i) {
+            if (uniform(random) * static_cast<double>(n - i) < static_cast<double>(needed)) {
+                targets_.push_back(i);
+                --needed;
+            }
+        }
+        exact_ = reference_forces<Dim, Softening>(particles, targets_, softening_length_);
+        seconds_ += timer.elapsed();
+    }
+
+    [[nodiscard]] Real adjust(std::span<const Particle> particles, Real theta) {
+        Timer timer;
+        last_error_ = quantile(relative_force_errors<Dim>(particles, targets_, exact_), options_.percentile / 100.0);
+        ++measurements_;
+
+        Real next = theta;
+        if (std::abs(last_error_ - options_.target) > options_.tolerance * options_.target) {
+            const double factor = (last_error_ > 0.0)
+                                  ? std::pow(options_.target / last_error_, 1.0 / ERROR_EXPONENT)
+                                  : MAX_STEP_FACTOR;
+            next = theta * std::clamp(factor, 1.0 / MAX_STEP_FACTOR, MAX_STEP_FACTOR);
+            next = std::clamp(next, options_.min_theta, options_.max_theta);
+        }
+        seconds_ += timer.elapsed();
+        return next;
+    }
+
+    [[nodiscard]] const AccuracyControlOptions& options() const noexcept { return options_; }
+    [[nodiscard]] double last_error() const noexcept { return last_error_; }
+    [[nodiscard]] Index measurements() const noexcept { return measurements_; }
+    [[nodiscard]] double seconds() const noexcept { return seconds_; }  // Spent measuring
+
+private:
+    AccuracyControlOptions options_;
+    Real softening_length_;
+    std::vector<Index> targets_;
+    std::vector<BasicVector<Dim>> exact_;
+    double last_error_ = 0.0;
+    Index measurements_ = 0;
+    double seconds_ = 0.0;
+};
+
+} // namespace barnes_hut
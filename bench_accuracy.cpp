@@ -0,0 +1,425 @@
+/**
+ * Barnes-Hut Accuracy Benchmark
+ * Compares tree forces against exact direct summation (long double sums)
+ * over a sweep of opening angles, leaf sizes and opening criteria, and
+ * reports the error distribution against cost with the Pareto front
+ */
+
+#include "accuracy.h"
+#include "benchmark.h"
+#include "initial_conditions.h"
+#include "tree.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace barnes_hut;
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "\nOptions (lists are comma-separated):\n"
+              << "  --model <list>      uniform, plummer, hernquist, disk, clustered\n"
+              << "                      [default: plummer,hernquist,clustered]\n"
+              << "  --n <list>          Particle counts [default: 20000]\n"
+              << "  --theta <list>      Opening angles [default: 0.3,0.4,0.5,0.6,0.7,0.8,1.0]\n"
+              << "  --leaf <list>       Max particles per leaf [default: 1,4,8,16,32]\n"
+              << "  --mac <list>        Opening criteria: geometric, offset, bmax\n"
+              << "                      [default: geometric,offset,bmax]\n"
+              << "  --sample <k>        Particles whose errors are measured, 0 = all [default: 4096]\n"
+              << "  --dim <2|3>         Spatial dimension [default: 3]\n"
+              << "  --softening <name>  plummer, spline or none [default: plummer]\n"
+              << "  --softening-length <h> Softening length [default: the policy's]\n"
+              << "  --repeat <n>        Timed force evaluations per setting [default: 3]\n"
+              << "  --metric <m>        Error of the Pareto front: median, p99 or p999 [default: p99]\n"
+              << "  --budget <e>        Also report the fastest setting with error <= e\n"
+              << "  --output <file>     Write the JSON results to file [default: stdout]\n"
+              << "\nErrors are |F_tree - F_exact| / |F_exact| per particle; the exact forces\n"
+              << "use the same softened force law, summed in long double. The time is one\n"
+              << "tree build, upward pass and force walk on all threads.\n"
+              << "\nExample:\n"
+              << "  " << program_name << " --model plummer --n 50000 --budget 1e-3 --output accuracy.json\n";
+}
+
+enum class ErrorMetric {
+    Median,
+    P99,
+    P999
+};
+
+struct AccuracyOptions {
+    std::vector<InitialModel> models{InitialModel::Plummer, InitialModel::Hernquist, InitialModel::Clustered};
+    std::vector<Index> counts{20000};
+    std::vector<Real> thetas{0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 1.0};
+    std::vector<Index> leaf_sizes{1, 4, 8, 16, 32};
+    std::vector<OpeningCriterion> criteria{OpeningCriterion::Geometric, OpeningCriterion::Offset,
+                                           OpeningCriterion::MaxDistance};
+    Index sample = 4096;
+    int dimension = NDIM;
+    std::string softening = "plummer";
+    Real softening_length = -1.0;  // < 0: the policy's default
+    int repetitions = 3;
+    ErrorMetric metric = ErrorMetric::P99;
+    std::optional<double> budget;
+    std::string output;  // Empty: stdout
+};
+
+// One tree setting measured against the reference
+struct AccuracyResult {
+    Real theta = 0.0;
+    Index particles_per_leaf = 0;
+    OpeningCriterion criterion = OpeningCriterion::Geometric;
+    double seconds = 0.0;  // Fastest repetition
+    Index particle_cell_interactions = 0;
+    Index direct_interactions = 0;
+    double error_median = 0.0;
+    double error_p99 = 0.0;
+    double error_p999 = 0.0;
+    double error_max = 0.0;
+
+    [[nodiscard]] double error(ErrorMetric metric) const noexcept {
+        switch (metric) {
+            case ErrorMetric::Median:
+                return error_median;
+            case ErrorMetric::P99:
+                return error_p99;
+            case ErrorMetric::P999:
+                return error_p999;
+        }
+        return error_p99;
+    }
+};
+
+// All settings for one model and particle count
+struct AccuracyGroup {
+    InitialModel model = InitialModel::Plummer;
+    Index particle_count = 0;
+    Index sampled = 0;
+    double reference_seconds = 0.0;
+    std::vector<AccuracyResult> results;
+    std::vector<std::size_t> pareto;           // Indices into results, fastest first
+    std::optional<std::size_t> within_budget;  // Fastest result meeting the budget
+};
+
+std::string_view to_string(ErrorMetric metric) noexcept {
+    switch (metric) {
+        case ErrorMetric::Median:
+            return "median";
+        case ErrorMetric::P99:
+            return "p99";
+        case ErrorMetric::P999:
+            return "p999";
+    }
+    return "unknown";
+}
+
+// Settings no other setting beats in both time and error, fastest first
+std::vector<std::size_t> pareto_front(const std::vector<AccuracyResult>& results, ErrorMetric metric) {
+    std::vector<std::size_t> order(results.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        if (results[a].seconds != results[b].seconds) {
+            return results[a].seconds < results[b].seconds;
+        }
+        return results[a].error(metric) < results[b].error(metric);
+    });
+
+    std::vector<std::size_t> front;
+    for (const std::size_t i : order) {
+        if (front.empty() || results[i].error(metric) < results[front.back()].error(metric)) {
+            front.push_back(i);
+        }
+    }
+    return front;
+}
+
+template <int Dim, typename Softening>
+void run_accuracy(const AccuracyOptions& options, std::vector<AccuracyGroup>& groups) {
+    const Real softening_length = (options.softening_length >= 0.0) ? options.softening_length
+                                                                      : Softening::default_length;
+
+    for (const InitialModel model : options.models) {
+        for (const Index n : options.counts) {
+            InitialConditions conditions;
+            conditions.model = model;
+            conditions.particle_count = n;
+            auto particles = generate_particles<Dim>(conditions);
+
+            AccuracyGroup group;
+            group.model = model;
+            group.particle_count = n;
+
+            const auto targets = sample_targets(n, options.sample);
+            const Index sampled = targets.size();
+            group.sampled = sampled;
+
+            std::cerr << "accuracy: " << to_string(model) << " N=" << n << ", exact forces on "
+                      << sampled << " particles\n";
+            Timer reference_timer;
+            const auto exact = reference_forces<Dim, Softening>(particles, targets, softening_length);
+            group.reference_seconds = reference_timer.elapsed();
+
+            for (const Index leaf : options.leaf_sizes) {
+                for (const Real theta : options.thetas) {
+                    for (const OpeningCriterion criterion : options.criteria) {
+                        BasicBarnesHutTree<Dim, Softening> tree(particles, 0.0, theta, leaf);
+                        tree.set_softening_length(softening_length);
+                        tree.set_opening_criterion(criterion);
+
+                        const auto seconds = time_repeated(options.repetitions, [&] {
+                            tree.clear_tree();
+                            tree.build_tree();
+                            tree.compute_mass_distribution();
+                            tree.calculate_forces();
+                        });
+
+                        AccuracyResult result;
+                        result.theta = theta;
+                        result.particles_per_leaf = leaf;
+                        result.criterion = criterion;
+                        result.seconds = *std::min_element(seconds.begin(), seconds.end());
+                        result.particle_cell_interactions = tree.get_statistics().particle_cell_interactions;
+                        result.direct_interactions = tree.get_statistics().direct_force_count;
+
+                        const auto errors = relative_force_errors<Dim>(particles, targets, exact);
+                        result.error_median = quantile(errors, 0.5);
+                        result.error_p99 = quantile(errors, 0.99);
+                        result.error_p999 = quantile(errors, 0.999);
+                        result.error_max = errors.empty() ? 0.0 : errors.back();
+
+                        group.results.push_back(result);
+                    }
+                }
+            }
+
+            group.pareto = pareto_front(group.results, options.metric);
+            if (options.budget) {
+                for (const std::size_t i : group.pareto) {
+                    if (group.results[i].error(options.metric) <= *options.budget) {
+                        group.within_budget = i;
+                        break;
+                    }
+                }
+            }
+            groups.push_back(std::move(group));
+        }
+    }
+}
+
+// Pick the force-law instantiation named on the command line
+template <int Dim>
+void run_with_softening(const AccuracyOptions& options, std::vector<AccuracyGroup>& groups) {
+    if (options.softening == SplineSoftening::name) {
+        run_accuracy<Dim, SplineSoftening>(options, groups);
+    }
+    else if (options.softening == NoSoftening::name) {
+        run_accuracy<Dim, NoSoftening>(options, groups);
+    }
+    else {
+        run_accuracy<Dim, PlummerSoftening>(options, groups);
+    }
+}
+
+void write_json(std::ostream& os, const AccuracyOptions& options, const std::vector<AccuracyGroup>& groups) {
+    os << "{\n"
+       << "  \"benchmark\": \"bench_accuracy\",\n"
+       << "  \"format_version\": 1,\n"
+       << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+       << "  \"dimension\": " << options.dimension << ",\n"
+       << "  \"softening\": \"" << options.softening << "\",\n"
+       << "  \"expansion\": \"monopole\",\n"
+       << "  \"threads\": " << benchmark_threads() << ",\n"
+       << "  \"repetitions\": " << options.repetitions << ",\n"
+       << "  \"error_metric\": \"" << to_string(options.metric) << "\",\n";
+    if (options.budget) {
+        os << "  \"budget\": " << json_number(*options.budget) << ",\n";
+    }
+    os << "  \"groups\": [";
+
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        const auto& group = groups[g];
+        os << (g == 0 ? "\n" : ",\n")
+           << "    {\"model\": \"" << to_string(group.model) << "\""
+           << ", \"n\": " << group.particle_count
+           << ", \"sampled_particles\": " << group.sampled
+           << ", \"reference_seconds\": " << json_number(group.reference_seconds) << ",\n"
+           << "     \"results\": [";
+
+        for (std::size_t r = 0; r < group.results.size(); ++r) {
+            const auto& result = group.results[r];
+            const Index interactions = result.particle_cell_interactions + result.direct_interactions;
+            os << (r == 0 ? "\n" : ",\n")
+               << "       {\"theta\": " << json_number(result.theta)
+               << ", \"particles_per_leaf\": " << result.particles_per_leaf
+               << ", \"mac\": \"" << to_string(result.criterion) << "\""
+               << ", \"seconds\": " << json_number(result.seconds)
+               << ", \"interactions\": " << interactions
+               << ", \"particle_cell_interactions\": " << result.particle_cell_interactions
+               << ", \"direct_interactions\": " << result.direct_interactions
+               << ", \"interactions_per_particle\": "
+               << json_number(static_cast<double>(interactions) / group.particle_count)
+               << ", \"error_median\": " << json_number(result.error_median)
+               << ", \"error_p99\": " << json_number(result.error_p99)
+               << ", \"error_p999\": " << json_number(result.error_p999)
+               << ", \"error_max\": " << json_number(result.error_max) << "}";
+        }
+
+        os << "\n     ],\n"
+           << "     \"pareto\": [";
+        for (std::size_t i = 0; i < group.pareto.size(); ++i) {
+            os << (i == 0 ? "" : ", ") << group.pareto[i];
+        }
+        os << "]";
+        if (options.budget) {
+            os << ", \"fastest_within_budget\": "
+               << (group.within_budget ? std::to_string(*group.within_budget) : std::string("null"));
+        }
+        os << "}";
+    }
+
+    os << "\n  ]\n"
+       << "}\n";
+}
+
+// The Pareto fronts as a table
+void print_summary(const AccuracyOptions& options, const std::vector<AccuracyGroup>& groups) {
+    for (const auto& group : groups) {
+        std::cerr << "\nPareto front for " << to_string(group.model) << " N=" << group.particle_count
+                  << " (" << to_string(options.metric) << " relative error):\n"
+                  << "  theta  leaf  mac        seconds     interactions/particle  error\n";
+        for (const std::size_t i : group.pareto) {
+            const auto& result = group.results[i];
+            const double interactions = static_cast<double>(result.particle_cell_interactions +
+                                                            result.direct_interactions) / group.particle_count;
+            std::cerr << "  " << std::left << std::setw(7) << result.theta
+                      << std::setw(6) << result.particles_per_leaf
+                      << std::setw(11) << to_string(result.criterion)
+                      << std::setw(12) << result.seconds
+                      << std::setw(23) << interactions
+                      << result.error(options.metric)
+                      << (group.within_budget == i ? "  <- fastest within budget" : "") << "\n"
+                      << std::right;
+        }
+        if (options.budget && !group.within_budget) {
+            std::cerr << "  No setting meets the budget " << *options.budget << "\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    AccuracyOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        bool valid = true;
+
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--model" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.models, [](const std::string& item) {
+                return parse_initial_model(item);
+            });
+        }
+        else if (arg == "--n" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.counts, [](const std::string& item) {
+                const Index count = std::stoull(item);
+                return count > 1 ? std::optional<Index>(count) : std::nullopt;
+            });
+        }
+        else if (arg == "--theta" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.thetas, [](const std::string& item) {
+                const Real theta = std::stod(item);
+                return theta >= 0.0 ? std::optional<Real>(theta) : std::nullopt;
+            });
+        }
+        else if (arg == "--leaf" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.leaf_sizes, [](const std::string& item) {
+                const Index leaf = std::stoull(item);
+                return leaf > 0 ? std::optional<Index>(leaf) : std::nullopt;
+            });
+        }
+        else if (arg == "--mac" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.criteria, [](const std::string& item) {
+                return parse_opening_criterion(item);
+            });
+        }
+        else if (arg == "--sample" && i + 1 < argc) {
+            options.sample = std::stoull(argv[++i]);
+        }
+        else if (arg == "--dim" && i + 1 < argc) {
+            options.dimension = std::stoi(argv[++i]);
+            valid = options.dimension == 2 || options.dimension == 3;
+        }
+        else if (arg == "--softening" && i + 1 < argc) {
+            options.softening = argv[++i];
+            valid = options.softening == PlummerSoftening::name || options.softening == SplineSoftening::name ||
+                    options.softening == NoSoftening::name;
+        }
+        else if (arg == "--softening-length" && i + 1 < argc) {
+            options.softening_length = std::stod(argv[++i]);
+            valid = options.softening_length >= 0.0;
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            options.repetitions = std::stoi(argv[++i]);
+            valid = options.repetitions > 0;
+        }
+        else if (arg == "--metric" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            valid = false;
+            for (const auto metric : {ErrorMetric::Median, ErrorMetric::P99, ErrorMetric::P999}) {
+                if (name == to_string(metric)) {
+                    options.metric = metric;
+                    valid = true;
+                }
+            }
+        }
+        else if (arg == "--budget" && i + 1 < argc) {
+            options.budget = std::stod(argv[++i]);
+            valid = *options.budget > 0.0;
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        }
+        else {
+            std::cerr << "Error: Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        if (!valid) {
+            std::cerr << "Error: Invalid value for " << arg << ": " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<AccuracyGroup> groups;
+    if (options.dimension == 2) {
+        run_with_softening<2>(options, groups);
+    }
+    else {
+        run_with_softening<3>(options, groups);
+    }
+
+    print_summary(options, groups);
+
+    if (options.output.empty()) {
+        write_json(std::cout, options, groups);
+        return 0;
+    }
+
+    std::ofstream outfile(options.output);
+    write_json(outfile, options, groups);
+    if (!outfile) {
+        std::cerr << "Error: Failed writing output file: " << options.output << "\n";
+        return 1;
+    }
+    std::cerr << "Wrote accuracy results to: " << options.output << "\n";
+    return 0;
+}
@@ -0,0 +1,423 @@
+/**
+ * Barnes-Hut Microbenchmarks
+ * Times the phases of a tree step in isolation over a sweep of particle
+ * counts, opening angles, leaf sizes and initial distributions, and writes
+ * the results as JSON
+ */
+
+#include "benchmark.h"
+#include "initial_conditions.h"
+#include "tree.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace barnes_hut;
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "\nOptions (lists are comma-separated):\n"
+              << "  --n <list>          Particle counts [default: 10000,100000]\n"
+              << "  --theta <list>      Opening angles [default: 0.3,0.5,0.7]\n"
+              << "  --leaf <list>       Max particles per leaf [default: 1,8,32]\n"
+              << "  --model <list>      uniform, plummer, hernquist, disk, clustered\n"
+              << "                      [default: uniform,plummer,clustered]\n"
+              << "  --dim <2|3>         Spatial dimension [default: 3]\n"
+              << "  --softening <name>  plummer, spline or none [default: plummer]\n"
+              << "  --repeat <n>        Timed repetitions after one warm-up run [default: 5]\n"
+              << "  --output <file>     Write the JSON results to file [default: stdout]\n"
+              << "\nPhases: build (build_tree), upward (compute_mass_distribution), walk\n"
+              << "(calculate_forces, all threads), particle_cell and direct (one interaction\n"
+              << "kernel on one thread), integrate (integrate_particles)\n"
+              << "\nExample:\n"
+              << "  " << program_name << " --n 100000 --theta 0.5 --output bench.json\n";
+}
+
+struct BenchmarkOptions {
+    std::vector<Index> counts{10000, 100000};
+    std::vector<Real> thetas{0.3, 0.5, 0.7};
+    std::vector<Index> leaf_sizes{1, 8, 32};
+    std::vector<InitialModel> models{InitialModel::Uniform, InitialModel::Plummer, InitialModel::Clustered};
+    int dimension = NDIM;
+    std::string softening = "plummer";
+    int repetitions = 5;
+    std::string output;  // Empty: stdout
+};
+
+// One benchmark: a phase timed `repetitions` times on one configuration.
+// Each repetition processes `items` units (particles, nodes or interactions).
+struct BenchmarkResult {
+    std::string phase;
+    InitialModel model = InitialModel::Uniform;
+    Index particle_count = 0;
+    Index particles_per_leaf = 0;  // 0: does not depend on it
+    Real theta = -1.0;             // < 0: does not depend on it
+    int threads = 1;
+    std::vector<double> seconds;
+    Index items = 0;
+    std::string_view unit;         // Plural: "particles", "nodes", "interactions"
+    std::string_view unit_name;    // Singular
+    double flops_per_item = 0.0;   // Interactions only
+    double bytes_per_item = 0.0;
+};
+
+// Model costs per pair interaction. Floating-point operations are counted
+// the usual way for gravitational N-body codes (square root and division
+// one each); bytes are the source operands read: a cell's mass centre, mass
+// and size, or another particle's position, mass and id.
+template <int Dim>
+constexpr double FLOPS_PER_INTERACTION = Dim == 3 ? 20.0 : 15.0;
+
+template <int Dim>
+constexpr double CELL_BYTES = (Dim + 2) * sizeof(Real);
+
+template <int Dim>
+constexpr double PARTICLE_BYTES = (Dim + 1) * sizeof(Real) + sizeof(Index);
+
+// Sources and targets of the kernel benchmarks
+constexpr Index KERNEL_TARGETS = 1024;
+constexpr Index KERNEL_SOURCES = 1024;
+
+// Keeps the kernel results observable so the loops are not optimised away
+volatile Real force_sink = 0.0;
+
+template <int Dim>
+void consume_forces(std::span<const BasicParticle<Dim>> particles) {
+    Real sum = 0.0;
+    for (const auto& particle : particles) {
+        sum += particle.force()[0];
+    }
+    force_sink = force_sink + sum;
+}
+
+// The non-empty nodes below root, in pre-order
+template <int Dim>
+std::vector<const BasicNode<Dim>*> collect_nodes(const BasicNode<Dim>* root) {
+    std::vector<const BasicNode<Dim>*> nodes;
+    std::vector<const BasicNode<Dim>*> pending;
+    if (root) {
+        pending.push_back(root);
+    }
+    while (!pending.empty()) {
+        const auto* node = pending.back();
+        pending.pop_back();
+        if (node->type == NodeType::Empty) {
+            continue;
+        }
+        nodes.push_back(node);
+        for (const auto* child : node->children) {
+            if (child) {
+                pending.push_back(child);
+            }
+        }
+    }
+    return nodes;
+}
+
+// Copies of evenly spaced particles, with ids no tree particle has
+template <int Dim>
+std::vector<BasicParticle<Dim>> sample_particles(std::span<const BasicParticle<Dim>> particles, Index count) {
+    std::vector<BasicParticle<Dim>> sample;
+    count = std::min(count, particles.size());
+    for (Index k = 0; k < count; ++k) {
+        sample.push_back(particles[k * particles.size() / count]);
+        sample.back().set_id(particles.size() + k);
+    }
+    return sample;
+}
+
+template <int Dim, typename Softening>
+void run_benchmarks(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results) {
+    using Tree = BasicBarnesHutTree<Dim, Softening>;
+
+    const int threads = benchmark_threads();
+
+    for (const InitialModel model : options.models) {
+        for (const Index n : options.counts) {
+            InitialConditions conditions;
+            conditions.model = model;
+            conditions.particle_count = n;
+            auto particles = generate_particles<Dim>(conditions);
+
+            BenchmarkResult base;
+            base.model = model;
+            base.particle_count = n;
+            base.threads = threads;
+
+            for (std::size_t l = 0; l < options.leaf_sizes.size(); ++l) {
+                const Index leaf = options.leaf_sizes[l];
+
+                for (std::size_t t = 0; t < options.thetas.size(); ++t) {
+                    const Real theta = options.thetas[t];
+                    std::cerr << "bench: " << to_string(model) << " N=" << n << " leaf=" << leaf
+                              << " theta=" << theta << "\n";
+
+                    // A zero time step leaves the particles (and so every
+                    // repetition) unchanged
+                    Tree tree(particles, 0.0, theta, leaf);
+
+                    if (t == 0) {
+                        BenchmarkResult build = base;
+                        build.phase = "build";
+                        build.particles_per_leaf = leaf;
+                        build.seconds = time_repeated(options.repetitions, [&] {
+                            tree.clear_tree();
+                            tree.build_tree();
+                        });
+                        build.items = n;
+                        build.unit = "particles";
+                        build.unit_name = "particle";
+                        build.threads = 1;
+                        results.push_back(build);
+
+                        BenchmarkResult upward = base;
+                        upward.phase = "upward";
+                        upward.particles_per_leaf = leaf;
+                        upward.seconds = time_repeated(options.repetitions, [&] { tree.compute_mass_distribution(); });
+                        upward.items = collect_nodes(tree.root()).size();
+                        upward.unit = "nodes";
+                        upward.unit_name = "node";
+                        upward.threads = 1;
+                        results.push_back(upward);
+                    }
+                    else {
+                        tree.build_tree();
+                        tree.compute_mass_distribution();
+                    }
+
+                    BenchmarkResult walk = base;
+                    walk.phase = "walk";
+                    walk.particles_per_leaf = leaf;
+                    walk.theta = theta;
+                    walk.seconds = time_repeated(options.repetitions, [&] { tree.calculate_forces(); });
+                    const auto& stats = tree.get_statistics();
+                    walk.items = stats.particle_cell_interactions + stats.direct_force_count;
+                    walk.unit = "interactions";
+                    walk.unit_name = "interaction";
+                    walk.flops_per_item = FLOPS_PER_INTERACTION<Dim>;
+                    if (walk.items > 0) {
+                        walk.bytes_per_item = (stats.particle_cell_interactions * CELL_BYTES<Dim> +
+                                               stats.direct_force_count * PARTICLE_BYTES<Dim>) / walk.items;
+                    }
+                    results.push_back(walk);
+
+                    if (t != 0) {
+                        continue;
+                    }
+
+                    // One kernel on one thread: sampled targets against cells
+                    // spread over the tree, so the operands stay in cache
+                    auto targets = sample_particles<Dim>(particles, KERNEL_TARGETS);
+                    const auto nodes = collect_nodes(tree.root());
+                    std::vector<const BasicNode<Dim>*> cells;
+                    const Index cell_count = std::min(KERNEL_SOURCES, nodes.size());
+                    for (Index k = 0; k < cell_count; ++k) {
+                        cells.push_back(nodes[k * nodes.size() / cell_count]);
+                    }
+
+                    BenchmarkResult particle_cell = base;
+                    particle_cell.phase = "particle_cell";
+                    particle_cell.particles_per_leaf = leaf;
+                    particle_cell.threads = 1;
+                    particle_cell.seconds = time_repeated(options.repetitions, [&] {
+                        for (auto& target : targets) {
+                            for (const auto* cell : cells) {
+                                tree.particle_cell_interaction(target, *cell);
+                            }
+                        }
+                        consume_forces<Dim>(targets);
+                    });
+                    particle_cell.items = targets.size() * cells.size();
+                    particle_cell.unit = "interactions";
+                    particle_cell.unit_name = "interaction";
+                    particle_cell.flops_per_item = FLOPS_PER_INTERACTION<Dim>;
+                    particle_cell.bytes_per_item = CELL_BYTES<Dim>;
+                    results.push_back(particle_cell);
+
+                    if (l != 0) {
+                        continue;
+                    }
+
+                    // Leaf sizes and theta change neither of these
+                    const auto sources = sample_particles<Dim>(particles, KERNEL_SOURCES);
+
+                    BenchmarkResult direct = base;
+                    direct.phase = "direct";
+                    direct.threads = 1;
+                    direct.seconds = time_repeated(options.repetitions, [&] {
+                        for (auto& target : targets) {
+                            for (const auto& source : sources) {
+                                tree.direct_force_calculation(target, source);
+                            }
+                        }
+                        consume_forces<Dim>(targets);
+                    });
+                    direct.items = targets.size() * sources.size();
+                    direct.unit = "interactions";
+                    direct.unit_name = "interaction";
+                    direct.flops_per_item = FLOPS_PER_INTERACTION<Dim>;
+                    direct.bytes_per_item = PARTICLE_BYTES<Dim>;
+                    results.push_back(direct);
+
+                    BenchmarkResult integrate = base;
+                    integrate.phase = "integrate";
+                    integrate.seconds = time_repeated(options.repetitions, [&] { tree.integrate_particles(); });
+                    integrate.items = n;
+                    integrate.unit = "particles";
+                    integrate.unit_name = "particle";
+                    results.push_back(integrate);
+                }
+            }
+        }
+    }
+}
+
+// Pick the force-law instantiation named on the command line
+template <int Dim>
+void run_with_softening(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results) {
+    if (options.softening == SplineSoftening::name) {
+        run_benchmarks<Dim, SplineSoftening>(options, results);
+    }
+    else if (options.softening == NoSoftening::name) {
+        run_benchmarks<Dim, NoSoftening>(options, results);
+    }
+    else {
+        run_benchmarks<Dim, PlummerSoftening>(options, results);
+    }
+}
+
+void write_json(std::ostream& os, const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results) {
+    os << "{\n"
+       << "  \"benchmark\": \"bench_barnes_hut\",\n"
+       << "  \"format_version\": 1,\n"
+       << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+       << "  \"dimension\": " << options.dimension << ",\n"
+       << "  \"softening\": \"" << options.softening << "\",\n"
+       << "  \"threads\": " << benchmark_threads() << ",\n"
+       << "  \"repetitions\": " << options.repetitions << ",\n"
+       << "  \"results\": [";
+
+    for (std::size_t r = 0; r < results.size(); ++r) {
+        const auto& result = results[r];
+
+        std::vector<double> sorted = result.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        const double best = sorted.empty() ? 0.0 : sorted.front();
+        const double median = quantile(sorted, 0.5);
+        const double items = static_cast<double>(result.items);
+
+        os << (r == 0 ? "\n" : ",\n")
+           << "    {\"phase\": \"" << result.phase << "\""
+           << ", \"model\": \"" << to_string(result.model) << "\""
+           << ", \"n\": " << result.particle_count;
+        if (result.particles_per_leaf > 0) {
+            os << ", \"particles_per_leaf\": " << result.particles_per_leaf;
+        }
+        if (result.theta >= 0.0) {
+            os << ", \"theta\": " << json_number(result.theta);
+        }
+        os << ", \"threads\": " << result.threads
+           << ", \"seconds_min\": " << json_number(best)
+           << ", \"seconds_median\": " << json_number(median)
+           << ", \"" << result.unit << "\": " << result.items
+           << ", \"" << result.unit << "_per_second\": " << json_number(items / best)
+           << ", \"ns_per_" << result.unit_name << "\": " << json_number(best * 1e9 / items);
+        if (result.flops_per_item > 0.0) {
+            os << ", \"gflops\": " << json_number(items * result.flops_per_item / best * 1e-9)
+               << ", \"bytes_per_" << result.unit_name << "\": " << json_number(result.bytes_per_item);
+        }
+        os << "}";
+    }
+
+    os << "\n  ]\n"
+       << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        bool valid = true;
+
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--n" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.counts, [](const std::string& item) {
+                const Index count = std::stoull(item);
+                return count > 0 ? std::optional<Index>(count) : std::nullopt;
+            });
+        }
+        else if (arg == "--theta" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.thetas, [](const std::string& item) {
+                const Real theta = std::stod(item);
+                return theta >= 0.0 ? std::optional<Real>(theta) : std::nullopt;
+            });
+        }
+        else if (arg == "--leaf" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.leaf_sizes, [](const std::string& item) {
+                const Index leaf = std::stoull(item);
+                return leaf > 0 ? std::optional<Index>(leaf) : std::nullopt;
+            });
+        }
+        else if (arg == "--model" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.models, [](const std::string& item) {
+                return parse_initial_model(item);
+            });
+        }
+        else if (arg == "--dim" && i + 1 < argc) {
+            options.dimension = std::stoi(argv[++i]);
+            valid = options.dimension == 2 || options.dimension == 3;
+        }
+        else if (arg == "--softening" && i + 1 < argc) {
+            options.softening = argv[++i];
+            valid = options.softening == PlummerSoftening::name || options.softening == SplineSoftening::name ||
+                    options.softening == NoSoftening::name;
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            options.repetitions = std::stoi(argv[++i]);
+            valid = options.repetitions > 0;
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        }
+        else {
+            std::cerr << "Error: Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        if (!valid) {
+            std::cerr << "Error: Invalid value for " << arg << ": " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<BenchmarkResult> results;
+    if (options.dimension == 2) {
+        run_with_softening<2>(options, results);
+    }
+    else {
+        run_with_softening<3>(options, results);
+    }
+
+    if (options.output.empty()) {
+        write_json(std::cout, options, results);
+        return 0;
+    }
+
+    std::ofstream outfile(options.output);
+    write_json(outfile, options, results);
+    if (!outfile) {
+        std::cerr << "Error: Failed writing output file: " << options.output << "\n";
+        return 1;
+    }
+    std::cerr << "Wrote " << results.size() << " benchmark results to: " << options.output << "\n";
+    return 0;
+}
@@ -0,0 +1,395 @@
+/**
+ * Barnes-Hut I/O Benchmark
+ * Times the particle file readers and the snapshot writers over a sweep of
+ * particle counts and thread counts, optionally with cold reads and
+ * durable writes, and writes MB/s and particles/s as JSON
+ */
+
+#include "benchmark.h"
+#include "binary_file.h"
+#include "column_snapshot.h"
+#include "file.h"
+#include "initial_conditions.h"
+#include "vtk_writer.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace barnes_hut;
+
+namespace fs = std::filesystem;
+
+// Readers first, then writers
+constexpr std::string_view FORMATS[] = {
+    "read_text", "read_binary", "positions", "forces", "binary", "columns", "gnuplot", "vtu"
+};
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "\nOptions (lists are comma-separated):\n"
+              << "  --n <list>          Particle counts [default: 100000,1000000]\n"
+              << "  --threads <list>    Thread counts [default: 1 and the maximum]\n"
+              << "  --format <list>     Formats [default: all]:\n"
+              << "                        read_text    read_config_file + read_particle_file, text input\n"
+              << "                        read_binary  the same, binary input (binary_file.h)\n"
+              << "                        positions    write_particle_positions (text)\n"
+              << "                        forces       write_particle_forces (text)\n"
+              << "                        binary       write_binary_particle_file\n"
+              << "                        columns      write_column_snapshot (default fields, lossless)\n"
+              << "                        gnuplot      write_gnuplot_binary\n"
+              << "                        vtu          write_vtu_particles\n"
+              << "  --model <name>      Initial distribution of the data [default: plummer]\n"
+              << "  --dim <2|3>         Spatial dimension [default: 3]\n"
+              << "  --repeat <n>        Timed repetitions after one warm-up run [default: 3]\n"
+              << "  --drop-cache        Evict the input file from the page cache before every read\n"
+              << "  --sync              Include flushing written files to storage (fsync) in the time\n"
+              << "  --dir <path>        Where to create the scratch directory [default: the system temporary directory]\n"
+              << "  --output <file>     Write the JSON results to file [default: stdout]\n"
+              << "\nWithout --drop-cache and --sync the benchmark measures parsing, formatting and\n"
+              << "the page cache, not the storage device. Throughput is in file bytes (MB = 1e6).\n"
+              << "\nExample:\n"
+              << "  " << program_name << " --n 1000000 --threads 1,8 --drop-cache --sync --output io.json\n";
+}
+
+struct IoOptions {
+    std::vector<Index> counts{100000, 1000000};
+    std::vector<int> threads;  // Empty: 1 and the maximum
+    std::vector<std::string_view> formats{std::begin(FORMATS), std::end(FORMATS)};
+    InitialModel model = InitialModel::Plummer;
+    int dimension = NDIM;
+    int repetitions = 3;
+    bool drop_cache = false;
+    bool sync = false;
+    fs::path directory;
+    std::string output;  // Empty: stdout
+};
+
+struct IoResult {
+    std::string_view format;
+    Index particle_count = 0;
+    int threads = 1;
+    std::uintmax_t bytes = 0;
+    std::vector<double> seconds;
+};
+
+// Silences std::cout (the writers report every file they write there)
+class QuietStdout {
+public:
+    QuietStdout() : saved_(std::cout.rdbuf(nullptr)) {}
+    ~QuietStdout() { std::cout.rdbuf(saved_); }
+
+    QuietStdout(const QuietStdout&) = delete;
+    QuietStdout& operator=(const QuietStdout&) = delete;
+
+private:
+    std::streambuf* saved_;
+};
+
+// Files in directory whose names start with prefix
+std::vector<fs::path> files_with_prefix(const fs::path& directory, std::string_view prefix) {
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (entry.is_regular_file() && entry.path().filename().string().starts_with(prefix)) {
+            files.push_back(entry.path());
+        }
+    }
+    return files;
+}
+
+// Flush path to storage, then drop its pages from the page cache
+bool evict_from_page_cache(const fs::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool evicted = ::fdatasync(fd) == 0 && ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return evicted;
+}
+
+bool sync_file(const fs::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+std::uintmax_t total_size(const std::vector<fs::path>& files) {
+    std::uintmax_t bytes = 0;
+    for (const auto& file : files) {
+        bytes += fs::file_size(file);
+    }
+    return bytes;
+}
+
+void remove_files(const std::vector<fs::path>& files) {
+    std::error_code error;
+    for (const auto& file : files) {
+        fs::remove(file, error);
+    }
+}
+
+// Write particles (with nonzero forces, so the force snapshots format real
+// values) in format to files named <directory>/<format>*
+template <int Dim>
+bool write_format(std::string_view format, const fs::path& directory, std::span<const BasicParticle<Dim>> particles) {
+    const fs::path base = directory / format;
+    const std::string message = "I/O benchmark";
+
+    if (format == "positions") {
+        return write_particle_positions(particles, message, 0.5, 8, base.string());
+    }
+    if (format == "forces") {
+        return write_particle_forces(particles, message, 0.5, 8, base.string());
+    }
+    if (format == "binary") {
+        SimulationConfig config;
+        config.particle_count = particles.size();
+        return write_binary_particle_file(base.string() + ".bin", config, particles);
+    }
+    if (format == "columns") {
+        return write_column_snapshot(base.string() + ".bhcs", particles, message, 0.0, ColumnSnapshotOptions{});
+    }
+    if (format == "gnuplot") {
+        return write_gnuplot_binary(base.string() + ".dat", particles);
+    }
+    return write_vtu_particles(base.string() + ".vtu", particles);
+}
+
+template <int Dim>
+bool run_benchmarks(const IoOptions& options, std::vector<IoResult>& results) {
+    for (const Index n : options.counts) {
+        InitialConditions conditions;
+        conditions.model = options.model;
+        conditions.particle_count = n;
+
+        auto particles = generate_particles<Dim>(conditions);
+        for (auto& particle : particles) {
+            particle.force() = particle.velocity();
+        }
+
+        // Inputs for the readers
+        SimulationConfig config;
+        config.particle_count = n;
+        const fs::path text_input = options.directory / "input.txt";
+        const fs::path binary_input = options.directory / "input.bin";
+        {
+            QuietStdout quiet;
+            if (!write_initial_conditions(text_input.string(), config, conditions, Dim, true) ||
+                !write_initial_conditions(binary_input.string(), config, conditions, Dim)) {
+                return false;
+            }
+        }
+
+        for (const int threads : options.threads) {
+            #ifdef _OPENMP
+            omp_set_num_threads(threads);
+            #endif
+
+            for (const std::string_view format : options.formats) {
+                std::cerr << "bench: " << format << " N=" << n << " threads=" << threads << "\n";
+
+                IoResult result;
+                result.format = format;
+                result.particle_count = n;
+                result.threads = threads;
+                bool succeeded = true;
+
+                QuietStdout quiet;
+                if (format.starts_with("read_")) {
+                    const fs::path& input = (format == "read_text") ? text_input : binary_input;
+                    result.seconds = time_repeated(options.repetitions, [&] {
+                        const auto read_config = read_config_file(input.string());
+                        succeeded = read_config && read_particle_file<Dim>(input.string(), *read_config) && succeeded;
+                    }, [&] {
+                        if (options.drop_cache) {
+                            succeeded = evict_from_page_cache(input) && succeeded;
+                        }
+                    });
+                    result.bytes = fs::file_size(input);
+                }
+                else {
+                    const std::string prefix(format);
+                    result.seconds = time_repeated(options.repetitions, [&] {
+                        succeeded = write_format<Dim>(format, options.directory, particles) && succeeded;
+                        if (options.sync) {
+                            for (const auto& file : files_with_prefix(options.directory, prefix)) {
+                                succeeded = sync_file(file) && succeeded;
+                            }
+                        }
+                    }, [&] {
+                        remove_files(files_with_prefix(options.directory, prefix));
+                    });
+                    const auto written = files_with_prefix(options.directory, prefix);
+                    result.bytes = total_size(written);
+                    remove_files(written);
+                }
+
+                if (!succeeded) {
+                    std::cerr << "Error: " << format << " failed (N=" << n << ")\n";
+                    remove_files({text_input, binary_input});
+                    return false;
+                }
+                results.push_back(result);
+            }
+        }
+
+        remove_files({text_input, binary_input});
+    }
+    return true;
+}
+
+void write_json(std::ostream& os, const IoOptions& options, const std::vector<IoResult>& results) {
+    os << "{\n"
+       << "  \"benchmark\": \"bench_io\",\n"
+       << "  \"format_version\": 1,\n"
+       << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+       << "  \"dimension\": " << options.dimension << ",\n"
+       << "  \"model\": \"" << to_string(options.model) << "\",\n"
+       << "  \"repetitions\": " << options.repetitions << ",\n"
+       << "  \"drop_cache\": " << (options.drop_cache ? "true" : "false") << ",\n"
+       << "  \"sync\": " << (options.sync ? "true" : "false") << ",\n"
+       << "  \"results\": [";
+
+    for (std::size_t r = 0; r < results.size(); ++r) {
+        const auto& result = results[r];
+
+        std::vector<double> sorted = result.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        const double best = sorted.empty() ? 0.0 : sorted.front();
+        const double median = quantile(sorted, 0.5);
+        const double bytes = static_cast<double>(result.bytes);
+
+        os << (r == 0 ? "\n" : ",\n")
+           << "    {\"format\": \"" << result.format << "\""
+           << ", \"n\": " << result.particle_count
+           << ", \"threads\": " << result.threads
+           << ", \"bytes\": " << result.bytes
+           << ", \"bytes_per_particle\": " << json_number(bytes / result.particle_count)
+           << ", \"seconds_min\": " << json_number(best)
+           << ", \"seconds_median\": " << json_number(median)
+           << ", \"mb_per_second\": " << json_number(bytes / best * 1e-6)
+           << ", \"particles_per_second\": " << json_number(result.particle_count / best)
+           << "}";
+    }
+
+    os << "\n  ]\n"
+       << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+    IoOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        bool valid = true;
+
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--n" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.counts, [](const std::string& item) {
+                const Index count = std::stoull(item);
+                return count > 0 ? std::optional<Index>(count) : std::nullopt;
+            });
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.threads, [](const std::string& item) {
+                const int threads = std::stoi(item);
+                return threads > 0 ? std::optional<int>(threads) : std::nullopt;
+            });
+        }
+        else if (arg == "--format" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.formats, [](const std::string& item) {
+                const auto format = std::find(std::begin(FORMATS), std::end(FORMATS), item);
+                return format != std::end(FORMATS) ? std::optional<std::string_view>(*format) : std::nullopt;
+            });
+        }
+        else if (arg == "--model" && i + 1 < argc) {
+            const auto model = parse_initial_model(argv[++i]);
+            valid = model.has_value();
+            options.model = model.value_or(options.model);
+        }
+        else if (arg == "--dim" && i + 1 < argc) {
+            options.dimension = std::stoi(argv[++i]);
+            valid = options.dimension == 2 || options.dimension == 3;
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            options.repetitions = std::stoi(argv[++i]);
+            valid = options.repetitions > 0;
+        }
+        else if (arg == "--drop-cache") {
+            options.drop_cache = true;
+        }
+        else if (arg == "--sync") {
+            options.sync = true;
+        }
+        else if (arg == "--dir" && i + 1 < argc) {
+            options.directory = argv[++i];
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        }
+        else {
+            std::cerr << "Error: Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        if (!valid) {
+            std::cerr << "Error: Invalid value for " << arg << ": " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    if (options.threads.empty()) {
+        options.threads.push_back(1);
+        if (benchmark_threads() > 1) {
+            options.threads.push_back(benchmark_threads());
+        }
+    }
+
+    // A directory of our own, so that the writers' files can be found by name
+    const fs::path parent = options.directory.empty() ? fs::temp_directory_path() : options.directory;
+    options.directory = parent / ("bench_io_" + std::to_string(::getpid()));
+    std::error_code error;
+    if (!fs::create_directories(options.directory, error)) {
+        std::cerr << "Error: Could not create directory: " << options.directory << "\n";
+        return 1;
+    }
+
+    std::vector<IoResult> results;
+    const bool completed = (options.dimension == 2) ? run_benchmarks<2>(options, results)
+                                                    : run_benchmarks<3>(options, results);
+    fs::remove_all(options.directory, error);
+    if (!completed) {
+        return 1;
+    }
+
+    if (options.output.empty()) {
+        write_json(std::cout, options, results);
+        return 0;
+    }
+
+    std::ofstream outfile(options.output);
+    write_json(outfile, options, results);
+    if (!outfile) {
+        std::cerr << "Error: Failed writing output file: " << options.output << "\n";
+        return 1;
+    }
+    std::cerr << "Wrote " << results.size() << " benchmark results to: " << options.output << "\n";
+    return 0;
+}
@@ -0,0 +1,529 @@
+/**
+ * Barnes-Hut Scaling Study
+ * Runs full simulation steps on 1..P threads, at a fixed particle count
+ * (strong scaling) and at a fixed count per thread (weak scaling), records
+ * per-phase times, parallel efficiency and load imbalance as a JSON
+ * baseline, and compares a new run against a baseline
+ */
+
+#include "benchmark.h"
+#include "direct_sum.h"
+#include "initial_conditions.h"
+#include "tree.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace barnes_hut;
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "\nOptions:\n"
+              << "  --mode <m>          strong, weak or both [default: both]\n"
+              << "  --threads <list>    Thread counts, comma-separated [default: 1,2,4,... up to the cores]\n"
+              << "  --n <count>         Particles (strong), particles per thread (weak) [default: 50000]\n"
+              << "  --model <name>      uniform, plummer, hernquist, disk or clustered [default: plummer]\n"
+              << "  --backend <name>    tree or direct [default: tree]\n"
+              << "  --theta <t>         Opening angle [default: 0.5]\n"
+              << "  --leaf <n>          Max particles per leaf [default: 8]\n"
+              << "  --dim <2|3>         Spatial dimension [default: 3]\n"
+              << "  --steps <n>         Timed steps per run, after one warm-up step [default: 3]\n"
+              << "  --no-pin            Leave thread placement to the OS\n"
+              << "  --output <file>     Write the JSON results to file [default: stdout]\n"
+              << "  --compare <file>    Rerun the configuration of a baseline written by this tool\n"
+              << "                      and fail if a phase is slower than the baseline allows\n"
+              << "  --tolerance <f>     Allowed slowdown per phase in compare mode [default: 0.1]\n"
+              << "  --min-time <s>      Phases faster than this per step are not compared [default: 0.001]\n"
+              << "\nThreads are pinned to the allowed CPUs in order (thread t on the t-th CPU).\n"
+              << "Strong efficiency is T(1) / (p T(p)), weak efficiency T(1) / T(p).\n"
+              << "\nExample:\n"
+              << "  " << program_name << " --threads 1,2,4,8 --output baseline.json\n"
+              << "  " << program_name << " --compare baseline.json --tolerance 0.15\n";
+}
+
+enum class ScalingMode {
+    Strong,
+    Weak
+};
+
+std::string_view to_string(ScalingMode mode) noexcept {
+    return mode == ScalingMode::Strong ? "strong" : "weak";
+}
+
+struct ScalingOptions {
+    std::vector<ScalingMode> modes{ScalingMode::Strong, ScalingMode::Weak};
+    std::vector<int> threads;  // Empty: powers of two up to the allowed CPUs
+    Index particles = 50000;
+    InitialModel model = InitialModel::Plummer;
+    ForceBackend backend = ForceBackend::Tree;
+    Real theta = 0.5;
+    Index particles_per_leaf = 8;
+    int dimension = NDIM;
+    int steps = 3;
+    bool pin = true;
+    std::string output;
+    std::string compare;
+    double tolerance = 0.1;
+    double min_time = 0.001;
+};
+
+// Phase times of one run, per step
+struct PhaseTimes {
+    double load = 0.0;
+    double upward = 0.0;
+    double force = 0.0;
+    double integrate = 0.0;
+    double total = 0.0;
+    double imbalance = 0.0;  // Mean force imbalance over the steps
+};
+
+constexpr std::string_view PHASES[] = {"load", "upward", "force", "integrate", "total"};
+
+double phase_time(const PhaseTimes& times, std::string_view phase) noexcept {
+    if (phase == "load") return times.load;
+    if (phase == "upward") return times.upward;
+    if (phase == "force") return times.force;
+    if (phase == "integrate") return times.integrate;
+    return times.total;
+}
+
+struct ScalingResult {
+    ScalingMode mode = ScalingMode::Strong;
+    int threads = 1;
+    Index particle_count = 0;
+    PhaseTimes times;
+    PhaseTimes efficiency;  // Per phase, relative to the first thread count of the mode
+};
+
+// CPUs this process may run on
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    #ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    #endif
+    return cpus;
+}
+
+// Set the OpenMP team size and pin thread t to the t-th allowed CPU
+// (wrapping around when there are more threads than CPUs). The runtime keeps
+// its threads between parallel regions, so the placement holds for the run.
+void use_threads(int threads, const std::vector<int>& cpus, bool pin) {
+    #ifdef _OPENMP
+    omp_set_num_threads(threads);
+    #ifdef __linux__
+    if (pin && !cpus.empty()) {
+        #pragma omp parallel
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+    }
+    #endif
+    #endif
+    (void)threads;
+    (void)cpus;
+    (void)pin;
+}
+
+template <NBodySolver Solver>
+PhaseTimes time_steps(Solver& solver, int steps) {
+    PhaseTimes times;
+
+    solver.simulation_step();
+    solver.clear_tree();
+
+    for (int step = 0; step < steps; ++step) {
+        solver.simulation_step();
+        const auto& stats = solver.get_statistics();
+        times.load += stats.time_load;
+        times.upward += stats.time_upward;
+        times.force += stats.time_force;
+        times.integrate += stats.time_total - stats.time_load - stats.time_upward - stats.time_force;
+        times.total += stats.time_total;
+        times.imbalance += stats.force_imbalance;
+        solver.clear_tree();
+    }
+
+    for (double* value : {&times.load, &times.upward, &times.force, &times.integrate, &times.total, &times.imbalance}) {
+        *value /= steps;
+    }
+    return times;
+}
+
+template <int Dim>
+PhaseTimes run_steps(const ScalingOptions& options, Index particle_count) {
+    InitialConditions conditions;
+    conditions.model = options.model;
+    conditions.particle_count = particle_count;
+    auto particles = generate_particles<Dim>(conditions);
+
+    // The time step of generated runs
+    const Real dt = SimulationConfig{}.time_step;
+    if (options.backend == ForceBackend::Direct) {
+        BasicDirectSummation<Dim> direct(particles, dt);
+        return time_steps(direct, options.steps);
+    }
+    BasicBarnesHutTree<Dim> tree(particles, dt, options.theta, options.particles_per_leaf);
+    return time_steps(tree, options.steps);
+}
+
+std::vector<ScalingResult> run_scaling(const ScalingOptions& options) {
+    const auto cpus = allowed_cpus();
+    std::vector<ScalingResult> results;
+
+    for (const ScalingMode mode : options.modes) {
+        std::optional<ScalingResult> reference;
+
+        for (const int threads : options.threads) {
+            ScalingResult result;
+            result.mode = mode;
+            result.threads = threads;
+            result.particle_count = (mode == ScalingMode::Strong) ? options.particles : options.particles * threads;
+
+            std::cerr << "scaling: " << to_string(mode) << " threads=" << threads
+                      << " N=" << result.particle_count << "\n";
+            use_threads(threads, cpus, options.pin);
+            result.times = (options.dimension == 2) ? run_steps<2>(options, result.particle_count)
+                                                    : run_steps<3>(options, result.particle_count);
+
+            if (!reference) {
+                reference = result;
+            }
+            // Work per thread is constant in weak scaling, total work in strong scaling
+            const double ideal = (mode == ScalingMode::Strong)
+                                 ? static_cast<double>(threads) / reference->threads : 1.0;
+            auto efficiency = [&](double base, double time) {
+                return time > 0.0 ? base / (ideal * time) : std::numeric_limits<double>::quiet_NaN();
+            };
+            result.efficiency.load = efficiency(reference->times.load, result.times.load);
+            result.efficiency.upward = efficiency(reference->times.upward, result.times.upward);
+            result.efficiency.force = efficiency(reference->times.force, result.times.force);
+            result.efficiency.integrate = efficiency(reference->times.integrate, result.times.integrate);
+            result.efficiency.total = efficiency(reference->times.total, result.times.total);
+
+            results.push_back(result);
+        }
+    }
+    return results;
+}
+
+void write_json(std::ostream& os, const ScalingOptions& options, const std::vector<ScalingResult>& results) {
+    os << "{\n"
+       << "  \"benchmark\": \"bench_scaling\",\n"
+       << "  \"format_version\": 1,\n"
+       << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+       << "  \"cpus\": " << allowed_cpus().size() << ",\n"
+       << "  \"pinned\": " << (options.pin ? "true" : "false") << ",\n"
+       << "  \"dimension\": " << options.dimension << ",\n"
+       << "  \"backend\": \"" << to_string(options.backend) << "\",\n"
+       << "  \"model\": \"" << to_string(options.model) << "\",\n"
+       << "  \"theta\": " << json_number(options.theta) << ",\n"
+       << "  \"particles_per_leaf\": " << options.particles_per_leaf << ",\n"
+       << "  \"particles\": " << options.particles << ",\n"
+       << "  \"steps\": " << options.steps << ",\n"
+       << "  \"results\": [";
+
+    for (std::size_t r = 0; r < results.size(); ++r) {
+        const auto& result = results[r];
+        os << (r == 0 ? "\n" : ",\n")
+           << "    {\"mode\": \"" << to_string(result.mode) << "\""
+           << ", \"threads\": " << result.threads
+           << ", \"n\": " << result.particle_count;
+        for (const auto phase : PHASES) {
+            os << ", \"" << phase << "\": " << json_number(phase_time(result.times, phase));
+        }
+        for (const auto phase : PHASES) {
+            os << ", \"efficiency_" << phase << "\": " << json_number(phase_time(result.efficiency, phase));
+        }
+        os << ", \"force_imbalance\": " << json_number(result.times.imbalance) << "}";
+    }
+
+    os << "\n  ]\n"
+       << "}\n";
+}
+
+// Raw value of "key": value in text (quotes removed); enough for the files
+// write_json produces, where no string contains a comma, brace or quote
+std::optional<std::string> json_field(std::string_view text, std::string_view key) {
+    std::string pattern = "\"";
+    pattern.append(key).append("\": ");
+    const auto start = text.find(pattern);
+    if (start == std::string_view::npos) {
+        return std::nullopt;
+    }
+    std::string_view value = text.substr(start + pattern.size());
+    value = value.substr(0, value.find_first_of(",}\n"));
+    if (value.size() >= 2 && value.front() == '"') {
+        value = value.substr(1, value.size() - 2);
+    }
+    return std::string(value);
+}
+
+struct Baseline {
+    ScalingOptions options;
+    std::vector<ScalingResult> results;
+};
+
+std::optional<Baseline> read_baseline(const std::string& filename) {
+    std::ifstream infile(filename);
+    if (!infile) {
+        std::cerr << "Error: Could not open baseline file: " << filename << "\n";
+        return std::nullopt;
+    }
+    std::stringstream buffer;
+    buffer << infile.rdbuf();
+    const std::string text = buffer.str();
+
+    const auto results_start = text.find("\"results\": [");
+    if (json_field(text, "benchmark") != "bench_scaling" || results_start == std::string::npos) {
+        std::cerr << "Error: Not a bench_scaling baseline: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    Baseline baseline;
+    auto& options = baseline.options;
+    try {
+        const std::string_view header(text.data(), results_start);
+        options.dimension = std::stoi(json_field(header, "dimension").value());
+        options.backend = json_field(header, "backend").value() == "direct" ? ForceBackend::Direct : ForceBackend::Tree;
+        options.model = parse_initial_model(json_field(header, "model").value()).value();
+        options.theta = std::stod(json_field(header, "theta").value());
+        options.particles_per_leaf = std::stoull(json_field(header, "particles_per_leaf").value());
+        options.particles = std::stoull(json_field(header, "particles").value());
+        options.steps = std::stoi(json_field(header, "steps").value());
+        options.pin = json_field(header, "pinned").value() == "true";
+        options.modes.clear();
+
+        std::istringstream lines(text.substr(results_start));
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.find("{\"mode\"") == std::string::npos) {
+                continue;
+            }
+            ScalingResult result;
+            result.mode = json_field(line, "mode").value() == "weak" ? ScalingMode::Weak : ScalingMode::Strong;
+            result.threads = std::stoi(json_field(line, "threads").value());
+            result.particle_count = std::stoull(json_field(line, "n").value());
+            result.times.load = std::stod(json_field(line, "load").value());
+            result.times.upward = std::stod(json_field(line, "upward").value());
+            result.times.force = std::stod(json_field(line, "force").value());
+            result.times.integrate = std::stod(json_field(line, "integrate").value());
+            result.times.total = std::stod(json_field(line, "total").value());
+            result.times.imbalance = std::stod(json_field(line, "force_imbalance").value());
+
+            if (std::find(options.modes.begin(), options.modes.end(), result.mode) == options.modes.end()) {
+                options.modes.push_back(result.mode);
+            }
+            if (std::find(options.threads.begin(), options.threads.end(), result.threads) == options.threads.end()) {
+                options.threads.push_back(result.threads);
+            }
+            baseline.results.push_back(result);
+        }
+    }
+    catch (const std::exception&) {
+        std::cerr << "Error: Invalid baseline file: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    if (baseline.results.empty()) {
+        std::cerr << "Error: Baseline has no results: " << filename << "\n";
+        return std::nullopt;
+    }
+    return baseline;
+}
+
+// Print every phase against the baseline; false if any regressed
+bool compare_results(const std::vector<ScalingResult>& baseline, const std::vector<ScalingResult>& current,
+                     double tolerance, double min_time) {
+    bool passed = true;
+    std::cout << "mode    threads  phase       baseline(s)  current(s)   change\n";
+
+    for (const auto& result : current) {
+        const auto match = std::find_if(baseline.begin(), baseline.end(), [&](const ScalingResult& other) {
+            return other.mode == result.mode && other.threads == result.threads;
+        });
+        if (match == baseline.end()) {
+            continue;
+        }
+
+        for (const auto phase : PHASES) {
+            const double before = phase_time(match->times, phase);
+            const double after = phase_time(result.times, phase);
+            const bool compared = before >= min_time;
+            const double change = before > 0.0 ? after / before - 1.0 : 0.0;
+            const bool regressed = compared && change > tolerance;
+            passed = passed && !regressed;
+
+            std::cout << std::left << std::setw(8) << to_string(result.mode)
+                      << std::setw(9) << result.threads
+                      << std::setw(12) << phase
+                      << std::setw(13) << before
+                      << std::setw(13) << after
+                      << std::right << std::showpos << std::fixed << std::setprecision(1) << 100.0 * change << "%"
+                      << std::noshowpos << std::defaultfloat << std::setprecision(6)
+                      << (!compared ? "  (below --min-time)" : regressed ? "  REGRESSION" : "") << "\n";
+        }
+    }
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    ScalingOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        bool valid = true;
+
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--mode" && i + 1 < argc) {
+            const std::string mode = argv[++i];
+            valid = mode == "strong" || mode == "weak" || mode == "both";
+            options.modes.clear();
+            if (mode != "weak") {
+                options.modes.push_back(ScalingMode::Strong);
+            }
+            if (mode != "strong") {
+                options.modes.push_back(ScalingMode::Weak);
+            }
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.threads, [](const std::string& item) {
+                const int threads = std::stoi(item);
+                return threads > 0 ? std::optional<int>(threads) : std::nullopt;
+            });
+        }
+        else if (arg == "--n" && i + 1 < argc) {
+            options.particles = std::stoull(argv[++i]);
+            valid = options.particles > 0;
+        }
+        else if (arg == "--model" && i + 1 < argc) {
+            const auto model = parse_initial_model(argv[++i]);
+            valid = model.has_value();
+            options.model = model.value_or(options.model);
+        }
+        else if (arg == "--backend" && i + 1 < argc) {
+            const std::string backend = argv[++i];
+            valid = backend == "tree" || backend == "direct";
+            options.backend = (backend == "direct") ? ForceBackend::Direct : ForceBackend::Tree;
+        }
+        else if (arg == "--theta" && i + 1 < argc) {
+            options.theta = std::stod(argv[++i]);
+            valid = options.theta > 0.0;
+        }
+        else if (arg == "--leaf" && i + 1 < argc) {
+            options.particles_per_leaf = std::stoull(argv[++i]);
+            valid = options.particles_per_leaf > 0;
+        }
+        else if (arg == "--dim" && i + 1 < argc) {
+            options.dimension = std::stoi(argv[++i]);
+            valid = options.dimension == 2 || options.dimension == 3;
+        }
+        else if (arg == "--steps" && i + 1 < argc) {
+            options.steps = std::stoi(argv[++i]);
+            valid = options.steps > 0;
+        }
+        else if (arg == "--no-pin") {
+            options.pin = false;
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        }
+        else if (arg == "--compare" && i + 1 < argc) {
+            options.compare = argv[++i];
+        }
+        else if (arg == "--tolerance" && i + 1 < argc) {
+            options.tolerance = std::stod(argv[++i]);
+            valid = options.tolerance >= 0.0;
+        }
+        else if (arg == "--min-time" && i + 1 < argc) {
+            options.min_time = std::stod(argv[++i]);
+            valid = options.min_time >= 0.0;
+        }
+        else {
+            std::cerr << "Error: Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        if (!valid) {
+            std::cerr << "Error: Invalid value for " << arg << ": " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    // A comparison reruns exactly what the baseline measured
+    std::optional<Baseline> baseline;
+    if (!options.compare.empty()) {
+        baseline = read_baseline(options.compare);
+        if (!baseline) {
+            return 2;
+        }
+        const auto compare = options.compare;
+        const auto output = options.output;
+        const auto tolerance = options.tolerance;
+        const auto min_time = options.min_time;
+        options = baseline->options;
+        options.compare = compare;
+        options.output = output;
+        options.tolerance = tolerance;
+        options.min_time = min_time;
+    }
+
+    if (options.threads.empty()) {
+        const int cpus = std::max<int>(1, allowed_cpus().size());
+        for (int threads = 1; threads < cpus; threads *= 2) {
+            options.threads.push_back(threads);
+        }
+        options.threads.push_back(cpus);
+    }
+
+    const auto results = run_scaling(options);
+
+    if (!options.output.empty()) {
+        std::ofstream outfile(options.output);
+        write_json(outfile, options, results);
+        if (!outfile) {
+            std::cerr << "Error: Failed writing output file: " << options.output << "\n";
+            return 1;
+        }
+        std::cerr << "Wrote scaling results to: " << options.output << "\n";
+    }
+    else if (!baseline) {
+        write_json(std::cout, options, results);
+    }
+
+    if (baseline) {
+        if (!compare_results(baseline->results, results, options.tolerance, options.min_time)) {
+            std::cerr << "Error: Phases regressed by more than " << 100.0 * options.tolerance
+                      << "% against " << options.compare << "\n";
+            return 3;
+        }
+        std::cout << "No regressions against " << options.compare << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "stdinc.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+// Helpers shared by the benchmark tools
+
+[[nodiscard]] inline int benchmark_threads() noexcept {
+    #ifdef _OPENMP
+    return omp_get_max_threads();
+    #else
+    return 1;
+    #endif
+}
+
+// Time one warm-up and `repetitions` timed runs of body()
+template <typename Body>
+[[nodiscard]] std::vector<double> time_repeated(int repetitions, Body&& body) {
+    body();
+    std::vector<double> seconds;
+    for (int r = 0; r < repetitions; ++r) {
+        Timer timer;
+        body();
+        seconds.push_back(timer.elapsed());
+    }
+    return seconds;
+}
+
+// As above, with prepare() run untimed before every run
+template <typename Body, typename Prepare>
+[[nodiscard]] std::vector<double> time_repeated(int repetitions, Body&& body, Prepare&& prepare) {
+    prepare();
+    body();
+    std::vector<double> seconds;
+    for (int r = 0; r < repetitions; ++r) {
+        prepare();
+        Timer timer;
+        body();
+        seconds.push_back(timer.elapsed());
+    }
+    return seconds;
+}
+
+// Value at quantile q of sorted values (nearest rank)
+[[nodiscard]] inline double quantile(const std::vector<double>& sorted, double q) noexcept {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const double rank = std::ceil(q * static_cast<double>(sorted.size()));
+    const std::size_t index = rank < 1.0 ? 0 : static_cast<std::size_t>(rank) - 1;
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// JSON number; JSON has no infinities or NaN
+[[nodiscard]] inline std::string json_number(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    std::ostringstream oss;
+    oss << std::setprecision(9) << value;
+    return oss.str();
+}
+
+// Comma-separated values, each parsed by parse(item) into an optional;
+// false if any is invalid or the list is empty
+template <typename T, typename Parse>
+bool parse_list(std::string_view text, std::vector<T>& values, Parse&& parse) {
+    values.clear();
+    while (!text.empty()) {
+        const auto comma = text.find(',');
+        const std::string item(text.substr(0, comma));
+        text = (comma == std::string_view::npos) ? std::string_view{} : text.substr(comma + 1);
+
+        try {
+            const auto value = parse(item);
+            if (!value) {
+                return false;
+            }
+            values.push_back(*value);
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+} // namespace barnes_hut
@@ -0,0 +1,337 @@
+#include "binary_file.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+namespace {
+
+constexpr char PARTICLE_MAGIC[4] = {'B', 'H', 'P', 'F'};
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct ParticleFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t dimension;
+    std::uint32_t byte_order;
+    std::uint64_t particle_count;
+    std::uint64_t particles_per_leaf;
+    double start_time;
+    double end_time;
+    double time_step;
+    double theta;
+    double box_size;
+    std::uint64_t column_stride;  // Bytes from one column to the next
+};
+
+constexpr std::size_t align_up(std::size_t bytes) noexcept {
+    const std::size_t a = BinaryParticleFile::COLUMN_ALIGNMENT;
+    return (bytes + a - 1) / a * a;
+}
+
+constexpr std::size_t DATA_OFFSET = align_up(sizeof(ParticleFileHeader));
+
+} // namespace
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<std::byte*>(data_), size_);
+    }
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+    }
+    return *this;
+}
+
+std::optional<MappedFile> MappedFile::open(std::string_view filename) {
+    const std::string name(filename);
+    const int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        std::cerr << "Error: Could not map empty or unreadable file: " << filename << "\n";
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    const auto size = static_cast<std::size_t>(info.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps the file referenced
+
+    if (data == MAP_FAILED) {
+        std::cerr << "Error: Could not map file: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    // Columns are streamed front to back; let the kernel read ahead
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    MappedFile file;
+    file.data_ = static_cast<const std::byte*>(data);
+    file.size_ = size;
+    return file;
+}
+
+std::optional<BinaryParticleFile> BinaryParticleFile::open(std::string_view filename) {
+    auto mapping = MappedFile::open(filename);
+    if (!mapping) {
+        return std::nullopt;
+    }
+
+    ParticleFileHeader header{};
+    if (mapping->size() < sizeof(header)) {
+        std::cerr << "Error: Truncated binary particle file: " << filename << "\n";
+        return std::nullopt;
+    }
+    std::memcpy(&header, mapping->data(), sizeof(header));
+
+    if (!std::equal(std::begin(PARTICLE_MAGIC), std::end(PARTICLE_MAGIC), header.magic)) {
+        std::cerr << "Error: Not a binary particle file: " << filename << "\n";
+        return std::nullopt;
+    }
+    if (header.version != FORMAT_VERSION || header.byte_order != BYTE_ORDER_MARK) {
+        std::cerr << "Error: Unsupported binary particle file version or byte order: " << filename << "\n";
+        return std::nullopt;
+    }
+    if (header.dimension != 2 && header.dimension != 3) {
+        std::cerr << "Error: Invalid dimension in binary particle file: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    BinaryParticleFile file;
+    file.dimension_ = static_cast<int>(header.dimension);
+    file.config_.particle_count = header.particle_count;
+    file.config_.start_time = header.start_time;
+    file.config_.end_time = header.end_time;
+    file.config_.time_step = header.time_step;
+    file.config_.theta = header.theta;
+    file.config_.particles_per_leaf = header.particles_per_leaf;
+    file.config_.box_size = header.box_size;
+
+    if (!file.config_.is_valid()) {
+        std::cerr << "Error: Invalid configuration in binary particle file: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    const std::size_t columns = 1 + 2 * static_cast<std::size_t>(file.dimension_);
+    const std::size_t n = file.config_.particle_count;
+
+    // Bound the sizes before multiplying: a corrupt count or stride would
+    // wrap the products and pass the checks below
+    if (n > (SIZE_MAX - DATA_OFFSET) / sizeof(Real) || header.column_stride == 0) {
+        std::cerr << "Error: Invalid configuration in binary particle file: " << filename << "\n";
+        return std::nullopt;
+    }
+    if (mapping->size() < DATA_OFFSET || columns > (mapping->size() - DATA_OFFSET) / header.column_stride) {
+        std::cerr << "Error: Truncated binary particle file: " << filename << "\n";
+        return std::nullopt;
+    }
+    if (header.column_stride % COLUMN_ALIGNMENT != 0 ||
+        header.column_stride < n * sizeof(Real) ||
+        mapping->size() < DATA_OFFSET + columns * header.column_stride) {
+        std::cerr << "Error: Truncated binary particle file: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    file.data_offset_ = DATA_OFFSET;
+    file.column_stride_ = header.column_stride;
+    file.mapping_ = std::move(*mapping);
+    return file;
+}
+
+std::span<const Real> BinaryParticleFile::column(int index) const noexcept {
+    const std::byte* start = mapping_.data() + data_offset_ + static_cast<std::size_t>(index) * column_stride_;
+    return {reinterpret_cast<const Real*>(start), config_.particle_count};
+}
+
+template <int Dim>
+std::optional<std::vector<BasicParticle<Dim>>> BinaryParticleFile::particles() const {
+    if (Dim != dimension_) {
+        std::cerr << "Error: Binary particle file holds " << dimension_
+                  << "D particles, " << Dim << "D requested\n";
+        return std::nullopt;
+    }
+
+    const auto masses = mass();
+    const auto invalid = std::find_if(masses.begin(), masses.end(), [](Real m) { return !(m > 0.0); });
+    if (invalid != masses.end()) {
+        std::cerr << "Error: Invalid mass for particle " << (invalid - masses.begin()) << " (must be > 0)\n";
+        return std::nullopt;
+    }
+
+    std::array<std::span<const Real>, Dim> pos, vel;
+    for (int k = 0; k < Dim; ++k) {
+        pos[k] = position(k);
+        vel[k] = velocity(k);
+    }
+
+    const Index n = config_.particle_count;
+    std::vector<BasicParticle<Dim>> particles(n);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (Index i = 0; i < n; ++i) {
+        BasicVector<Dim> p, v;
+        for (int k = 0; k < Dim; ++k) {
+            p[k] = pos[k][i];
+            v[k] = vel[k][i];
+        }
+        particles[i] = BasicParticle<Dim>(masses[i], p, v);
+    }
+
+    return particles;
+}
+
+template std::optional<std::vector<Particle2D>> BinaryParticleFile::particles<2>() const;
+template std::optional<std::vector<Particle3D>> BinaryParticleFile::particles<3>() const;
+
+bool is_binary_particle_file(std::string_view filename) {
+    std::ifstream infile(std::string(filename), std::ios::binary);
+    char magic[4] = {};
+    return infile.read(magic, sizeof(magic)) &&
+           std::equal(std::begin(PARTICLE_MAGIC), std::end(PARTICLE_MAGIC), magic);
+}
+
+std::optional<BinaryParticleFileWriter>
+BinaryParticleFileWriter::create(std::string_view filename, const SimulationConfig& config, int dimension) {
+    BinaryParticleFileWriter writer;
+    writer.file_.open(std::string(filename), std::ios::binary | std::ios::trunc);
+    if (!writer.file_) {
+        std::cerr << "Error: Could not create file: " << filename << "\n";
+        return std::nullopt;
+    }
+    writer.filename_ = filename;
+    writer.dimension_ = dimension;
+    writer.particle_count_ = config.particle_count;
+    writer.column_stride_ = align_up(config.particle_count * sizeof(Real));
+
+    ParticleFileHeader header{};
+    std::copy(std::begin(PARTICLE_MAGIC), std::end(PARTICLE_MAGIC), header.magic);
+    header.version = BinaryParticleFile::FORMAT_VERSION;
+    header.dimension = static_cast<std::uint32_t>(dimension);
+    header.byte_order = BYTE_ORDER_MARK;
+    header.particle_count = config.particle_count;
+    header.particles_per_leaf = config.particles_per_leaf;
+    header.start_time = config.start_time;
+    header.end_time = config.end_time;
+    header.time_step = config.time_step;
+    header.theta = config.theta;
+    header.box_size = config.box_size;
+    header.column_stride = writer.column_stride_;
+
+    writer.file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return writer;
+}
+
+template <int Dim>
+bool BinaryParticleFileWriter::write(Index first, std::span<const BasicParticle<Dim>> particles) {
+    if (Dim != dimension_ || first + particles.size() > particle_count_) {
+        std::cerr << "Error: Particles do not fit binary particle file: " << filename_ << "\n";
+        return false;
+    }
+
+    // Gather one column at a time through a fixed-size buffer
+    constexpr std::size_t CHUNK = 1 << 16;
+    buffer_.reserve(std::min(particles.size(), CHUNK));
+
+    int column = 0;
+    auto write_column = [&](auto&& value) {
+        file_.seekp(static_cast<std::streamoff>(DATA_OFFSET + column++ * column_stride_ + first * sizeof(Real)));
+        for (std::size_t begin = 0; begin < particles.size(); begin += CHUNK) {
+            const std::size_t end = std::min(begin + CHUNK, particles.size());
+            buffer_.clear();
+            for (std::size_t i = begin; i < end; ++i) {
+                buffer_.push_back(value(particles[i]));
+            }
+            file_.write(reinterpret_cast<const char*>(buffer_.data()),
+                        static_cast<std::streamsize>(buffer_.size() * sizeof(Real)));
+        }
+    };
+
+    write_column([](const auto& p) { return p.mass(); });
+    for (int k = 0; k < Dim; ++k) {
+        write_column([k](const auto& p) { return p.position()[k]; });
+    }
+    for (int k = 0; k < Dim; ++k) {
+        write_column([k](const auto& p) { return p.velocity()[k]; });
+    }
+
+    if (!file_) {
+        std::cerr << "Error: Failed to write binary particle file: " << filename_ << "\n";
+        return false;
+    }
+    return true;
+}
+
+template bool BinaryParticleFileWriter::write<2>(Index, std::span<const Particle2D>);
+template bool BinaryParticleFileWriter::write<3>(Index, std::span<const Particle3D>);
+
+bool BinaryParticleFileWriter::close() {
+    // Column padding the writes skipped over reads as zeros; the file only
+    // has to extend to the end of the last column
+    const std::size_t columns = 1 + 2 * static_cast<std::size_t>(dimension_);
+    const std::size_t size = DATA_OFFSET + columns * column_stride_;
+    file_.seekp(0, std::ios::end);
+    if (static_cast<std::size_t>(file_.tellp()) < size) {
+        file_.seekp(static_cast<std::streamoff>(size - 1));
+        file_.put('\0');
+    }
+    file_.close();
+
+    if (!file_) {
+        std::cerr << "Error: Failed to write binary particle file: " << filename_ << "\n";
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+template <int Dim>
+bool write_binary(std::string_view filename, SimulationConfig config,
+                  std::span<const BasicParticle<Dim>> particles) {
+    config.particle_count = particles.size();
+    auto writer = BinaryParticleFileWriter::create(filename, config, Dim);
+    return writer && writer->write(0, particles) && writer->close();
+}
+
+} // namespace
+
+bool write_binary_particle_file(std::string_view filename, const SimulationConfig& config,
+                                std::span<const Particle2D> particles) {
+    return write_binary(filename, config, particles);
+}
+
+bool write_binary_particle_file(std::string_view filename, const SimulationConfig& config,
+                                std::span<const Particle3D> particles) {
+    return write_binary(filename, config, particles);
+}
+
+} // namespace barnes_hut
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "file.h"
+#include "particle.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace barnes_hut {
+
+// Read-only memory mapping of a whole file (RAII, move-only)
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map filename; std::nullopt (with a message) if it cannot be opened or mapped
+    [[nodiscard]] static std::optional<MappedFile> open(std::string_view filename);
+
+    [[nodiscard]] const std::byte* data() const noexcept { return data_; }
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+private:
+    const std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Binary particle file.
+//
+// Layout (native little-endian doubles):
+//   header       magic "BHPF", version, dimension, SimulationConfig
+//   columns      mass, position[0..Dim), velocity[0..Dim), each n doubles
+//                starting on a COLUMN_ALIGNMENT boundary
+//
+// A file is opened by mapping it; the columns are served as spans straight
+// from the mapping, so loading does no parsing and no copies beyond
+// constructing the particles.
+class BinaryParticleFile {
+public:
+    static constexpr std::uint32_t FORMAT_VERSION = 1;
+    static constexpr std::size_t COLUMN_ALIGNMENT = 64;
+
+    // Map and validate filename
+    [[nodiscard]] static std::optional<BinaryParticleFile> open(std::string_view filename);
+
+    [[nodiscard]] int dimension() const noexcept { return dimension_; }
+    [[nodiscard]] const SimulationConfig& config() const noexcept { return config_; }
+
+    // Structure-of-arrays view of the mapped columns
+    [[nodiscard]] std::span<const Real> mass() const noexcept { return column(0); }
+    [[nodiscard]] std::span<const Real> position(int k) const noexcept { return column(1 + k); }
+    [[nodiscard]] std::span<const Real> velocity(int k) const noexcept { return column(1 + dimension_ + k); }
+
+    // Construct particles from the columns (Dim must match dimension())
+    template <int Dim>
+    [[nodiscard]] std::optional<std::vector<BasicParticle<Dim>>> particles() const;
+
+private:
+    BinaryParticleFile() = default;
+
+    [[nodiscard]] std::span<const Real> column(int index) const noexcept;
+
+    MappedFile mapping_;
+    SimulationConfig config_;
+    int dimension_ = NDIM;
+    std::size_t data_offset_ = 0;
+    std::size_t column_stride_ = 0;
+};
+
+// True if filename starts with the binary particle file magic
+[[nodiscard]] bool is_binary_particle_file(std::string_view filename);
+
+// Writes a binary particle file chunk by chunk, so particles that are
+// produced in pieces (e.g. generated) never have to be in memory at once.
+// Each write() stores its particles at their place in every column.
+class BinaryParticleFileWriter {
+public:
+    // Create (truncate) filename for config.particle_count particles
+    [[nodiscard]] static std::optional<BinaryParticleFileWriter>
+    create(std::string_view filename, const SimulationConfig& config, int dimension);
+
+    // Store particles first .. first + particles.size() - 1 (Dim must match)
+    template <int Dim>
+    bool write(Index first, std::span<const BasicParticle<Dim>> particles);
+
+    // Complete the file; false if any write failed
+    bool close();
+
+private:
+    BinaryParticleFileWriter() = default;
+
+    std::ofstream file_;
+    std::string filename_;
+    int dimension_ = NDIM;
+    Index particle_count_ = 0;
+    std::size_t column_stride_ = 0;
+    std::vector<Real> buffer_;
+};
+
+// Write particles and config in the binary format
+bool write_binary_particle_file(std::string_view filename, const SimulationConfig& config,
+                                std::span<const Particle2D> particles);
+
+bool write_binary_particle_file(std::string_view filename, const SimulationConfig& config,
+                                std::span<const Particle3D> particles);
+
+} // namespace barnes_hut
@@ -0,0 +1,396 @@
+#include "checkpoint.h"
+#include "binary_file.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+namespace {
+
+constexpr char CHECKPOINT_MAGIC[4] = {'B', 'H', 'C', 'K'};
+constexpr std::uint32_t FORMAT_VERSION = 2;
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct CheckpointHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t dimension;
+    std::uint32_t byte_order;
+    std::uint64_t particle_count;
+    std::uint64_t particles_per_leaf;
+    double start_time;
+    double end_time;
+    double time_step;
+    double theta;
+    double box_size;
+    char softening[16];
+    double softening_length;
+    std::uint32_t backend;
+    std::uint32_t use_ewald;
+    std::uint32_t opening_criterion;
+    std::uint32_t reserved;
+    std::uint64_t step;
+    double time;
+    double next_output_time;
+    std::uint64_t snapshot_number;
+    double initial_energy;
+    std::uint64_t record_size;
+};
+
+template <int Dim>
+struct ParticleRecord {
+    double mass;
+    double softening;
+    double position[Dim];
+    double velocity[Dim];
+    double force[Dim];
+    double potential;
+    std::uint64_t id;
+};
+
+// Records packed per write() call
+constexpr Index WRITE_CHUNK = 1 << 16;
+
+bool write_all(int fd, const void* data, std::size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = ::write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+template <int Dim>
+void pack_record(const BasicParticle<Dim>& particle, ParticleRecord<Dim>& record) noexcept {
+    record.mass = particle.mass();
+    record.softening = particle.softening();
+    for (int k = 0; k < Dim; ++k) {
+        record.position[k] = particle.position()[k];
+        record.velocity[k] = particle.velocity()[k];
+        record.force[k] = particle.force()[k];
+    }
+    record.potential = particle.potential();
+    record.id = particle.id();
+}
+
+// parallel = false keeps OpenMP out of forked children, whose thread pool
+// did not survive the fork
+template <int Dim>
+bool write_records(int fd, const CheckpointHeader& header, std::span<const BasicParticle<Dim>> particles,
+                   bool parallel) {
+    using Record = ParticleRecord<Dim>;
+
+    if (!write_all(fd, &header, sizeof(header))) {
+        return false;
+    }
+
+    std::vector<Record> records(std::min<Index>(particles.size(), WRITE_CHUNK));
+    for (Index begin = 0; begin < particles.size(); begin += WRITE_CHUNK) {
+        const Index count = std::min<Index>(particles.size() - begin, WRITE_CHUNK);
+
+        if (parallel) {
+            #ifdef _OPENMP
+            #pragma omp parallel for
+            #endif
+            for (Index i = 0; i < count; ++i) {
+                pack_record(particles[begin + i], records[i]);
+            }
+        }
+        else {
+            for (Index i = 0; i < count; ++i) {
+                pack_record(particles[begin + i], records[i]);
+            }
+        }
+
+        if (!write_all(fd, records.data(), count * sizeof(Record))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <int Dim>
+bool write_checkpoint_impl(std::string_view filename, const CheckpointState& state,
+                           std::span<const BasicParticle<Dim>> particles, bool parallel = true) {
+    CheckpointHeader header{};
+    std::copy(std::begin(CHECKPOINT_MAGIC), std::end(CHECKPOINT_MAGIC), header.magic);
+    header.version = FORMAT_VERSION;
+    header.dimension = Dim;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.particle_count = particles.size();
+    header.particles_per_leaf = state.config.particles_per_leaf;
+    header.start_time = state.config.start_time;
+    header.end_time = state.config.end_time;
+    header.time_step = state.config.time_step;
+    header.theta = state.config.theta;
+    header.box_size = state.config.box_size;
+    state.softening.copy(header.softening, sizeof(header.softening) - 1);
+    header.softening_length = state.softening_length;
+    header.backend = static_cast<std::uint32_t>(state.backend);
+    header.use_ewald = state.use_ewald ? 1 : 0;
+    header.opening_criterion = static_cast<std::uint32_t>(state.opening_criterion);
+    header.step = state.step;
+    header.time = state.time;
+    header.next_output_time = state.next_output_time;
+    header.snapshot_number = state.snapshot_number;
+    header.initial_energy = state.initial_energy;
+    header.record_size = sizeof(ParticleRecord<Dim>);
+
+    const std::string target(filename);
+    const std::string temporary = target + ".tmp";
+
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create checkpoint file: " << temporary << "\n";
+        return false;
+    }
+
+    // Data must be on disk before the rename makes it the checkpoint
+    const bool written = write_records(fd, header, particles, parallel) && ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !written) {
+        std::cerr << "Error: Failed writing checkpoint file: " << temporary << "\n";
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+        std::cerr << "Error: Could not rename " << temporary << " to " << target << "\n";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+struct MappedCheckpoint {
+    MappedFile mapping;
+    CheckpointState state;
+};
+
+std::optional<MappedCheckpoint> open_checkpoint(std::string_view filename) {
+    auto mapping = MappedFile::open(filename);
+    if (!mapping) {
+        return std::nullopt;
+    }
+
+    CheckpointHeader header{};
+    if (mapping->size() < sizeof(header)) {
+        std::cerr << "Error: Truncated checkpoint file: " << filename << "\n";
+        return std::nullopt;
+    }
+    std::memcpy(&header, mapping->data(), sizeof(header));
+
+    if (!std::equal(std::begin(CHECKPOINT_MAGIC), std::end(CHECKPOINT_MAGIC), header.magic)) {
+        std::cerr << "Error: Not a checkpoint file: " << filename << "\n";
+        return std::nullopt;
+    }
+    if (header.version != FORMAT_VERSION || header.byte_order != BYTE_ORDER_MARK) {
+        std::cerr << "Error: Unsupported checkpoint version or byte order: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    const std::size_t record_size = (header.dimension == 2) ? sizeof(ParticleRecord<2>)
+                                  : (header.dimension == 3) ? sizeof(ParticleRecord<3>) : 0;
+    if (record_size == 0 || header.record_size != record_size ||
+        header.backend > static_cast<std::uint32_t>(ForceBackend::Direct) ||
+        header.opening_criterion > static_cast<std::uint32_t>(OpeningCriterion::MaxDistance)) {
+        std::cerr << "Error: Invalid checkpoint header: " << filename << "\n";
+        return std::nullopt;
+    }
+    if (mapping->size() != sizeof(header) + header.particle_count * record_size) {
+        std::cerr << "Error: Truncated checkpoint file: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    MappedCheckpoint checkpoint{std::move(*mapping), {}};
+    CheckpointState& state = checkpoint.state;
+    state.dimension = static_cast<int>(header.dimension);
+    state.config.particle_count = header.particle_count;
+    state.config.start_time = header.start_time;
+    state.config.end_time = header.end_time;
+    state.config.time_step = header.time_step;
+    state.config.theta = header.theta;
+    state.config.particles_per_leaf = header.particles_per_leaf;
+    state.config.box_size = header.box_size;
+    state.softening.assign(header.softening, strnlen(header.softening, sizeof(header.softening)));
+    state.softening_length = header.softening_length;
+    state.backend = static_cast<ForceBackend>(header.backend);
+    state.use_ewald = header.use_ewald != 0;
+    state.opening_criterion = static_cast<OpeningCriterion>(header.opening_criterion);
+    state.step = header.step;
+    state.time = header.time;
+    state.next_output_time = header.next_output_time;
+    state.snapshot_number = header.snapshot_number;
+    state.initial_energy = header.initial_energy;
+
+    if (!state.config.is_valid()) {
+        std::cerr << "Error: Invalid configuration in checkpoint file: " << filename << "\n";
+        return std::nullopt;
+    }
+    return checkpoint;
+}
+
+} // namespace
+
+bool write_checkpoint(std::string_view filename, const CheckpointState& state,
+                      std::span<const Particle2D> particles) {
+    return write_checkpoint_impl(filename, state, particles);
+}
+
+bool write_checkpoint(std::string_view filename, const CheckpointState& state,
+                      std::span<const Particle3D> particles) {
+    return write_checkpoint_impl(filename, state, particles);
+}
+
+ForkedCheckpointWriter::~ForkedCheckpointWriter() {
+    wait();
+}
+
+bool ForkedCheckpointWriter::submit(std::string_view filename, const CheckpointState& state,
+                                    std::span<const Particle2D> particles) {
+    return fork_and_write(filename, state, particles);
+}
+
+bool ForkedCheckpointWriter::submit(std::string_view filename, const CheckpointState& state,
+                                    std::span<const Particle3D> particles) {
+    return fork_and_write(filename, state, particles);
+}
+
+template <int Dim>
+bool ForkedCheckpointWriter::fork_and_write(std::string_view filename, const CheckpointState& state,
+                                            std::span<const BasicParticle<Dim>> particles) {
+    bool previous_written = true;
+    if (in_flight()) {
+        Timer stall_timer;
+        previous_written = wait();
+        stall_seconds_ += stall_timer.elapsed();
+    }
+
+    // Anything still buffered would otherwise be flushed twice
+    std::cout.flush();
+
+    Timer fork_timer;
+    const pid_t pid = ::fork();
+    fork_seconds_ += fork_timer.elapsed();
+
+    if (pid == 0) {
+        // Child: write from the copy-on-write view and leave without running
+        // the parent's destructors or atexit handlers
+        const bool written = write_checkpoint_impl(filename, state, particles, false);
+        ::_exit(written ? 0 : 1);
+    }
+
+    if (pid < 0) {
+        std::cerr << "Warning: fork() failed; writing checkpoint synchronously\n";
+        const bool written = write_checkpoint_impl(filename, state, particles);
+        if (written) {
+            std::cout << "Wrote checkpoint at step " << state.step << " to: " << filename << "\n";
+        }
+        return previous_written && written;
+    }
+
+    child_ = pid;
+    filename_ = std::string(filename);
+    step_ = state.step;
+    return previous_written;
+}
+
+bool ForkedCheckpointWriter::poll() {
+    return reap(false);
+}
+
+bool ForkedCheckpointWriter::wait() {
+    return reap(true);
+}
+
+bool ForkedCheckpointWriter::reap(bool block) {
+    if (!in_flight()) {
+        return true;
+    }
+
+    int status = 0;
+    pid_t result;
+    do {
+        result = ::waitpid(child_, &status, block ? 0 : WNOHANG);
+    } while (result < 0 && errno == EINTR);
+
+    if (result == 0) {
+        return true;  // Still writing
+    }
+    child_ = -1;
+
+    if (result < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "Error: Checkpoint process for step " << step_ << " failed: " << filename_ << "\n";
+        return false;
+    }
+    std::cout << "Wrote checkpoint at step " << step_ << " to: " << filename_ << "\n";
+    return true;
+}
+
+std::optional<CheckpointState> read_checkpoint_state(std::string_view filename) {
+    auto checkpoint = open_checkpoint(filename);
+    return checkpoint ? std::optional{std::move(checkpoint->state)} : std::nullopt;
+}
+
+template <int Dim>
+std::optional<std::vector<BasicParticle<Dim>>> read_checkpoint_particles(std::string_view filename) {
+    const auto checkpoint = open_checkpoint(filename);
+    if (!checkpoint) {
+        return std::nullopt;
+    }
+    if (checkpoint->state.dimension != Dim) {
+        std::cerr << "Error: Checkpoint holds " << checkpoint->state.dimension
+                  << "D particles, " << Dim << "D requested\n";
+        return std::nullopt;
+    }
+
+    using Record = ParticleRecord<Dim>;
+    const Index n = checkpoint->state.config.particle_count;
+    const std::byte* const records = checkpoint->mapping.data() + sizeof(CheckpointHeader);
+    std::vector<BasicParticle<Dim>> particles(n);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (Index i = 0; i < n; ++i) {
+        Record record;
+        std::memcpy(&record, records + i * sizeof(Record), sizeof(Record));
+
+        BasicVector<Dim> position, velocity, force;
+        for (int k = 0; k < Dim; ++k) {
+            position[k] = record.position[k];
+            velocity[k] = record.velocity[k];
+            force[k] = record.force[k];
+        }
+        auto& particle = particles[i];
+        particle = BasicParticle<Dim>(record.mass, position, velocity);
+        particle.set_softening(record.softening);
+        particle.set_force(force);
+        particle.set_potential(record.potential);
+        particle.set_id(record.id);
+    }
+
+    return particles;
+}
+
+template std::optional<std::vector<Particle2D>> read_checkpoint_particles<2>(std::string_view);
+template std::optional<std::vector<Particle3D>> read_checkpoint_particles<3>(std::string_view);
+
+} // namespace barnes_hut
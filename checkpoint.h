@@ -0,0 +1,103 @@
+#pragma once
+
+#include "file.h"
+#include "particle.h"
+#include "solver.h"
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace barnes_hut {
+
+// Everything besides the particles that a run needs to continue exactly
+// where it stopped: the resolved solver setup and the simulation loop state.
+struct CheckpointState {
+    int dimension = NDIM;
+    SimulationConfig config;
+
+    std::string softening;          // Softening policy name
+    Real softening_length = 0.0;
+    ForceBackend backend = ForceBackend::Tree;
+    OpeningCriterion opening_criterion = OpeningCriterion::Geometric;
+    bool use_ewald = true;
+
+    Index step = 0;                 // Completed steps
+    Real time = 0.0;
+    Real next_output_time = 0.0;
+    Index snapshot_number = 1;      // Number of the next snapshot file
+    Real initial_energy = 0.0;      // Energy reference for dE/E0
+};
+
+// Checkpoint file.
+//
+// Layout (native byte order):
+//   header       magic "BHCK", version, dimension, CheckpointState
+//   particles    one record per particle: mass, softening, position, velocity,
+//                force, potential, id
+//
+// The file is written to <filename>.tmp, synced and renamed over filename, so
+// an interrupted write never replaces the previous checkpoint. Particles are
+// stored in solver order with all bits of every value: resuming from a
+// checkpoint reproduces the uninterrupted run exactly.
+bool write_checkpoint(std::string_view filename, const CheckpointState& state,
+                      std::span<const Particle2D> particles);
+
+bool write_checkpoint(std::string_view filename, const CheckpointState& state,
+                      std::span<const Particle3D> particles);
+
+// Writes checkpoints from a fork()ed child process.
+//
+// submit() forks at a step boundary: the child writes the checkpoint from its
+// copy-on-write view of the particles and exits, while the parent continues
+// at once. The simulation pauses only for the fork itself (page-table copy);
+// pages the parent modifies meanwhile are copied, so memory use can grow up
+// to twice the particle data while a checkpoint is in flight.
+// At most one checkpoint is in flight: submit() first waits for the previous
+// one. If fork() fails, the checkpoint is written synchronously instead.
+class ForkedCheckpointWriter {
+public:
+    ForkedCheckpointWriter() = default;
+    ~ForkedCheckpointWriter();  // Waits for the checkpoint in flight
+
+    ForkedCheckpointWriter(const ForkedCheckpointWriter&) = delete;
+    ForkedCheckpointWriter& operator=(const ForkedCheckpointWriter&) = delete;
+
+    bool submit(std::string_view filename, const CheckpointState& state, std::span<const Particle2D> particles);
+    bool submit(std::string_view filename, const CheckpointState& state, std::span<const Particle3D> particles);
+
+    // Reap a finished checkpoint without blocking; false if it failed
+    bool poll();
+
+    // Wait for the checkpoint in flight; false if it failed
+    bool wait();
+
+    [[nodiscard]] bool in_flight() const noexcept { return child_ > 0; }
+
+    // Time spent in fork(), and waiting for the previous checkpoint in submit()
+    [[nodiscard]] double fork_seconds() const noexcept { return fork_seconds_; }
+    [[nodiscard]] double stall_seconds() const noexcept { return stall_seconds_; }
+
+private:
+    template <int Dim>
+    bool fork_and_write(std::string_view filename, const CheckpointState& state,
+                        std::span<const BasicParticle<Dim>> particles);
+    bool reap(bool block);
+
+    int child_ = -1;        // pid of the writing child
+    std::string filename_;  // Checkpoint the child is writing
+    Index step_ = 0;
+    double fork_seconds_ = 0.0;
+    double stall_seconds_ = 0.0;
+};
+
+// Read the state of a checkpoint (validating its size)
+[[nodiscard]] std::optional<CheckpointState> read_checkpoint_state(std::string_view filename);
+
+// Read the particles of a Dim-dimensional checkpoint
+template <int Dim>
+[[nodiscard]] std::optional<std::vector<BasicParticle<Dim>>>
+read_checkpoint_particles(std::string_view filename);
+
+} // namespace barnes_hut
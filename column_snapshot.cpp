@@ -0,0 +1,568 @@
+#include "column_snapshot.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[4] = {'B', 'H', 'C', 'S'};
+
+struct ColumnSnapshotHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t dimension;
+    std::uint32_t field_mask;
+    std::uint64_t particle_count;
+    std::uint64_t chunk_size;
+    double time;
+    double tolerance;
+    std::uint64_t message_size;  // Message bytes follow the header
+    std::uint64_t index_offset;
+};
+
+struct IndexEntry {
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+// Field bits in the header, in column order
+constexpr std::uint32_t FIELD_POSITION = 1u << 0;
+constexpr std::uint32_t FIELD_VELOCITY = 1u << 1;
+constexpr std::uint32_t FIELD_FORCE = 1u << 2;
+constexpr std::uint32_t FIELD_POTENTIAL = 1u << 3;
+constexpr std::uint32_t FIELD_ID = 1u << 4;
+constexpr std::uint32_t FIELD_ALL = (1u << 5) - 1;
+
+struct ColumnSpec {
+    std::string name;
+    std::uint32_t field;
+    int component;
+};
+
+std::vector<ColumnSpec> column_specs(std::uint32_t mask, int dimension) {
+    constexpr std::array<const char*, 3> axes = {"x", "y", "z"};
+    std::vector<ColumnSpec> specs;
+
+    auto add_vector = [&](std::uint32_t field, const char* name) {
+        if (mask & field) {
+            for (int k = 0; k < dimension; ++k) {
+                specs.push_back({std::string(name) + "." + axes[k], field, k});
+            }
+        }
+    };
+    add_vector(FIELD_POSITION, "position");
+    add_vector(FIELD_VELOCITY, "velocity");
+    add_vector(FIELD_FORCE, "force");
+    if (mask & FIELD_POTENTIAL) {
+        specs.push_back({"potential", FIELD_POTENTIAL, 0});
+    }
+    if (mask & FIELD_ID) {
+        specs.push_back({"id", FIELD_ID, 0});
+    }
+    return specs;
+}
+
+std::uint32_t field_mask(const ColumnSnapshotOptions& options) {
+    return (options.position ? FIELD_POSITION : 0u) |
+           (options.velocity ? FIELD_VELOCITY : 0u) |
+           (options.force ? FIELD_FORCE : 0u) |
+           (options.potential ? FIELD_POTENTIAL : 0u) |
+           (options.id ? FIELD_ID : 0u);
+}
+
+template <int Dim>
+Real column_value(const BasicParticle<Dim>& particle, const ColumnSpec& spec) noexcept {
+    switch (spec.field) {
+        case FIELD_POSITION:
+            return particle.position()[spec.component];
+        case FIELD_VELOCITY:
+            return particle.velocity()[spec.component];
+        case FIELD_FORCE:
+            return particle.force()[spec.component];
+        case FIELD_POTENTIAL:
+            return particle.potential();
+        default:
+            return static_cast<Real>(particle.id());  // Exact below 2^53
+    }
+}
+
+// Round to 52 - drop mantissa bits (round half up); inf and nan pass through
+Real round_mantissa(Real value, int drop) noexcept {
+    constexpr std::uint64_t EXPONENT_MASK = 0x7FFull << 52;
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if (drop == 0 || (bits & EXPONENT_MASK) == EXPONENT_MASK) {
+        return value;
+    }
+
+    const std::uint64_t keep = ~((std::uint64_t{1} << drop) - 1);
+    std::uint64_t rounded = (bits + (std::uint64_t{1} << (drop - 1))) & keep;
+    if ((rounded & EXPONENT_MASK) == EXPONENT_MASK) {
+        rounded = bits & keep;  // Do not round up to infinity
+    }
+
+    std::memcpy(&value, &rounded, sizeof(value));
+    return value;
+}
+
+// Mantissa bits that can be dropped while keeping relative error <= tolerance
+int dropped_mantissa_bits(Real tolerance) noexcept {
+    if (tolerance <= 0.0) {
+        return 0;
+    }
+    // Rounding to k mantissa bits has relative error <= 2^-(k+1)
+    const Real kept = std::ceil(-std::log2(tolerance) - 1.0);
+    return 52 - static_cast<int>(std::clamp(kept, 0.0, 52.0));
+}
+
+// Byte shuffle of 8-byte words: byte b of word i goes to b * count + i
+void shuffle(const Real* values, std::size_t count, std::uint8_t* out) noexcept {
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(values);
+    for (std::size_t i = 0; i < count; ++i) {
+        for (std::size_t b = 0; b < sizeof(Real); ++b) {
+            out[b * count + i] = bytes[i * sizeof(Real) + b];
+        }
+    }
+}
+
+void unshuffle(const std::uint8_t* in, std::size_t count, Real* values) noexcept {
+    auto* bytes = reinterpret_cast<std::uint8_t*>(values);
+    for (std::size_t i = 0; i < count; ++i) {
+        for (std::size_t b = 0; b < sizeof(Real); ++b) {
+            bytes[i * sizeof(Real) + b] = in[b * count + i];
+        }
+    }
+}
+
+// LZ77 byte coder (LZ4-style sequences):
+//   token          literal count (high nibble), match length - 4 (low nibble)
+//   [length bytes] literal count - 15 as 255-continued bytes, if the nibble is 15
+//   literals
+//   offset         2 bytes, little-endian (absent after the final literals)
+//   [length bytes] match length - 19, if the nibble is 15
+constexpr std::size_t LZ_MIN_MATCH = 4;
+constexpr std::size_t LZ_MAX_OFFSET = 65535;
+constexpr int LZ_HASH_BITS = 14;
+
+void write_length(std::vector<std::uint8_t>& out, std::size_t length) {
+    for (; length >= 255; length -= 255) {
+        out.push_back(255);
+    }
+    out.push_back(static_cast<std::uint8_t>(length));
+}
+
+void lz_compress(std::span<const std::uint8_t> in, std::vector<std::uint8_t>& out) {
+    const std::size_t n = in.size();
+    std::vector<std::uint32_t> table(std::size_t{1} << LZ_HASH_BITS, 0);  // Position + 1; 0 is empty
+
+    auto read32 = [&](std::size_t i) {
+        std::uint32_t value;
+        std::memcpy(&value, in.data() + i, sizeof(value));
+        return value;
+    };
+
+    auto emit = [&](std::size_t anchor, std::size_t literal_end, std::size_t offset, std::size_t match) {
+        const std::size_t literals = literal_end - anchor;
+        const std::size_t extra = match ? match - LZ_MIN_MATCH : 0;
+        out.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(literals, 15) << 4) |
+                                                std::min<std::size_t>(extra, 15)));
+        if (literals >= 15) {
+            write_length(out, literals - 15);
+        }
+        out.insert(out.end(), in.begin() + anchor, in.begin() + literal_end);
+        if (match) {
+            out.push_back(static_cast<std::uint8_t>(offset & 0xFF));
+            out.push_back(static_cast<std::uint8_t>(offset >> 8));
+            if (extra >= 15) {
+                write_length(out, extra - 15);
+            }
+        }
+    };
+
+    std::size_t i = 0;
+    std::size_t anchor = 0;
+    std::size_t misses = 0;
+    while (i + LZ_MIN_MATCH <= n) {
+        const std::uint32_t value = read32(i);
+        const std::uint32_t hash = (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+        const std::size_t candidate = table[hash];
+        table[hash] = static_cast<std::uint32_t>(i + 1);
+
+        if (candidate != 0 && i - (candidate - 1) <= LZ_MAX_OFFSET && read32(candidate - 1) == value) {
+            const std::size_t source = candidate - 1;
+            std::size_t length = LZ_MIN_MATCH;
+            while (i + length < n && in[source + length] == in[i + length]) {
+                ++length;
+            }
+            emit(anchor, i, i - source, length);
+            i += length;
+            anchor = i;
+            misses = 0;
+        }
+        else {
+            i += 1 + (misses++ >> 6);  // Step faster through incompressible bytes
+        }
+    }
+    emit(anchor, n, 0, 0);
+}
+
+bool lz_decompress(std::span<const std::uint8_t> in, std::span<std::uint8_t> out) noexcept {
+    std::size_t ip = 0;
+    std::size_t op = 0;
+
+    auto read_length = [&](std::size_t& length) {
+        std::uint8_t byte;
+        do {
+            if (ip >= in.size()) {
+                return false;
+            }
+            byte = in[ip++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (ip < in.size()) {
+        const std::uint8_t token = in[ip++];
+
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !read_length(literals)) {
+            return false;
+        }
+        if (literals > in.size() - ip || literals > out.size() - op) {
+            return false;
+        }
+        if (literals > 0) {
+            std::memcpy(out.data() + op, in.data() + ip, literals);
+        }
+        ip += literals;
+        op += literals;
+
+        if (ip == in.size()) {
+            break;  // Final literals
+        }
+        if (in.size() - ip < 2) {
+            return false;
+        }
+        const std::size_t offset = in[ip] | (std::size_t{in[ip + 1]} << 8);
+        ip += 2;
+
+        std::size_t length = token & 15;
+        if (length == 15 && !read_length(length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || length > out.size() - op) {
+            return false;
+        }
+        for (std::size_t k = 0; k < length; ++k, ++op) {
+            out[op] = out[op - offset];  // Byte-wise: matches may overlap
+        }
+    }
+    return op == out.size();
+}
+
+// First byte of every block
+constexpr std::uint8_t BLOCK_RAW = 0;
+constexpr std::uint8_t BLOCK_SHUFFLE_LZ = 1;
+
+std::vector<std::uint8_t> encode_block(std::span<const Real> values) {
+    const std::size_t bytes = values.size() * sizeof(Real);
+
+    std::vector<std::uint8_t> shuffled(bytes);
+    shuffle(values.data(), values.size(), shuffled.data());
+
+    std::vector<std::uint8_t> block;
+    block.reserve(bytes / 2 + 16);
+    block.push_back(BLOCK_SHUFFLE_LZ);
+    lz_compress(shuffled, block);
+
+    if (block.size() > bytes) {
+        block.assign(1, BLOCK_RAW);
+        const auto* raw = reinterpret_cast<const std::uint8_t*>(values.data());
+        block.insert(block.end(), raw, raw + bytes);
+    }
+    return block;
+}
+
+bool decode_block(std::span<const std::uint8_t> block, std::span<Real> values) {
+    const std::size_t bytes = values.size() * sizeof(Real);
+    if (block.empty()) {
+        return false;
+    }
+
+    const auto payload = block.subspan(1);
+    if (block[0] == BLOCK_RAW) {
+        if (payload.size() != bytes) {
+            return false;
+        }
+        std::memcpy(values.data(), payload.data(), bytes);
+        return true;
+    }
+    if (block[0] == BLOCK_SHUFFLE_LZ) {
+        std::vector<std::uint8_t> shuffled(bytes);
+        if (!lz_decompress(payload, shuffled)) {
+            return false;
+        }
+        unshuffle(shuffled.data(), values.size(), values.data());
+        return true;
+    }
+    return false;
+}
+
+template <int Dim>
+bool write_columns(std::string_view filename, std::span<const BasicParticle<Dim>> particles,
+                   std::string_view message, Real time, const ColumnSnapshotOptions& options) {
+    const std::uint32_t mask = field_mask(options);
+    if (mask == 0 || options.chunk_size == 0 || options.tolerance < 0.0) {
+        std::cerr << "Error: Invalid columnar snapshot options\n";
+        return false;
+    }
+
+    const auto specs = column_specs(mask, Dim);
+    const std::size_t n = particles.size();
+    const std::size_t columns = specs.size();
+    const std::size_t chunks = (n + options.chunk_size - 1) / options.chunk_size;
+    const int drop = dropped_mantissa_bits(options.tolerance);
+
+    // Encode every (chunk, column) block independently
+    std::vector<std::vector<std::uint8_t>> blocks(chunks * columns);
+
+    #ifdef _OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        std::vector<Real> values;
+
+        #ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+        #endif
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            const std::size_t begin = (b / columns) * options.chunk_size;
+            const std::size_t end = std::min(begin + options.chunk_size, n);
+            const ColumnSpec& spec = specs[b % columns];
+            const int spec_drop = (spec.field == FIELD_ID) ? 0 : drop;
+
+            values.resize(end - begin);
+            for (std::size_t i = begin; i < end; ++i) {
+                values[i - begin] = round_mantissa(column_value(particles[i], spec), spec_drop);
+            }
+            blocks[b] = encode_block(values);
+        }
+    }
+
+    std::ofstream outfile(std::string(filename), std::ios::binary);
+    if (!outfile) {
+        std::cerr << "Error: Could not create output file: " << filename << "\n";
+        return false;
+    }
+
+    ColumnSnapshotHeader header{};
+    std::copy(std::begin(SNAPSHOT_MAGIC), std::end(SNAPSHOT_MAGIC), header.magic);
+    header.version = ColumnSnapshot::FORMAT_VERSION;
+    header.dimension = Dim;
+    header.field_mask = mask;
+    header.particle_count = n;
+    header.chunk_size = options.chunk_size;
+    header.time = time;
+    header.tolerance = options.tolerance;
+    header.message_size = message.size();
+
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outfile.write(message.data(), static_cast<std::streamsize>(message.size()));
+
+    std::uint64_t offset = sizeof(header) + message.size();
+    std::vector<IndexEntry> index;
+    index.reserve(blocks.size());
+    for (const auto& block : blocks) {
+        outfile.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(block.size()));
+        index.push_back({offset, block.size()});
+        offset += block.size();
+    }
+
+    header.index_offset = offset;
+    outfile.write(reinterpret_cast<const char*>(index.data()),
+                  static_cast<std::streamsize>(index.size() * sizeof(IndexEntry)));
+    outfile.seekp(0);
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (!outfile) {
+        std::cerr << "Error: Failed to write snapshot: " << filename << "\n";
+        return false;
+    }
+
+    const std::uint64_t file_size = offset + index.size() * sizeof(IndexEntry);
+    std::cout << "Wrote snapshot to: " << filename << " (" << file_size << " bytes, "
+              << static_cast<double>(n * columns * sizeof(Real)) / static_cast<double>(file_size)
+              << "x smaller than raw)\n";
+    return true;
+}
+
+} // namespace
+
+bool parse_snapshot_fields(std::string_view list, ColumnSnapshotOptions& options) {
+    ColumnSnapshotOptions parsed = options;
+    parsed.position = parsed.velocity = parsed.force = parsed.potential = parsed.id = false;
+
+    while (!list.empty()) {
+        const std::size_t comma = list.find(',');
+        const std::string_view field = list.substr(0, comma);
+        list = (comma == std::string_view::npos) ? std::string_view{} : list.substr(comma + 1);
+
+        if (field == "position") {
+            parsed.position = true;
+        }
+        else if (field == "velocity") {
+            parsed.velocity = true;
+        }
+        else if (field == "force") {
+            parsed.force = true;
+        }
+        else if (field == "potential") {
+            parsed.potential = true;
+        }
+        else if (field == "id") {
+            parsed.id = true;
+        }
+        else {
+            std::cerr << "Error: Unknown snapshot field: " << field << "\n";
+            return false;
+        }
+    }
+
+    if (field_mask(parsed) == 0) {
+        std::cerr << "Error: No snapshot fields selected\n";
+        return false;
+    }
+    options = parsed;
+    return true;
+}
+
+bool write_column_snapshot(std::string_view filename, std::span<const Particle2D> particles,
+                           std::string_view message, Real time, const ColumnSnapshotOptions& options) {
+    return write_columns(filename, particles, message, time, options);
+}
+
+bool write_column_snapshot(std::string_view filename, std::span<const Particle3D> particles,
+                           std::string_view message, Real time, const ColumnSnapshotOptions& options) {
+    return write_columns(filename, particles, message, time, options);
+}
+
+bool is_column_snapshot(std::string_view filename) {
+    std::ifstream infile(std::string(filename), std::ios::binary);
+    char magic[4] = {};
+    return infile.read(magic, sizeof(magic)) &&
+           std::equal(std::begin(SNAPSHOT_MAGIC), std::end(SNAPSHOT_MAGIC), magic);
+}
+
+std::optional<ColumnSnapshot> ColumnSnapshot::open(std::string_view filename) {
+    auto mapping = MappedFile::open(filename);
+    if (!mapping) {
+        return std::nullopt;
+    }
+
+    ColumnSnapshotHeader header{};
+    if (mapping->size() < sizeof(header)) {
+        std::cerr << "Error: Truncated snapshot: " << filename << "\n";
+        return std::nullopt;
+    }
+    std::memcpy(&header, mapping->data(), sizeof(header));
+
+    if (!std::equal(std::begin(SNAPSHOT_MAGIC), std::end(SNAPSHOT_MAGIC), header.magic) ||
+        header.version != FORMAT_VERSION) {
+        std::cerr << "Error: Not a columnar snapshot (or unsupported version): " << filename << "\n";
+        return std::nullopt;
+    }
+    if ((header.dimension != 2 && header.dimension != 3) || header.chunk_size == 0 ||
+        header.field_mask == 0 || (header.field_mask & ~FIELD_ALL) != 0) {
+        std::cerr << "Error: Invalid snapshot header: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    ColumnSnapshot snapshot;
+    snapshot.dimension_ = static_cast<int>(header.dimension);
+    snapshot.particle_count_ = header.particle_count;
+    snapshot.chunk_size_ = header.chunk_size;
+    snapshot.chunk_count_ = (header.particle_count + header.chunk_size - 1) / header.chunk_size;
+    snapshot.time_ = header.time;
+    snapshot.tolerance_ = header.tolerance;
+
+    for (auto& spec : column_specs(header.field_mask, snapshot.dimension_)) {
+        snapshot.columns_.push_back(std::move(spec.name));
+    }
+
+    const std::size_t blocks = snapshot.chunk_count_ * snapshot.columns_.size();
+    const std::size_t size = mapping->size();
+    if (header.message_size > size - sizeof(header) ||
+        header.index_offset > size ||
+        (size - header.index_offset) / sizeof(IndexEntry) < blocks) {
+        std::cerr << "Error: Truncated snapshot: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    const auto* bytes = reinterpret_cast<const char*>(mapping->data());
+    snapshot.message_.assign(bytes + sizeof(header), header.message_size);
+
+    snapshot.index_.resize(blocks);
+    std::memcpy(snapshot.index_.data(), mapping->data() + header.index_offset, blocks * sizeof(IndexEntry));
+    for (const auto& block : snapshot.index_) {
+        if (block.offset > header.index_offset || block.size > header.index_offset - block.offset) {
+            std::cerr << "Error: Corrupt snapshot index: " << filename << "\n";
+            return std::nullopt;
+        }
+    }
+
+    snapshot.mapping_ = std::move(*mapping);
+    return snapshot;
+}
+
+std::optional<int> ColumnSnapshot::find_column(std::string_view name) const {
+    const auto it = std::find(columns_.begin(), columns_.end(), name);
+    if (it == columns_.end()) {
+        return std::nullopt;
+    }
+    return static_cast<int>(it - columns_.begin());
+}
+
+std::optional<std::vector<Real>> ColumnSnapshot::read_chunk(int column, Index chunk) const {
+    if (column < 0 || static_cast<std::size_t>(column) >= columns_.size() || chunk >= chunk_count_) {
+        std::cerr << "Error: Snapshot column or chunk out of range\n";
+        return std::nullopt;
+    }
+
+    const Index begin = chunk * chunk_size_;
+    std::vector<Real> values(std::min(chunk_size_, particle_count_ - begin));
+
+    const Block& block = index_[chunk * columns_.size() + column];
+    const std::span<const std::uint8_t> data(
+        reinterpret_cast<const std::uint8_t*>(mapping_.data()) + block.offset, block.size);
+    if (!decode_block(data, values)) {
+        std::cerr << "Error: Corrupt snapshot block (column " << columns_[column] << ", chunk " << chunk << ")\n";
+        return std::nullopt;
+    }
+    return values;
+}
+
+std::optional<std::vector<Real>> ColumnSnapshot::read_column(int column) const {
+    std::vector<Real> values;
+    values.reserve(particle_count_);
+    for (Index chunk = 0; chunk < chunk_count_; ++chunk) {
+        auto part = read_chunk(column, chunk);
+        if (!part) {
+            return std::nullopt;
+        }
+        values.insert(values.end(), part->begin(), part->end());
+    }
+    return values;
+}
+
+} // namespace barnes_hut
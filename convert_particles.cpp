@@ -0,0 +1,262 @@
+/**
+ * Particle File Converter for Barnes-Hut Simulation
+ * Converts text particle files to the memory-mappable binary format,
+ * or to raw records for gnuplot's binary input, and decodes columnar
+ * snapshots and the frames of position streams to text
+ */
+
+#include "file.h"
+#include "binary_file.h"
+#include "column_snapshot.h"
+#include "snapshot_stream.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+
+using namespace barnes_hut;
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " <input> <output> [--dim <2|3>] [--gnuplot | --gnuplot-float]\n"
+              << "       " << program_name << " <snapshot.bhs> <output>\n"
+              << "       " << program_name << " <stream.bhss> <output> [--frame <n|last|all>]\n"
+              << "  input: Text particle file (as written by generate_data)\n"
+              << "  output: Binary particle file\n"
+              << "  --dim: Coordinates per particle in the input [default: 3]\n"
+              << "  --gnuplot: Write float64 gnuplot records and <output>.gp instead\n"
+              << "  --gnuplot-float: The same with float32 records\n"
+              << "  A columnar snapshot is written as text, one column per field component\n"
+              << "  --frame: Position stream frames to write as text [default: all]\n"
+              << "           (one block per frame, separated by two blank lines)\n"
+              << "\nExample:\n"
+              << "  " << program_name << " test.dat test.bhp\n"
+              << "  " << program_name << " test.dat test.bin --gnuplot-float\n"
+              << "  " << program_name << " snapshot_BH1K_theta0.50_pLeaf8_1.bhs snapshot.txt\n"
+              << "  " << program_name << " run.bhss last.dat --frame last\n";
+}
+
+enum class OutputFormat {
+    Binary,
+    Gnuplot,
+    GnuplotFloat
+};
+
+template <int Dim>
+int convert(const std::string& input, const std::string& output, OutputFormat format) {
+    auto config = read_config_file(input);
+    if (!config) {
+        std::cerr << "Error: Failed to read configuration from " << input << "\n";
+        return 2;
+    }
+
+    Timer timer;
+    auto particles = read_particle_file<Dim>(input, *config);
+    if (!particles) {
+        std::cerr << "Error: Failed to read particle data from " << input << "\n";
+        return 3;
+    }
+    const double read_time = timer.elapsed();
+
+    timer.reset();
+    const std::span<const BasicParticle<Dim>> view(*particles);
+    const bool written = (format == OutputFormat::Binary)
+        ? write_binary_particle_file(output, *config, view)
+        : write_gnuplot_binary(output, view, format == OutputFormat::GnuplotFloat);
+    if (!written) {
+        return 4;
+    }
+
+    std::cout << "Converted " << particles->size() << " " << Dim << "D particles\n"
+              << "  Read: " << read_time << "s\n"
+              << "  Write: " << timer.elapsed() << "s\n";
+    return 0;
+}
+
+// All columns of a columnar snapshot, as text
+int decode_snapshot(const std::string& input, const std::string& output) {
+    const auto snapshot = ColumnSnapshot::open(input);
+    if (!snapshot) {
+        return 2;
+    }
+
+    Timer timer;
+    const auto& names = snapshot->columns();
+    std::vector<std::vector<Real>> columns;
+    for (std::size_t column = 0; column < names.size(); ++column) {
+        auto values = snapshot->read_column(static_cast<int>(column));
+        if (!values) {
+            return 3;
+        }
+        columns.push_back(std::move(*values));
+    }
+    const double decode_time = timer.elapsed();
+
+    timer.reset();
+    std::ofstream outfile(output);
+    if (!outfile) {
+        std::cerr << "Error: Could not create file: " << output << "\n";
+        return 4;
+    }
+    outfile << std::setprecision(std::numeric_limits<Real>::max_digits10);
+    outfile << "# " << snapshot->message() << "\n"
+            << "# time " << snapshot->time() << " tolerance " << snapshot->tolerance() << "\n"
+            << "#";
+    for (const auto& name : names) {
+        outfile << " " << name;
+    }
+    outfile << "\n";
+    for (Index i = 0; i < snapshot->particle_count(); ++i) {
+        for (std::size_t column = 0; column < columns.size(); ++column) {
+            outfile << columns[column][i] << ((column + 1 < columns.size()) ? ' ' : '\n');
+        }
+    }
+    if (!outfile) {
+        std::cerr << "Error: Failed to write " << output << "\n";
+        return 4;
+    }
+
+    std::cout << "Decoded " << snapshot->particle_count() << " particles, " << names.size() << " columns\n"
+              << "  Decode: " << decode_time << "s\n"
+              << "  Write: " << timer.elapsed() << "s\n";
+    return 0;
+}
+
+template <int Dim>
+int extract_frames(const SnapshotStream& stream, const std::string& output, Index first, Index last) {
+    std::ofstream outfile(output);
+    if (!outfile) {
+        std::cerr << "Error: Could not create file: " << output << "\n";
+        return 4;
+    }
+    // Positions are multiples of the quantum: print the decimals it has
+    const int decimals = static_cast<int>(std::ceil(-std::log10(stream.options().quantum)));
+    outfile << std::fixed << std::setprecision(std::clamp(decimals, 0, std::numeric_limits<Real>::max_digits10));
+
+    Timer timer;
+    for (Index frame = first; frame <= last; ++frame) {
+        const auto positions = stream.read_positions<Dim>(frame);
+        if (!positions) {
+            return 3;
+        }
+        if (frame > first) {
+            outfile << "\n\n";
+        }
+        outfile << "# frame " << frame << " time " << stream.frame_time(frame) << "\n";
+        for (const auto& position : *positions) {
+            for (int dim = 0; dim < Dim; ++dim) {
+                outfile << position[dim] << ((dim + 1 < Dim) ? ' ' : '\n');
+            }
+        }
+    }
+    if (!outfile) {
+        std::cerr << "Error: Failed to write " << output << "\n";
+        return 4;
+    }
+
+    std::cout << "Extracted " << (last - first + 1) << " of " << stream.frame_count() << " frames of "
+              << stream.particle_count() << " " << Dim << "D positions\n"
+              << "  Decode and write: " << timer.elapsed() << "s\n";
+    return 0;
+}
+
+// Positions of the selected frames of a stream, as text
+int extract_stream(const std::string& input, const std::string& output, const std::string& frame) {
+    const auto stream = SnapshotStream::open(input);
+    if (!stream) {
+        return 2;
+    }
+    if (stream->frame_count() == 0) {
+        std::cerr << "Error: No complete frame in " << input << "\n";
+        return 3;
+    }
+
+    const Index last_frame = stream->frame_count() - 1;
+    Index first = 0;
+    Index last = last_frame;
+    if (frame == "last") {
+        first = last_frame;
+    }
+    else if (frame != "all") {
+        Index number = 0;
+        const auto [next, error] = std::from_chars(frame.data(), frame.data() + frame.size(), number);
+        if (error != std::errc() || next != frame.data() + frame.size() || number > last_frame) {
+            std::cerr << "Error: Frame must be 'all', 'last' or 0.." << last_frame << "\n";
+            return 1;
+        }
+        first = last = number;
+    }
+
+    return (stream->dimension() == 2) ? extract_frames<2>(*stream, output, first, last)
+                                      : extract_frames<3>(*stream, output, first, last);
+}
+
+int main(int argc, char* argv[]) {
+    std::cout << "=== Barnes-Hut Particle File Converter ===\n\n";
+
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const std::string input = argv[1];
+    const std::string output = argv[2];
+    int dimension = NDIM;
+    OutputFormat format = OutputFormat::Binary;
+    std::optional<std::string> frame;
+
+    for (int i = 3; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--dim" && i + 1 < argc) {
+            dimension = std::stoi(argv[++i]);
+        }
+        else if (arg == "--gnuplot") {
+            format = OutputFormat::Gnuplot;
+        }
+        else if (arg == "--gnuplot-float") {
+            format = OutputFormat::GnuplotFloat;
+        }
+        else if (arg == "--frame" && i + 1 < argc) {
+            frame = argv[++i];
+        }
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (is_column_snapshot(input)) {
+        if (format != OutputFormat::Binary || frame) {
+            std::cerr << "Error: Columnar snapshots convert to text only\n";
+            return 1;
+        }
+        return decode_snapshot(input, output);
+    }
+    if (is_snapshot_stream(input)) {
+        if (format != OutputFormat::Binary) {
+            std::cerr << "Error: Position streams convert to text only\n";
+            return 1;
+        }
+        return extract_stream(input, output, frame.value_or("all"));
+    }
+    if (frame) {
+        std::cerr << "Error: --frame applies to position streams only\n";
+        return 1;
+    }
+
+    if (dimension != 2 && dimension != 3) {
+        std::cerr << "Error: Dimension must be 2 or 3\n";
+        return 1;
+    }
+
+    if (format == OutputFormat::Binary && is_binary_particle_file(input)) {
+        std::cerr << "Error: Input is already a binary particle file\n";
+        return 1;
+    }
+
+    return (dimension == 2) ? convert<2>(input, output, format) : convert<3>(input, output, format);
+}
@@ -0,0 +1,373 @@
+#include "direct_sum.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+template <int Dim, typename Softening>
+BasicDirectSummation<Dim, Softening>::BasicDirectSummation(std::span<Particle> particles, Real timestep)
+    : particles_(particles)
+    , dt_(timestep)
+    , softening_length_(Softening::default_length)
+    , compute_potential_(false)
+    , deterministic_(false) {
+
+    // Initialize particle IDs
+    for (Index i = 0; i < particles_.size(); ++i) {
+        particles_[i].set_id(i);
+    }
+}
+
+template <int Dim, typename Softening>
+void BasicDirectSummation<Dim, Softening>::simulation_step() {
+    Timer total_timer;
+    stats_ = Statistics{};
+
+    calculate_forces();
+    integrate_particles();
+
+    stats_.time_total = total_timer.elapsed();
+}
+
+template <int Dim, typename Softening>
+void BasicDirectSummation<Dim, Softening>::pack_particles() {
+    const Index n = particles_.size();
+    for (auto& component : position_) {
+        component.resize(n);
+    }
+    mass_.resize(n);
+    if constexpr (Softening::per_particle) {
+        softening_.resize(n);
+    }
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (Index i = 0; i < n; ++i) {
+        const auto& pos = particles_[i].position();
+        for (int k = 0; k < Dim; ++k) {
+            position_[k][i] = pos[k];
+        }
+        mass_[i] = particles_[i].mass();
+        if constexpr (Softening::per_particle) {
+            softening_[i] = std::max(softening_length_, particles_[i].softening());
+        }
+    }
+}
+
+template <int Dim, typename Softening>
+void BasicDirectSummation<Dim, Softening>::calculate_forces() {
+    const Index n = particles_.size();
+
+    Timer load_timer;
+    pack_particles();
+    stats_.time_load = load_timer.elapsed();
+
+    Timer force_timer;
+
+    const Index tiles = (n + TILE_SIZE - 1) / TILE_SIZE;
+    if (deterministic_) {
+        accumulate_rounds(tiles);
+    }
+    else {
+        accumulate_thread_buffers(tiles);
+    }
+
+    stats_.time_force = force_timer.elapsed();
+    stats_.direct_force_count = n * (n > 0 ? n - 1 : 0);
+}
+
+template <int Dim, typename Softening>
+void BasicDirectSummation<Dim, Softening>::accumulate_tile_pair(Index tile_i, Index tile_j,
+                                                                const std::array<Real*, Dim>& acceleration,
+                                                                Real* phi) const noexcept {
+    if (compute_potential_) {
+        accumulate_tile_pair<true>(tile_i, tile_j, acceleration, phi);
+    }
+    else {
+        accumulate_tile_pair<false>(tile_i, tile_j, acceleration, phi);
+    }
+}
+
+template <int Dim, typename Softening>
+void BasicDirectSummation<Dim, Softening>::accumulate_thread_buffers(Index tiles) {
+    const Index n = particles_.size();
+
+    // Upper triangle of tile pairs, diagonal tiles included
+    std::vector<std::pair<Index, Index>> tile_pairs;
+    tile_pairs.reserve(tiles * (tiles + 1) / 2);
+    for (Index i = 0; i < tiles; ++i) {
+        for (Index j = i; j < tiles; ++j) {
+            tile_pairs.emplace_back(i, j);
+        }
+    }
+
+    int thread_count = 1;
+    #ifdef _OPENMP
+    thread_count = omp_get_max_threads();
+    #endif
+
+    const std::size_t buffer_size = static_cast<std::size_t>(thread_count) * n;
+    for (auto& component : acceleration_) {
+        component.resize(buffer_size);
+    }
+    potential_.resize(buffer_size);
+
+    std::vector<double> busy(thread_count, 0.0);
+    int team = 1;
+
+    #ifdef _OPENMP
+    #pragma omp parallel num_threads(thread_count)
+    #endif
+    {
+        int thread = 0;
+        #ifdef _OPENMP
+        thread = omp_get_thread_num();
+        #pragma omp single nowait
+        team = omp_get_num_threads();
+        #endif
+
+        Timer busy_timer;
+        std::array<Real*, Dim> acceleration{};
+        for (int k = 0; k < Dim; ++k) {
+            acceleration[k] = acceleration_[k].data() + thread * n;
+            std::fill(acceleration[k], acceleration[k] + n, 0.0);
+        }
+        Real* phi = potential_.data() + thread * n;
+        std::fill(phi, phi + n, 0.0);
+
+        #ifdef _OPENMP
+        #pragma omp for schedule(dynamic) nowait
+        #endif
+        for (Index p = 0; p < tile_pairs.size(); ++p) {
+            const auto [tile_i, tile_j] = tile_pairs[p];
+            accumulate_tile_pair(tile_i, tile_j, acceleration, phi);
+        }
+        busy[thread] = busy_timer.elapsed();
+    }
+
+    // The runtime may give a smaller team than requested; slices past it
+    // were not zeroed this step
+    stats_.force_imbalance = load_imbalance(std::span<const double>(busy.data(), team));
+    reduce_thread_buffers(team);
+}
+
+template <int Dim, typename Softening>
+void BasicDirectSummation<Dim, Softening>::accumulate_rounds(Index tiles) {
+    const Index n = particles_.size();
+
+    std::array<Real*, Dim> acceleration{};
+    for (int k = 0; k < Dim; ++k) {
+        acceleration_[k].assign(n, 0.0);
+        acceleration[k] = acceleration_[k].data();
+    }
+    potential_.assign(n, 0.0);
+    Real* phi = potential_.data();
+
+    // Circle method over an even number of slots (the last one is a bye for
+    // an odd tile count): in round r slot slots - 1 meets r and slot r + k
+    // meets r - k (mod slots - 1), so every tile is in exactly one pair per
+    // round and every pair of tiles meets once. The diagonal tiles go first.
+    const Index slots = tiles + tiles % 2;
+
+    // Busy time excludes the waits at the end of each round
+    int thread_count = 1;
+    #ifdef _OPENMP
+    thread_count = omp_get_max_threads();
+    #endif
+    std::vector<double> busy(thread_count, 0.0);
+    int team = 1;
+
+    #ifdef _OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        int thread = 0;
+        #ifdef _OPENMP
+        thread = omp_get_thread_num();
+        #pragma omp single nowait
+        team = omp_get_num_threads();
+        #endif
+
+        double busy_seconds = 0.0;
+        Timer busy_timer;
+
+        #ifdef _OPENMP
+        #pragma omp for schedule(dynamic) nowait
+        #endif
+        for (Index tile = 0; tile < tiles; ++tile) {
+            accumulate_tile_pair(tile, tile, acceleration, phi);
+        }
+        busy_seconds += busy_timer.elapsed();
+        #ifdef _OPENMP
+        #pragma omp barrier
+        #endif
+
+        for (Index round = 0; round + 1 < slots; ++round) {
+            Timer round_timer;
+            #ifdef _OPENMP
+            #pragma omp for schedule(dynamic) nowait
+            #endif
+            for (Index k = 0; k < slots / 2; ++k) {
+                const Index a = (k == 0) ? slots - 1 : (round + k) % (slots - 1);
+                const Index b = (k == 0) ? round : (round + slots - 1 - k) % (slots - 1);
+                if (a < tiles && b < tiles) {
+                    accumulate_tile_pair(std::min(a, b), std::max(a, b), acceleration, phi);
+                }
+            }
+            busy_seconds += round_timer.elapsed();
+            #ifdef _OPENMP
+            #pragma omp barrier
+            #endif
+        }
+        busy[thread] = busy_seconds;
+    }
+
+    stats_.force_imbalance = load_imbalance(std::span<const double>(busy.data(), team));
+    reduce_thread_buffers(1);
+}
+
+template <int Dim, typename Softening>
+template <bool WithPotential>
+void BasicDirectSummation<Dim, Softening>::accumulate_tile_pair(Index tile_i, Index tile_j,
+                                                                const std::array<Real*, Dim>& acceleration,
+                                                                Real* phi) const noexcept {
+    const Index n = particles_.size();
+    const Index i_begin = tile_i * TILE_SIZE;
+    const Index i_end = std::min(i_begin + TILE_SIZE, n);
+    const Index j_tile_begin = tile_j * TILE_SIZE;
+    const Index j_end = std::min(j_tile_begin + TILE_SIZE, n);
+
+    std::array<const Real*, Dim> x{};
+    for (int k = 0; k < Dim; ++k) {
+        x[k] = position_[k].data();
+    }
+    const Real* m = mass_.data();
+    const Real* hs = softening_.data();
+
+    for (Index i = i_begin; i < i_end; ++i) {
+        std::array<Real, Dim> xi{};
+        for (int k = 0; k < Dim; ++k) {
+            xi[k] = x[k][i];
+        }
+        const Real mi = m[i];
+        Real hi = softening_length_;
+        if constexpr (Softening::per_particle) {
+            hi = hs[i];
+        }
+
+        // Per-component sums are kept in scalars so the inner loop reduces cleanly
+        Real axi = 0.0, ayi = 0.0, azi = 0.0, phii = 0.0;
+
+        // Within a diagonal tile only pairs with j > i are visited
+        const Index j_begin = (tile_i == tile_j) ? i + 1 : j_tile_begin;
+
+        #ifdef _OPENMP
+        #pragma omp simd reduction(+ : axi, ayi, azi, phii)
+        #endif
+        for (Index j = j_begin; j < j_end; ++j) {
+            const Real dx = xi[0] - x[0][j];
+            const Real dy = xi[1] - x[1][j];
+            Real r_squared = dx * dx + dy * dy;
+            Real dz = 0.0;
+            if constexpr (Dim == 3) {
+                dz = xi[2] - x[2][j];
+                r_squared += dz * dz;
+            }
+
+            Real h = hi;
+            if constexpr (Softening::per_particle) {
+                h = std::max(hi, hs[j]);
+            }
+
+            // Force law from the softening policy
+            Real force_factor = 0.0;
+            Real potential_factor = 0.0;
+            if constexpr (WithPotential) {
+                Softening::evaluate(r_squared, h, force_factor, potential_factor);
+            }
+            else {
+                force_factor = Softening::force(r_squared, h);
+            }
+
+            // Equal and opposite accelerations (per unit G)
+            const Real si = m[j] * force_factor;
+            const Real sj = mi * force_factor;
+            axi -= si * dx;
+            ayi -= si * dy;
+            acceleration[0][j] += sj * dx;
+            acceleration[1][j] += sj * dy;
+            if constexpr (Dim == 3) {
+                azi -= si * dz;
+                acceleration[2][j] += sj * dz;
+            }
+
+            if constexpr (WithPotential) {
+                phii -= m[j] * potential_factor;
+                phi[j] -= mi * potential_factor;
+            }
+        }
+
+        acceleration[0][i] += axi;
+        acceleration[1][i] += ayi;
+        if constexpr (Dim == 3) {
+            acceleration[2][i] += azi;
+        }
+        if constexpr (WithPotential) {
+            phi[i] += phii;
+        }
+    }
+}
+
+template <int Dim, typename Softening>
+void BasicDirectSummation<Dim, Softening>::reduce_thread_buffers(int thread_count) {
+    const Index n = particles_.size();
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (Index i = 0; i < n; ++i) {
+        Vector acceleration{0.0};
+        Real phi = 0.0;
+        for (int t = 0; t < thread_count; ++t) {
+            const std::size_t k = static_cast<std::size_t>(t) * n + i;
+            for (int d = 0; d < Dim; ++d) {
+                acceleration[d] += acceleration_[d][k];
+            }
+            phi += potential_[k];
+        }
+
+        auto& particle = particles_[i];
+        particle.force() = (GRAVITY * particle.mass()) * acceleration;
+        particle.potential() = compute_potential_ ? GRAVITY * phi : 0.0;
+    }
+}
+
+template <int Dim, typename Softening>
+void BasicDirectSummation<Dim, Softening>::integrate_particles() {
+    if (compute_potential_) {
+        integrate_with_diagnostics(particles_, dt_, stats_, [](Particle&) {});
+        return;
+    }
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (Index i = 0; i < particles_.size(); ++i) {
+        particles_[i].integrate(dt_);
+    }
+}
+
+template <int Dim, typename Softening>
+std::string BasicDirectSummation<Dim, Softening>::get_statistics_string() const {
+    return format_statistics(stats_, compute_potential_);
+}
+
+DIRECT_SUMMATION_INSTANTIATIONS(template)
+
+} // namespace barnes_hut
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "particle.h"
+#include "softening.h"
+#include "solver.h"
+#include <array>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace barnes_hut {
+
+// Exact O(N^2) force backend.
+//
+// Positions and masses are packed into structure-of-arrays buffers once per
+// step, and the pair loop walks them in cache-sized tiles so the inner loop
+// vectorises. Each pair is evaluated once and applied to both particles
+// (Newton's third law); every thread accumulates into its own acceleration
+// buffers, which are summed in a fixed order at the end of the step.
+//
+// Which tile pairs land in which buffer depends on the schedule, so the
+// rounding of the sums does too. In deterministic mode the tile pairs are
+// instead processed in rounds of disjoint pairs (a round-robin tournament
+// between tiles): the pairs of a round run in parallel on one shared buffer
+// without conflicts, and every particle receives its contributions in round
+// order, so the forces are the same bits for any thread count.
+template <int Dim, typename Softening = PlummerSoftening>
+class BasicDirectSummation {
+public:
+    using Vector = BasicVector<Dim>;
+    using Particle = BasicParticle<Dim>;
+    using Statistics = SolverStatistics;
+
+    static_assert(SofteningPolicy<Softening>);
+
+    static constexpr int dimension = Dim;
+
+    // Particles per tile: two tiles of positions and masses stay in L1
+    static constexpr Index TILE_SIZE = 256;
+
+    BasicDirectSummation(std::span<Particle> particles, Real timestep);
+
+    // Rule of 5 - delete copy, default move
+    ~BasicDirectSummation() = default;
+    BasicDirectSummation(const BasicDirectSummation&) = delete;
+    BasicDirectSummation& operator=(const BasicDirectSummation&) = delete;
+    BasicDirectSummation(BasicDirectSummation&&) noexcept = default;
+    BasicDirectSummation& operator=(BasicDirectSummation&&) noexcept = default;
+
+    // Main simulation step
+    void simulation_step();
+
+    // Forces (and potentials, if enabled) at the current positions, without integrating
+    void calculate_forces();
+
+    // Accumulate per-particle potentials and reduce the conserved quantities
+    // into Statistics while integrating
+    void set_compute_potential(bool enabled) noexcept { compute_potential_ = enabled; }
+    [[nodiscard]] bool computes_potential() const noexcept { return compute_potential_; }
+
+    // Forces independent of the thread count (see above); a barrier per round
+    void set_deterministic(bool enabled) noexcept { deterministic_ = enabled; }
+    [[nodiscard]] bool is_deterministic() const noexcept { return deterministic_; }
+
+    // Global softening length h (see BasicBarnesHutTree::set_softening_length)
+    void set_softening_length(Real length) noexcept { softening_length_ = length; }
+    [[nodiscard]] Real softening_length() const noexcept { return softening_length_; }
+
+    [[nodiscard]] const Statistics& get_statistics() const noexcept { return stats_; }
+    [[nodiscard]] std::string get_statistics_string() const;
+
+    // There is no tree to clear; present so both backends share one driver loop
+    void clear_tree() noexcept {}
+
+private:
+    void pack_particles();
+    template <bool WithPotential>
+    void accumulate_tile_pair(Index tile_i, Index tile_j,
+                              const std::array<Real*, Dim>& acceleration, Real* phi) const noexcept;
+    void accumulate_tile_pair(Index tile_i, Index tile_j, const std::array<Real*, Dim>& acceleration, Real* phi) const noexcept;
+    void accumulate_thread_buffers(Index tiles);
+    void accumulate_rounds(Index tiles);
+    void reduce_thread_buffers(int thread_count);
+    void integrate_particles();
+
+    std::span<Particle> particles_;
+    Real dt_;
+    Real softening_length_;
+
+    // Structure-of-arrays copies of the particle data
+    std::array<std::vector<Real>, Dim> position_;
+    std::vector<Real> mass_;
+    std::vector<Real> softening_;  // Per-particle policies only
+
+    // Per-thread accelerations and potentials, thread t at offset t * particles_.size()
+    std::array<std::vector<Real>, Dim> acceleration_;
+    std::vector<Real> potential_;
+
+    Statistics stats_;
+    bool compute_potential_;
+    bool deterministic_;
+};
+
+#define DIRECT_SUMMATION_INSTANTIATIONS(PREFIX)                                   \
+    PREFIX class BasicDirectSummation<2, PlummerSoftening>;                      \
+    PREFIX class BasicDirectSummation<2, SplineSoftening>;                       \
+    PREFIX class BasicDirectSummation<2, NoSoftening>;                           \
+    PREFIX class BasicDirectSummation<2, PerParticleSoftening<PlummerSoftening>>; \
+    PREFIX class BasicDirectSummation<2, PerParticleSoftening<SplineSoftening>>; \
+    PREFIX class BasicDirectSummation<3, PlummerSoftening>;                      \
+    PREFIX class BasicDirectSummation<3, SplineSoftening>;                       \
+    PREFIX class BasicDirectSummation<3, NoSoftening>;                           \
+    PREFIX class BasicDirectSummation<3, PerParticleSoftening<PlummerSoftening>>; \
+    PREFIX class BasicDirectSummation<3, PerParticleSoftening<SplineSoftening>>;
+
+DIRECT_SUMMATION_INSTANTIATIONS(extern template)
+
+using DirectSummation2D = BasicDirectSummation<2>;
+using DirectSummation3D = BasicDirectSummation<3>;
+using DirectSummation = BasicDirectSummation<NDIM>;
+
+} // namespace barnes_hut
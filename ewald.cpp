@@ -0,0 +1,200 @@
+#include "ewald.h"
+#include <fstream>
+#include <numbers>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+namespace {
+
+constexpr char EWALD_MAGIC[4] = {'B', 'H', 'E', 'W'};
+
+// Splitting parameter and summation ranges for a unit box
+constexpr Real EWALD_ALPHA = 2.0;
+constexpr int EWALD_NMAX = 4;
+
+struct EwaldFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t grid;
+    std::uint32_t reserved;
+};
+
+} // namespace
+
+Vector3D EwaldTable::exact_correction(const Vector3D& x) {
+    const Real r_squared = x.squared_magnitude();
+    if (r_squared == 0.0) {
+        return Vector3D{0.0};
+    }
+
+    constexpr Real pi = std::numbers::pi;
+    const Real alpha = EWALD_ALPHA;
+
+    // Remove the Newtonian term of the nearest image
+    Vector3D correction = x / (r_squared * std::sqrt(r_squared));
+
+    // Real-space sum over image boxes
+    for (int nx = -EWALD_NMAX; nx <= EWALD_NMAX; ++nx) {
+        for (int ny = -EWALD_NMAX; ny <= EWALD_NMAX; ++ny) {
+            for (int nz = -EWALD_NMAX; nz <= EWALD_NMAX; ++nz) {
+                const Vector3D dx = x - Vector3D{Real(nx), Real(ny), Real(nz)};
+                const Real r = dx.magnitude();
+                const Real val = std::erfc(alpha * r) +
+                                 2.0 * alpha * r / std::sqrt(pi) * std::exp(-alpha * alpha * r * r);
+                correction -= dx * (val / (r * r * r));
+            }
+        }
+    }
+
+    // Fourier-space sum
+    for (int hx = -EWALD_NMAX; hx <= EWALD_NMAX; ++hx) {
+        for (int hy = -EWALD_NMAX; hy <= EWALD_NMAX; ++hy) {
+            for (int hz = -EWALD_NMAX; hz <= EWALD_NMAX; ++hz) {
+                const Vector3D h{Real(hx), Real(hy), Real(hz)};
+                const Real h_squared = h.squared_magnitude();
+                if (h_squared == 0.0) {
+                    continue;
+                }
+
+                const Real val = 2.0 / h_squared * std::exp(-pi * pi * h_squared / (alpha * alpha)) *
+                                 std::sin(2.0 * pi * h.dot(x));
+                correction -= h * val;
+            }
+        }
+    }
+
+    return correction;
+}
+
+Real EwaldTable::exact_potential_correction(const Vector3D& x) {
+    constexpr Real pi = std::numbers::pi;
+    const Real alpha = EWALD_ALPHA;
+    const Real r = x.magnitude();
+
+    // 1/r minus the periodic Ewald potential; at r = 0 the 1/r singularity
+    // cancels against the n = 0 real-space term, leaving -2 alpha / sqrt(pi)
+    Real correction = (r > 0.0) ? 1.0 / r : 2.0 * alpha / std::sqrt(pi);
+    correction += pi / (alpha * alpha);
+
+    for (int nx = -EWALD_NMAX; nx <= EWALD_NMAX; ++nx) {
+        for (int ny = -EWALD_NMAX; ny <= EWALD_NMAX; ++ny) {
+            for (int nz = -EWALD_NMAX; nz <= EWALD_NMAX; ++nz) {
+                const Real d = (x - Vector3D{Real(nx), Real(ny), Real(nz)}).magnitude();
+                if (d > 0.0) {
+                    correction -= std::erfc(alpha * d) / d;
+                }
+            }
+        }
+    }
+
+    for (int hx = -EWALD_NMAX; hx <= EWALD_NMAX; ++hx) {
+        for (int hy = -EWALD_NMAX; hy <= EWALD_NMAX; ++hy) {
+            for (int hz = -EWALD_NMAX; hz <= EWALD_NMAX; ++hz) {
+                const Vector3D h{Real(hx), Real(hy), Real(hz)};
+                const Real h_squared = h.squared_magnitude();
+                if (h_squared == 0.0) {
+                    continue;
+                }
+
+                correction -= std::exp(-pi * pi * h_squared / (alpha * alpha)) / (pi * h_squared) *
+                              std::cos(2.0 * pi * h.dot(x));
+            }
+        }
+    }
+
+    return correction;
+}
+
+void EwaldTable::compute() {
+    table_.assign(static_cast<std::size_t>(POINTS) * POINTS * POINTS, {0.0f, 0.0f, 0.0f, 0.0f});
+
+    const Real spacing = 0.5 / GRID;
+
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (int i = 0; i < POINTS; ++i) {
+        for (int j = 0; j < POINTS; ++j) {
+            for (int k = 0; k < POINTS; ++k) {
+                const Vector3D x{i * spacing, j * spacing, k * spacing};
+                const Vector3D correction = exact_correction(x);
+                table_[index(i, j, k)] = {static_cast<float>(correction[0]),
+                                          static_cast<float>(correction[1]),
+                                          static_cast<float>(correction[2]),
+                                          static_cast<float>(exact_potential_correction(x))};
+            }
+        }
+    }
+}
+
+bool EwaldTable::save(std::string_view filename) const {
+    std::ofstream outfile(std::string(filename), std::ios::binary);
+    if (!outfile) {
+        std::cerr << "Error: Could not create Ewald cache file: " << filename << "\n";
+        return false;
+    }
+
+    EwaldFileHeader header{};
+    std::copy(std::begin(EWALD_MAGIC), std::end(EWALD_MAGIC), header.magic);
+    header.version = FORMAT_VERSION;
+    header.grid = GRID;
+
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outfile.write(reinterpret_cast<const char*>(table_.data()),
+                  static_cast<std::streamsize>(table_.size() * sizeof(table_[0])));
+
+    if (!outfile) {
+        std::cerr << "Error: Failed to write Ewald cache file: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool EwaldTable::load(std::string_view filename) {
+    std::ifstream infile(std::string(filename), std::ios::binary);
+    if (!infile) {
+        return false;
+    }
+
+    EwaldFileHeader header{};
+    if (!infile.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !std::equal(std::begin(EWALD_MAGIC), std::end(EWALD_MAGIC), header.magic) ||
+        header.version != FORMAT_VERSION ||
+        header.grid != static_cast<std::uint32_t>(GRID)) {
+        std::cerr << "Warning: Ignoring incompatible Ewald cache file: " << filename << "\n";
+        return false;
+    }
+
+    std::vector<std::array<float, 4>> table(static_cast<std::size_t>(POINTS) * POINTS * POINTS);
+    if (!infile.read(reinterpret_cast<char*>(table.data()),
+                     static_cast<std::streamsize>(table.size() * sizeof(table[0])))) {
+        std::cerr << "Warning: Truncated Ewald cache file: " << filename << "\n";
+        return false;
+    }
+
+    table_ = std::move(table);
+    return true;
+}
+
+std::shared_ptr<const EwaldTable> EwaldTable::load_or_compute(std::string_view cache_file) {
+    auto table = std::make_shared<EwaldTable>();
+
+    if (!cache_file.empty() && table->load(cache_file)) {
+        std::cout << "Loaded Ewald table from: " << cache_file << "\n";
+        return table;
+    }
+
+    Timer timer;
+    table->compute();
+    std::cout << "Computed Ewald table (" << POINTS << "^3) in " << timer.elapsed() << "s\n";
+
+    if (!cache_file.empty() && table->save(cache_file)) {
+        std::cout << "Cached Ewald table to: " << cache_file << "\n";
+    }
+
+    return table;
+}
+
+} // namespace barnes_hut
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "vektor.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace barnes_hut {
+
+// Tabulated Ewald corrections for periodic gravity in a cubic box.
+//
+// The table holds, for a unit box with a unit source mass at the origin,
+// the difference between the fully periodic acceleration and potential
+// (Ewald sum with a neutralising background) and their Newtonian
+// minimum-image counterparts. The force correction is odd and the potential
+// correction even in every component, so only the positive octant
+// [0, 1/2]^3 is stored. Results scale as 1/L^2 (force) and 1/L (potential)
+// for a box of side L.
+class EwaldTable {
+public:
+    static constexpr int GRID = 32;                   // Cells per half-box edge
+    static constexpr int POINTS = GRID + 1;           // Samples per half-box edge
+    static constexpr std::uint32_t FORMAT_VERSION = 2;
+
+    EwaldTable() = default;
+
+    // Evaluate the Ewald sums at every grid point (parallel, a few seconds)
+    void compute();
+
+    // Binary cache file I/O
+    bool save(std::string_view filename) const;
+    [[nodiscard]] bool load(std::string_view filename);
+
+    // Load the table from cache_file, or compute it and write the cache
+    [[nodiscard]] static std::shared_ptr<const EwaldTable>
+    load_or_compute(std::string_view cache_file);
+
+    // Correction to add to the Newtonian acceleration -dx/|dx|^3 for unit G*m.
+    // dx is the minimum-image separation (target - source) in a box of side box_size.
+    [[nodiscard]] Vector3D force_correction(const Vector3D& dx, Real box_size) const noexcept {
+        return interpolate<false>(dx, box_size, nullptr);
+    }
+
+    // As force_correction, also adding the correction to the Newtonian
+    // potential -1/|dx| (per unit G*m) to potential
+    [[nodiscard]] Vector3D correction(const Vector3D& dx, Real box_size, Real& potential) const noexcept {
+        return interpolate<true>(dx, box_size, &potential);
+    }
+
+    // Potential per unit G*m of a particle's own periodic images
+    [[nodiscard]] Real self_potential(Real box_size) const noexcept {
+        return table_[0][3] / box_size;
+    }
+
+private:
+    template <bool WithPotential>
+    [[nodiscard]] Vector3D interpolate(const Vector3D& dx, Real box_size, Real* potential) const noexcept {
+        const Real inv_box = 1.0 / box_size;
+        const Real scale = 2.0 * GRID * inv_box;
+
+        std::array<std::size_t, 3> cell{};
+        std::array<Real, 3> frac{};
+        std::array<Real, 3> sign{};
+
+        for (int k = 0; k < 3; ++k) {
+            const Real u = std::min(std::abs(dx[k]) * scale, static_cast<Real>(GRID) - 1e-9);
+            sign[k] = std::copysign(1.0, dx[k]);
+            cell[k] = static_cast<std::size_t>(u);
+            frac[k] = u - static_cast<Real>(cell[k]);
+        }
+
+        // Trilinear interpolation between the 8 surrounding samples
+        const std::size_t base = index(cell[0], cell[1], cell[2]);
+        constexpr std::size_t di = static_cast<std::size_t>(POINTS) * POINTS;
+        constexpr std::size_t dj = POINTS;
+
+        const Real wx[2] = {1.0 - frac[0], frac[0]};
+        const Real wy[2] = {1.0 - frac[1], frac[1]};
+        const Real wz[2] = {1.0 - frac[2], frac[2]};
+
+        Real fx = 0.0, fy = 0.0, fz = 0.0, phi = 0.0;
+        for (int a = 0; a < 2; ++a) {
+            for (int b = 0; b < 2; ++b) {
+                const auto* entry = &table_[base + a * di + b * dj];
+                const Real wxy = wx[a] * wy[b];
+                fx += wxy * (wz[0] * entry[0][0] + wz[1] * entry[1][0]);
+                fy += wxy * (wz[0] * entry[0][1] + wz[1] * entry[1][1]);
+                fz += wxy * (wz[0] * entry[0][2] + wz[1] * entry[1][2]);
+                if constexpr (WithPotential) {
+                    phi += wxy * (wz[0] * entry[0][3] + wz[1] * entry[1][3]);
+                }
+            }
+        }
+
+        // The potential correction is even in every component
+        if constexpr (WithPotential) {
+            *potential += phi * inv_box;
+        }
+
+        const Real inv_box_squared = inv_box * inv_box;
+        return Vector3D{sign[0] * fx * inv_box_squared,
+                        sign[1] * fy * inv_box_squared,
+                        sign[2] * fz * inv_box_squared};
+    }
+
+    [[nodiscard]] static constexpr std::size_t index(std::size_t i, std::size_t j, std::size_t k) noexcept {
+        return (i * POINTS + j) * POINTS + k;
+    }
+
+    // Exact force and potential corrections for a unit box, by Ewald summation
+    [[nodiscard]] static Vector3D exact_correction(const Vector3D& x);
+    [[nodiscard]] static Real exact_potential_correction(const Vector3D& x);
+
+    std::vector<std::array<float, 4>> table_;  // fx, fy, fz, potential
+};
+
+} // namespace barnes_hut
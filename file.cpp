@@ -1,12 +1,27 @@
 #include "file.h"
+#include "initial_conditions.h"
+#include "binary_file.h"
 #include "stdinc.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace barnes_hut {
 
 std::optional<SimulationConfig> read_config_file(std::string_view filename) {
+    if (is_binary_particle_file(filename)) {
+        const auto file = BinaryParticleFile::open(filename);
+        return file ? std::optional{file->config()} : std::nullopt;
+    }
+
     std::ifstream infile(filename.data());
     if (!infile) {
         std::cerr << "Error: Could not open file: " << filename << "\n";
@@ -42,67 +57,298 @@ std::optional<SimulationConfig> read_config_file(std::string_view filename) {
     return config;
 }
 
-std::optional<std::vector<Particle>> read_particle_file(
+namespace {
+
+// Text particle files are parsed straight from a memory mapping: the body is
+// split into line-aligned chunks, the records in each chunk are counted, and
+// then every chunk is parsed on its own thread into its slice of a
+// preallocated particle array. One non-blank line holds one particle.
+
+// Smallest chunk worth a task of its own
+constexpr std::size_t MIN_PARSE_CHUNK = 1 << 16;
+
+constexpr bool is_blank(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Position just past the next newline (or end)
+const char* line_end(const char* p, const char* end) noexcept {
+    const char* newline = std::find(p, end, '\n');
+    return newline == end ? end : newline + 1;
+}
+
+// Parse one whitespace-terminated number, not crossing a newline
+template <typename T>
+bool parse_field(const char*& p, const char* end, T& value) noexcept {
+    while (p < end && is_blank(*p)) {
+        ++p;
+    }
+    if (p < end && *p == '+') {
+        ++p;  // from_chars rejects an explicit plus sign
+    }
+
+    const auto [next, error] = std::from_chars(p, end, value);
+    if (error != std::errc{} || (next < end && !is_blank(*next) && *next != '\n')) {
+        return false;
+    }
+    p = next;
+    return true;
+}
+
+// Header values may be separated by any whitespace, newlines included
+template <typename T>
+bool parse_header_token(const char*& p, const char* end, T& value) noexcept {
+    while (p < end && (is_blank(*p) || *p == '\n')) {
+        ++p;
+    }
+    return parse_field(p, end, value);
+}
+
+bool is_blank_line(const char* p, const char* end) noexcept {
+    return std::all_of(p, end, [](char c) { return is_blank(c) || c == '\n'; });
+}
+
+struct ParseError {
+    Index line = 0;
+    std::string message;
+};
+
+// Parse one particle record; an error message on failure
+template <int Dim>
+std::optional<std::string> parse_particle_line(const char* p, const char* end, Index index,
+                                               BasicParticle<Dim>& particle) {
+    Real mass;
+    BasicVector<Dim> pos, vel;
+
+    if (!parse_field(p, end, mass)) {
+        return "Failed to read mass for particle " + std::to_string(index);
+    }
+    if (mass <= 0.0) {
+        return "Invalid mass for particle " + std::to_string(index) + " (must be > 0)";
+    }
+    for (int dim = 0; dim < Dim; ++dim) {
+        if (!parse_field(p, end, pos[dim])) {
+            return "Failed to read position for particle " + std::to_string(index);
+        }
+    }
+    for (int dim = 0; dim < Dim; ++dim) {
+        if (!parse_field(p, end, vel[dim])) {
+            return "Failed to read velocity for particle " + std::to_string(index);
+        }
+    }
+    if (!is_blank_line(p, end)) {
+        return "Unexpected extra fields for particle " + std::to_string(index);
+    }
+
+    particle = BasicParticle<Dim>(mass, pos, vel);
+    return std::nullopt;
+}
+
+template <int Dim>
+std::optional<std::vector<BasicParticle<Dim>>> parse_particle_lines(const char* begin, const char* end,
+                                                                    Index count, Index first_line) {
+    int threads = 1;
+    #ifdef _OPENMP
+    threads = omp_get_max_threads();
+    #endif
+
+    // Line-aligned chunk boundaries
+    const std::size_t bytes = static_cast<std::size_t>(end - begin);
+    const std::size_t chunks = std::clamp<std::size_t>(bytes / MIN_PARSE_CHUNK, 1, 4 * threads);
+    std::vector<const char*> bounds(chunks + 1, end);
+    bounds[0] = begin;
+    for (std::size_t c = 1; c < chunks; ++c) {
+        bounds[c] = std::max(bounds[c - 1], line_end(begin + c * (bytes / chunks), end));
+    }
+
+    // Pass 1: lines and records per chunk
+    std::vector<Index> lines(chunks + 1, 0), records(chunks + 1, 0);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (std::size_t c = 0; c < chunks; ++c) {
+        for (const char* p = bounds[c]; p < bounds[c + 1]; ) {
+            const char* next = line_end(p, bounds[c + 1]);
+            lines[c + 1]++;
+            records[c + 1] += !is_blank_line(p, next);
+            p = next;
+        }
+    }
+
+    for (std::size_t c = 0; c < chunks; ++c) {
+        lines[c + 1] += lines[c];
+        records[c + 1] += records[c];
+    }
+
+    if (records[chunks] < count) {
+        std::cerr << "Error: Expected " << count << " particles, found " << records[chunks] << "\n";
+        return std::nullopt;
+    }
+
+    // Pass 2: parse each chunk into its slice; records beyond count are ignored
+    std::vector<BasicParticle<Dim>> particles(count);
+    std::vector<std::optional<ParseError>> errors(chunks);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (std::size_t c = 0; c < chunks; ++c) {
+        Index line = first_line + lines[c] + 1;
+        Index index = records[c];
+
+        for (const char* p = bounds[c]; p < bounds[c + 1] && index < count; ++line) {
+            const char* next = line_end(p, bounds[c + 1]);
+            if (!is_blank_line(p, next)) {
+                if (auto message = parse_particle_line<Dim>(p, next, index, particles[index])) {
+                    errors[c] = ParseError{line, std::move(*message)};
+                    break;
+                }
+                ++index;
+            }
+            p = next;
+        }
+    }
+
+    // Report the first malformed line in file order
+    for (const auto& error : errors) {
+        if (error) {
+            std::cerr << "Error: Line " << error->line << ": " << error->message << "\n";
+            return std::nullopt;
+        }
+    }
+
+    return particles;
+}
+
+} // namespace
+
+template <int Dim>
+std::optional<std::vector<BasicParticle<Dim>>> read_particle_file(
     std::string_view filename,
     const SimulationConfig& config) {
 
-    std::ifstream infile(filename.data());
-    if (!infile) {
-        std::cerr << "Error: Could not open file: " << filename << "\n";
+    if (is_binary_particle_file(filename)) {
+        const auto file = BinaryParticleFile::open(filename);
+        if (!file) {
+            return std::nullopt;
+        }
+        if (file->config().particle_count != config.particle_count) {
+            std::cerr << "Error: Particle count mismatch\n";
+            return std::nullopt;
+        }
+        return file->particles<Dim>();
+    }
+
+    const auto mapping = MappedFile::open(filename);
+    if (!mapping) {
         return std::nullopt;
     }
 
-    // Skip config data (already read)
-    Index n;
+    const char* cursor = reinterpret_cast<const char*>(mapping->data());
+    const char* const end = cursor + mapping->size();
+
+    // Skip config data (already read); the particles start on the next line
+    Index n = 0;
     Real start_time, end_time, time_step;
-    infile >> n >> start_time >> end_time >> time_step;
+    if (!parse_header_token(cursor, end, n) ||
+        !parse_header_token(cursor, end, start_time) ||
+        !parse_header_token(cursor, end, end_time) ||
+        !parse_header_token(cursor, end, time_step)) {
+        std::cerr << "Error: Invalid configuration header in " << filename << "\n";
+        return std::nullopt;
+    }
 
     if (n != config.particle_count) {
         std::cerr << "Error: Particle count mismatch\n";
         return std::nullopt;
     }
 
-    std::vector<Particle> particles;
-    particles.reserve(config.particle_count);
+    const char* const body = line_end(cursor, end);
+    const Index header_lines = std::count(reinterpret_cast<const char*>(mapping->data()), body, '\n');
 
-    for (Index i = 0; i < config.particle_count; ++i) {
-        Real mass;
-        Vector3D pos, vel;
+    return parse_particle_lines<Dim>(body, end, n, header_lines);
+}
 
-        if (!(infile >> mass)) {
-            std::cerr << "Error: Failed to read mass for particle " << i << "\n";
-            return std::nullopt;
-        }
+template std::optional<std::vector<Particle2D>> read_particle_file<2>(std::string_view, const SimulationConfig&);
+template std::optional<std::vector<Particle3D>> read_particle_file<3>(std::string_view, const SimulationConfig&);
 
-        if (mass <= 0.0) {
-            std::cerr << "Error: Invalid mass for particle " << i << " (must be > 0)\n";
-            return std::nullopt;
-        }
+std::string snapshot_filename(std::string_view base_filename, Index particle_count, Real theta,
+                              Index particles_per_leaf, Index number, std::string_view extension) {
+    std::ostringstream filename;
+    filename << base_filename << "_BH"
+             << particle_count / 1000 << "K"
+             << "_theta" << std::fixed << std::setprecision(2) << theta
+             << "_pLeaf" << particles_per_leaf
+             << "_" << number << extension;
+    return filename.str();
+}
 
-        // Read position
-        for (int dim = 0; dim < NDIM; ++dim) {
-            if (!(infile >> pos[dim])) {
-                std::cerr << "Error: Failed to read position for particle " << i << "\n";
-                return std::nullopt;
-            }
-        }
+namespace {
+
+// Text snapshots are formatted by all threads at once, each into its own
+// buffer of FORMAT_CHUNK lines; the buffers are then written in order. "All
+// threads" is the calling thread's OpenMP thread count, which
+// AsyncSnapshotWriter caps on its writer thread.
+constexpr Index FORMAT_CHUNK = 1 << 14;
+
+// value as "%+.<precision>e", the showpos/scientific ostream format.
+// Writes at most precision + 8 characters. The sign bit is tested directly:
+// std::signbit may ignore the sign of zero under -ffast-math.
+char* format_real(char* out, Real value, int precision) {
+    if ((std::bit_cast<std::uint64_t>(value) >> 63) == 0) {
+        *out++ = '+';
+    }
+    return std::to_chars(out, out + precision + 8, value, std::chars_format::scientific, precision).ptr;
+}
 
-        // Read velocity
-        for (int dim = 0; dim < NDIM; ++dim) {
-            if (!(infile >> vel[dim])) {
-                std::cerr << "Error: Failed to read velocity for particle " << i << "\n";
-                return std::nullopt;
+// One line per item: the Dim components of field(item) separated by two spaces
+template <int Dim, typename T, typename Field>
+void write_vector_lines(std::ostream& outfile, std::span<const T> items, Field field, int precision) {
+    int threads = 1;
+    #ifdef _OPENMP
+    threads = omp_get_max_threads();
+    #endif
+
+    const std::size_t line_capacity = Dim * (precision + 10) + 1;
+    const std::size_t buffer_capacity = FORMAT_CHUNK * line_capacity;
+    std::vector<char> buffers(threads * buffer_capacity);
+    std::vector<std::size_t> lengths(threads);
+
+    const Index batch_size = threads * FORMAT_CHUNK;
+    for (Index batch = 0; batch < items.size(); batch += batch_size) {
+        const Index batch_end = std::min(items.size(), batch + batch_size);
+
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static, 1)
+        #endif
+        for (int t = 0; t < threads; ++t) {
+            const Index begin = std::min(batch + t * FORMAT_CHUNK, batch_end);
+            const Index end = std::min(begin + FORMAT_CHUNK, batch_end);
+            char* const buffer = buffers.data() + t * buffer_capacity;
+            char* out = buffer;
+            for (Index i = begin; i < end; ++i) {
+                const BasicVector<Dim>& vec = field(items[i]);
+                out = format_real(out, vec[0], precision);
+                for (int k = 1; k < Dim; ++k) {
+                    *out++ = ' ';
+                    *out++ = ' ';
+                    out = format_real(out, vec[k], precision);
+                }
+                *out++ = '\n';
             }
+            lengths[t] = static_cast<std::size_t>(out - buffer);
         }
 
-        particles.emplace_back(mass, pos, vel);
+        for (int t = 0; t < threads; ++t) {
+            outfile.write(buffers.data() + t * buffer_capacity, static_cast<std::streamsize>(lengths[t]));
+        }
     }
-
-    return particles;
 }
 
-bool write_particle_positions(
-    std::span<const Particle> particles,
+template <int Dim>
+bool write_positions(
+    std::span<const BasicParticle<Dim>> particles,
     std::string_view message,
     Real theta,
     Index particles_per_leaf,
@@ -110,98 +356,220 @@ bool write_particle_positions(
 
     static Index counter = 1;
 
-    std::ostringstream filename;
-    filename << base_filename << "_BH"
-             << particles.size() / 1000 << "K"
-             << "_theta" << std::fixed << std::setprecision(2) << theta
-             << "_pLeaf" << particles_per_leaf
-             << "_" << counter++ << ".dat";
+    const std::string filename = snapshot_filename(base_filename, particles.size(), theta,
+                                                   particles_per_leaf, counter++);
 
-    std::ofstream outfile(filename.str());
+    std::ofstream outfile(filename);
     if (!outfile) {
-        std::cerr << "Error: Could not create output file: " << filename.str() << "\n";
+        std::cerr << "Error: Could not create output file: " << filename << "\n";
         return false;
     }
 
     outfile << message << "\nNumber of particles = " << particles.size() << "\n\n";
 
-    outfile << std::showpos << std::scientific << std::setprecision(6);
-    for (const auto& particle : particles) {
-        outfile << particle.position() << "\n";
+    write_vector_lines<Dim>(outfile, particles,
+                            [](const BasicParticle<Dim>& particle) -> const BasicVector<Dim>& {
+                                return particle.position();
+                            }, 6);
+    if (!outfile) {
+        std::cerr << "Error: Failed writing output file: " << filename << "\n";
+        return false;
     }
 
-    std::cout << "Wrote positions to: " << filename.str() << "\n";
+    std::cout << "Wrote positions to: " << filename << "\n";
     return true;
 }
 
-bool write_particle_forces(
-    std::span<const Particle> particles,
+template <int Dim>
+bool write_forces(
+    std::span<const BasicVector<Dim>> forces,
     std::string_view message,
     Real theta,
     Index particles_per_leaf,
+    Index number,
     std::string_view base_filename) {
 
-    static Index counter = 1;
+    const std::string filename = snapshot_filename(base_filename, forces.size(), theta,
+                                                   particles_per_leaf, number);
 
-    std::ostringstream filename;
-    filename << base_filename << "_BH"
-             << particles.size() / 1000 << "K"
-             << "_theta" << std::fixed << std::setprecision(2) << theta
-             << "_pLeaf" << particles_per_leaf
-             << "_" << counter++ << ".dat";
+    std::ofstream outfile(filename);
+    if (!outfile) {
+        std::cerr << "Error: Could not create output file: " << filename << "\n";
+        return false;
+    }
+
+    outfile << message << "\n" << forces.size() << "\n\n";
 
-    std::ofstream outfile(filename.str());
+    write_vector_lines<Dim>(outfile, forces,
+                            [](const BasicVector<Dim>& force) -> const BasicVector<Dim>& { return force; }, 40);
     if (!outfile) {
-        std::cerr << "Error: Could not create output file: " << filename.str() << "\n";
+        std::cerr << "Error: Failed writing output file: " << filename << "\n";
         return false;
     }
 
-    outfile << message << "\n" << particles.size() << "\n\n";
+    std::cout << "Wrote forces to: " << filename << "\n";
+    return true;
+}
+
+template <int Dim>
+bool write_particle_forces_impl(
+    std::span<const BasicParticle<Dim>> particles,
+    std::string_view message,
+    Real theta,
+    Index particles_per_leaf,
+    std::string_view base_filename) {
+
+    static std::atomic<Index> counter = 1;
 
-    outfile << std::showpos << std::scientific << std::setprecision(40);
+    std::vector<BasicVector<Dim>> forces;
+    forces.reserve(particles.size());
     for (const auto& particle : particles) {
-        outfile << particle.force() << "\n";
+        forces.push_back(particle.force());
     }
+    return write_forces<Dim>(forces, message, theta, particles_per_leaf, counter++, base_filename);
+}
 
-    std::cout << "Wrote forces to: " << filename.str() << "\n";
-    return true;
+// Records of Real type T, packed by all threads FORMAT_CHUNK particles at a time
+template <typename T, int Dim>
+void write_gnuplot_records(std::ostream& outfile, std::span<const BasicParticle<Dim>> particles) {
+    constexpr int fields = 1 + 2 * Dim;
+    std::vector<T> records(std::min<Index>(particles.size(), FORMAT_CHUNK) * fields);
+
+    for (Index begin = 0; begin < particles.size(); begin += FORMAT_CHUNK) {
+        const Index count = std::min<Index>(particles.size() - begin, FORMAT_CHUNK);
+
+        #ifdef _OPENMP
+        #pragma omp parallel for
+        #endif
+        for (Index i = 0; i < count; ++i) {
+            const auto& particle = particles[begin + i];
+            T* record = records.data() + i * fields;
+            record[0] = static_cast<T>(particle.mass());
+            for (int k = 0; k < Dim; ++k) {
+                record[1 + k] = static_cast<T>(particle.position()[k]);
+                record[1 + Dim + k] = static_cast<T>(particle.velocity()[k]);
+            }
+        }
+
+        outfile.write(reinterpret_cast<const char*>(records.data()),
+                      static_cast<std::streamsize>(count * fields * sizeof(T)));
+    }
 }
 
-bool generate_test_data(std::string_view filename, const SimulationConfig& config) {
-    if (!config.is_valid()) {
-        std::cerr << "Error: Invalid configuration\n";
+template <int Dim>
+bool write_gnuplot_binary_impl(std::string_view filename, std::span<const BasicParticle<Dim>> particles,
+                               bool single_precision) {
+    std::ofstream outfile(std::string(filename), std::ios::binary);
+    if (!outfile) {
+        std::cerr << "Error: Could not create output file: " << filename << "\n";
         return false;
     }
 
-    std::ofstream outfile(filename.data());
+    if (single_precision) {
+        write_gnuplot_records<float>(outfile, particles);
+    }
+    else {
+        write_gnuplot_records<double>(outfile, particles);
+    }
     if (!outfile) {
-        std::cerr << "Error: Could not create file: " << filename << "\n";
+        std::cerr << "Error: Failed writing output file: " << filename << "\n";
         return false;
     }
 
-    // Write configuration
-    outfile << config.particle_count << "\n"
-            << config.start_time << "\n"
-            << config.end_time << "\n"
-            << config.time_step << "\n";
+    const std::string descriptor_name = std::string(filename) + ".gp";
+    std::ofstream descriptor(descriptor_name);
+    if (!descriptor) {
+        std::cerr << "Error: Could not create output file: " << descriptor_name << "\n";
+        return false;
+    }
 
-    // Generate random particles
-    for (Index i = 0; i < config.particle_count; ++i) {
-        // Mass between 5000 and 15000
-        const Real mass = generate_random(5000.0, 15000.0);
-        outfile << mass;
+    std::string format;
+    for (int field = 0; field < 1 + 2 * Dim; ++field) {
+        format += single_precision ? "%float32" : "%float64";
+    }
+    constexpr std::string_view axes = "xyz";
 
-        // Position between 0 and 10
-        for (int dim = 0; dim < NDIM; ++dim) {
-            outfile << " " << generate_random(0.0, 10.0);
-        }
+    descriptor << "# Barnes-Hut binary particle records: gnuplot -e \"descriptor='"
+               << descriptor_name << "'\" <script>.gnu\n"
+               << "# Columns: mass";
+    for (int k = 0; k < Dim; ++k) {
+        descriptor << " " << axes[k];
+    }
+    for (int k = 0; k < Dim; ++k) {
+        descriptor << " v" << axes[k];
+    }
+    descriptor << "\n"
+               << "particle_file = \"" << filename << "\"\n"
+               << "particle_count = " << particles.size() << "\n"
+               << "dimension = " << Dim << "\n"
+               << "binary_format = \"" << format << "\"\n"
+               << "binary_endian = \"" << (std::endian::native == std::endian::little ? "little" : "big") << "\"\n";
+
+    std::cout << "Wrote gnuplot binary to: " << filename << " (descriptor " << descriptor_name << ")\n";
+    return true;
+}
 
-        // Velocity between 0 and 100
-        for (int dim = 0; dim < NDIM; ++dim) {
-            outfile << " " << generate_random(0.0, 100.0);
-        }
+} // namespace
+
+bool write_gnuplot_binary(std::string_view filename, std::span<const Particle2D> particles,
+                          bool single_precision) {
+    return write_gnuplot_binary_impl(filename, particles, single_precision);
+}
 
-        outfile << "\n";
+bool write_gnuplot_binary(std::string_view filename, std::span<const Particle3D> particles,
+                          bool single_precision) {
+    return write_gnuplot_binary_impl(filename, particles, single_precision);
+}
+
+bool write_particle_positions(std::span<const Particle2D> particles, std::string_view message,
+                              Real theta, Index particles_per_leaf, std::string_view base_filename) {
+    return write_positions(particles, message, theta, particles_per_leaf, base_filename);
+}
+
+bool write_particle_positions(std::span<const Particle3D> particles, std::string_view message,
+                              Real theta, Index particles_per_leaf, std::string_view base_filename) {
+    return write_positions(particles, message, theta, particles_per_leaf, base_filename);
+}
+
+bool write_particle_forces(std::span<const Particle2D> particles, std::string_view message,
+                           Real theta, Index particles_per_leaf, std::string_view base_filename) {
+    return write_particle_forces_impl(particles, message, theta, particles_per_leaf, base_filename);
+}
+
+bool write_particle_forces(std::span<const Particle3D> particles, std::string_view message,
+                           Real theta, Index particles_per_leaf, std::string_view base_filename) {
+    return write_particle_forces_impl(particles, message, theta, particles_per_leaf, base_filename);
+}
+
+bool write_force_snapshot(std::span<const Vector2D> forces, std::string_view message,
+                          Real theta, Index particles_per_leaf, Index number, std::string_view base_filename) {
+    return write_forces(forces, message, theta, particles_per_leaf, number, base_filename);
+}
+
+bool write_force_snapshot(std::span<const Vector3D> forces, std::string_view message,
+                          Real theta, Index particles_per_leaf, Index number, std::string_view base_filename) {
+    return write_forces(forces, message, theta, particles_per_leaf, number, base_filename);
+}
+
+bool generate_test_data(std::string_view filename, const SimulationConfig& config, int dimension,
+                        std::uint64_t seed) {
+    if (!config.is_valid()) {
+        std::cerr << "Error: Invalid configuration\n";
+        return false;
+    }
+
+    if (dimension != 2 && dimension != 3) {
+        std::cerr << "Error: Dimension must be 2 or 3\n";
+        return false;
+    }
+
+    InitialConditions conditions;
+    conditions.model = InitialModel::Uniform;
+    conditions.particle_count = config.particle_count;
+    conditions.seed = seed;
+
+    if (!write_initial_conditions(filename, config, conditions, dimension, true)) {
+        return false;
     }
 
     std::cout << "Generated test data in: " << filename << "\n";
@@ -2,6 +2,7 @@
 
 #include "particle.h"
 #include "vektor.h"
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <filesystem>
@@ -18,27 +19,44 @@ struct SimulationConfig {
     Real time_step = 0.01;
     Real theta = 0.5;
     Index particles_per_leaf = 1;
+    Real box_size = 0.0;  // > 0 enables periodic boundaries
 
     [[nodiscard]] bool is_valid() const noexcept {
         return particle_count > 0 &&
                end_time > start_time &&
                time_step > 0.0 &&
                theta > 0.0 &&
-               particles_per_leaf > 0;
+               particles_per_leaf > 0 &&
+               box_size >= 0.0;
     }
 };
 
-// Modern file reading with std::optional for error handling
+// Modern file reading with std::optional for error handling.
+// Both readers also accept the binary format of binary_file.h (detected by its magic).
 [[nodiscard]] std::optional<SimulationConfig>
 read_config_file(std::string_view filename);
 
-// Read particle data from file
-[[nodiscard]] std::optional<std::vector<Particle>>
+// Read particle data from file (Dim position and velocity columns per particle)
+template <int Dim = NDIM>
+[[nodiscard]] std::optional<std::vector<BasicParticle<Dim>>>
 read_particle_file(std::string_view filename, const SimulationConfig& config);
 
+// Snapshot file name: <base>_BH<N/1000>K_theta<theta>_pLeaf<leaf>_<number><extension>
+[[nodiscard]] std::string snapshot_filename(std::string_view base_filename, Index particle_count, Real theta,
+                                            Index particles_per_leaf, Index number,
+                                            std::string_view extension = ".dat");
+
 // Write particle positions to file
 bool write_particle_positions(
-    std::span<const Particle> particles,
+    std::span<const Particle2D> particles,
+    std::string_view message,
+    Real theta,
+    Index particles_per_leaf,
+    std::string_view base_filename = "snapPOS"
+);
+
+bool write_particle_positions(
+    std::span<const Particle3D> particles,
     std::string_view message,
     Real theta,
     Index particles_per_leaf,
@@ -47,14 +65,55 @@ bool write_particle_positions(
 
 // Write particle forces to file
 bool write_particle_forces(
-    std::span<const Particle> particles,
+    std::span<const Particle2D> particles,
+    std::string_view message,
+    Real theta,
+    Index particles_per_leaf,
+    std::string_view base_filename = "snapFORCE"
+);
+
+bool write_particle_forces(
+    std::span<const Particle3D> particles,
     std::string_view message,
     Real theta,
     Index particles_per_leaf,
     std::string_view base_filename = "snapFORCE"
 );
 
-// Generate random test data
-bool generate_test_data(std::string_view filename, const SimulationConfig& config);
+// Write force snapshot number from the force vectors alone (same format as
+// write_particle_forces, which numbers its files itself)
+bool write_force_snapshot(
+    std::span<const Vector2D> forces,
+    std::string_view message,
+    Real theta,
+    Index particles_per_leaf,
+    Index number,
+    std::string_view base_filename = "snapFORCE"
+);
+
+bool write_force_snapshot(
+    std::span<const Vector3D> forces,
+    std::string_view message,
+    Real theta,
+    Index particles_per_leaf,
+    Index number,
+    std::string_view base_filename = "snapFORCE"
+);
+
+// Write raw binary records (mass, position, velocity: the columns of the text
+// input files) as float64, or float32 if single_precision, for gnuplot's
+// "binary format=" input. A descriptor <filename>.gp defines particle_file,
+// binary_format and binary_endian for the scripts (see particle_data.gnu).
+bool write_gnuplot_binary(std::string_view filename, std::span<const Particle2D> particles,
+                          bool single_precision = false);
+
+bool write_gnuplot_binary(std::string_view filename, std::span<const Particle3D> particles,
+                          bool single_precision = false);
+
+// Generate random test data with dimension (2 or 3) coordinates per particle:
+// uniform masses, positions and velocities, reproducible from seed
+// (see initial_conditions.h for the physical models)
+bool generate_test_data(std::string_view filename, const SimulationConfig& config, int dimension = NDIM,
+                        std::uint64_t seed = 1);
 
 } // namespace barnes_hut
@@ -1,29 +1,39 @@
 /**
  * Modern Data Generator for Barnes-Hut Simulation
- * Generates random particle data for testing
+ * Generates reproducible particle data for testing
  */
 
 #include "file.h"
+#include "initial_conditions.h"
 #include <iostream>
 #include <string>
 
 using namespace barnes_hut;
 
 void print_usage(const char* program_name) {
-    std::cout << "Usage: " << program_name << " <filename> <num_particles> <t_start> <t_end> <dt>\n"
+    std::cout << "Usage: " << program_name << " <filename> <num_particles> <t_start> <t_end> <dt> [options]\n"
               << "  filename: Output file name\n"
               << "  num_particles: Number of particles to generate\n"
               << "  t_start: Simulation start time\n"
               << "  t_end: Simulation end time\n"
               << "  dt: Time step\n"
+              << "\nOptions:\n"
+              << "  --dim <2|3>        Coordinates per particle [default: 3]\n"
+              << "  --model <name>     uniform, plummer, hernquist, disk or clustered [default: uniform]\n"
+              << "  --seed <n>         Random seed; equal seeds give identical files [default: 1]\n"
+              << "  --mass <M>         Total mass of the physical models [default: 1]\n"
+              << "  --scale <a>        Scale length of the physical models [default: 1]\n"
+              << "  --binary           Write a binary particle file (see convert_particles)\n"
               << "\nExample:\n"
-              << "  " << program_name << " test.dat 1000 0.0 1.0 0.01\n";
+              << "  " << program_name << " test.dat 1000 0.0 1.0 0.01\n"
+              << "  " << program_name << " test2d.dat 1000 0.0 1.0 0.01 --dim 2\n"
+              << "  " << program_name << " plummer.bhp 1000000 0.0 10.0 0.01 --model plummer --binary\n";
 }
 
 int main(int argc, char* argv[]) {
     std::cout << "=== Modern Barnes-Hut Data Generator ===\n\n";
 
-    if (argc != 6) {
+    if (argc < 6) {
         print_usage(argv[0]);
         return 1;
     }
@@ -34,29 +44,77 @@ int main(int argc, char* argv[]) {
     const Real t_end = std::stod(argv[4]);
     const Real dt = std::stod(argv[5]);
 
+    int dimension = NDIM;
+    bool binary = false;
+    InitialConditions conditions;
+    conditions.particle_count = num_particles;
+
+    for (int i = 6; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "--dim" && i + 1 < argc) {
+            dimension = std::stoi(argv[++i]);
+            if (dimension != 2 && dimension != 3) {
+                std::cerr << "Error: Dimension must be 2 or 3\n";
+                return 1;
+            }
+        }
+        else if (arg == "--model" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            const auto model = parse_initial_model(name);
+            if (!model) {
+                std::cerr << "Error: Unknown model: " << name << "\n";
+                return 1;
+            }
+            conditions.model = *model;
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            conditions.seed = std::stoull(argv[++i]);
+        }
+        else if (arg == "--mass" && i + 1 < argc) {
+            conditions.total_mass = std::stod(argv[++i]);
+        }
+        else if (arg == "--scale" && i + 1 < argc) {
+            conditions.scale_length = std::stod(argv[++i]);
+        }
+        else if (arg == "--binary") {
+            binary = true;
+        }
+        else {
+            std::cerr << "Error: Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
     SimulationConfig config;
     config.particle_count = num_particles;
     config.start_time = t_start;
     config.end_time = t_end;
     config.time_step = dt;
 
-    if (!config.is_valid()) {
+    if (!config.is_valid() || !(conditions.total_mass > 0.0) || !(conditions.scale_length > 0.0)) {
         std::cerr << "Error: Invalid configuration parameters\n";
-        std::cerr << "  Ensure: N > 0, t_end > t_start, dt > 0\n";
+        std::cerr << "  Ensure: N > 0, t_end > t_start, dt > 0, mass > 0, scale > 0\n";
         return 2;
     }
 
     std::cout << "Generating data:\n"
-              << "  Output file: " << filename << "\n"
+              << "  Output file: " << filename << (binary ? " (binary)" : "") << "\n"
               << "  Particles: " << num_particles << "\n"
+              << "  Model: " << to_string(conditions.model) << " (seed " << conditions.seed << ")\n"
               << "  Time range: " << t_start << " -> " << t_end << "\n"
-              << "  Time step: " << dt << "\n\n";
+              << "  Time step: " << dt << "\n"
+              << "  Dimension: " << dimension << "\n\n";
 
-    if (!generate_test_data(filename, config)) {
+    Timer timer;
+    if (!write_initial_conditions(filename, config, conditions, dimension, !binary)) {
         std::cerr << "Error: Failed to generate data\n";
         return 3;
     }
 
-    std::cout << "\nData generation successful!\n";
+    std::cout << "Generated " << to_string(conditions.model) << " data in: " << filename
+              << " (" << timer.elapsed() << "s)\n"
+              << "\nData generation successful!\n";
     return 0;
 }
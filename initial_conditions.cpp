@@ -0,0 +1,341 @@
+#include "initial_conditions.h"
+#include "binary_file.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numbers>
+
+namespace barnes_hut {
+
+namespace {
+
+// Streams of the counter generator (one per kind of draw)
+constexpr std::uint32_t PARTICLE_STREAM = 0;
+constexpr std::uint32_t CLUSTER_STREAM = 1;
+
+// Mass fractions beyond which the infinite spheres are truncated, so that a
+// few far-out particles do not blow up the tree's bounding box
+constexpr Real PLUMMER_MASS_FRACTION = 0.999;
+constexpr Real HERNQUIST_MASS_FRACTION = 0.99;
+
+// Disk scale height relative to the scale length (sech^2 profile)
+constexpr Real DISK_THICKNESS = 0.1;
+
+// Soneira-Peebles: CLUSTER_BRANCHING sub-clusters per cluster, radii shrinking
+// so that the points have fractal dimension CLUSTER_DIMENSION
+constexpr Index CLUSTER_BRANCHING = 4;
+constexpr Real CLUSTER_DIMENSION = 1.8;
+
+// Particles generated per chunk when streaming to a file
+constexpr Index GENERATE_CHUNK = Index{1} << 16;
+
+// Uniformly distributed unit vector
+Vector3D random_direction(CounterRandom& random) noexcept {
+    const Real z = 2.0 * random.uniform() - 1.0;
+    const Real phi = 2.0 * std::numbers::pi * random.uniform();
+    const Real r = std::sqrt(std::max(0.0, 1.0 - z * z));
+    return Vector3D{r * std::cos(phi), r * std::sin(phi), z};
+}
+
+// Uniformly distributed in the Dim-dimensional unit ball (by rejection)
+template <int Dim>
+BasicVector<Dim> random_in_ball(CounterRandom& random) noexcept {
+    while (true) {
+        BasicVector<Dim> point;
+        for (int k = 0; k < Dim; ++k) {
+            point[k] = 2.0 * random.uniform() - 1.0;
+        }
+        if (point.squared_magnitude() <= 1.0) {
+            return point;
+        }
+    }
+}
+
+template <int Dim>
+BasicVector<Dim> project(const Vector3D& vector) noexcept {
+    BasicVector<Dim> projected;
+    for (int k = 0; k < Dim; ++k) {
+        projected[k] = vector[k];
+    }
+    return projected;
+}
+
+// Aarseth, Henon & Wielen (1974): radius from the cumulative mass, speed
+// by rejection from the isotropic distribution function
+void plummer(CounterRandom& random, Real& radius, Real& speed) noexcept {
+    const Real mass_fraction = PLUMMER_MASS_FRACTION * random.uniform_positive();
+    radius = 1.0 / std::sqrt(std::pow(mass_fraction, -2.0 / 3.0) - 1.0);
+
+    Real q = 0.0;
+    while (true) {
+        q = random.uniform();
+        const Real g = 0.1 * random.uniform();
+        if (g <= q * q * std::pow(1.0 - q * q, 3.5)) {
+            break;
+        }
+    }
+    speed = q * std::numbers::sqrt2 * std::pow(1.0 + radius * radius, -0.25);
+}
+
+// Hernquist (1990): radius from the cumulative mass; the isotropic velocity
+// dispersion of his eq. 10 (in long double: the bracket cancels at large r),
+// with Gaussian velocities below the escape speed
+void hernquist(CounterRandom& random, Real& radius, Vector3D& velocity) noexcept {
+    const Real root = std::sqrt(HERNQUIST_MASS_FRACTION * random.uniform_positive());
+    radius = root / (1.0 - root);
+
+    const long double s = radius;
+    const long double bracket = 12.0L * s * (1.0L + s) * (1.0L + s) * (1.0L + s) * std::log1p(1.0L / s) -
+                                s / (1.0L + s) * (25.0L + 52.0L * s + 42.0L * s * s + 12.0L * s * s * s);
+    const Real sigma = std::sqrt(std::max(0.0, static_cast<Real>(bracket / 12.0L)));
+    const Real escape_squared = 2.0 / (1.0 + radius);
+
+    do {
+        velocity = Vector3D{sigma * random.normal(), sigma * random.normal(), sigma * random.normal()};
+    } while (velocity.squared_magnitude() >= escape_squared);
+}
+
+// Exponential disk: the radius is Gamma(2)-distributed (sum of two
+// exponentials), the circular speed that of a razor-thin disk (Freeman 1970)
+template <int Dim>
+void exponential_disk(CounterRandom& random, BasicVector<Dim>& position, BasicVector<Dim>& velocity) noexcept {
+    const Real radius = -std::log(random.uniform_positive()) - std::log(random.uniform_positive());
+    const Real phi = 2.0 * std::numbers::pi * random.uniform();
+
+    const Real y = radius / 2.0;
+    Real speed = 0.0;
+    if (y > 1e-12) {
+        const Real bessel = std::cyl_bessel_i(0.0, y) * std::cyl_bessel_k(0.0, y) -
+                            std::cyl_bessel_i(1.0, y) * std::cyl_bessel_k(1.0, y);
+        speed = std::sqrt(std::max(0.0, 2.0 * y * y * bessel));
+    }
+
+    position = BasicVector<Dim>{0.0};
+    velocity = BasicVector<Dim>{0.0};
+    position[0] = radius * std::cos(phi);
+    position[1] = radius * std::sin(phi);
+    velocity[0] = -speed * std::sin(phi);
+    velocity[1] = speed * std::cos(phi);
+    if constexpr (Dim == 3) {
+        position[2] = DISK_THICKNESS * std::atanh(2.0 * random.uniform_positive() - 1.0);
+    }
+}
+
+// Soneira & Peebles (1978): every cluster holds CLUSTER_BRANCHING clusters
+// at uniform points inside it, each smaller by the factor lambda; particle
+// index sits in the leaf cluster named by its base-CLUSTER_BRANCHING digits.
+// Each cluster centre is drawn from the cluster's own number, so particles
+// sharing a cluster agree on it without any shared state.
+template <int Dim>
+BasicVector<Dim> clustered(const InitialConditions& conditions, Index index) noexcept {
+    Index levels = 0;
+    for (Index leaves = 1; leaves < conditions.particle_count; leaves *= CLUSTER_BRANCHING) {
+        ++levels;
+    }
+    const Real lambda = std::pow(static_cast<Real>(CLUSTER_BRANCHING), 1.0 / CLUSTER_DIMENSION);
+
+    Index leaves_below = 1;
+    for (Index level = 0; level < levels; ++level) {
+        leaves_below *= CLUSTER_BRANCHING;
+    }
+
+    BasicVector<Dim> position{0.0};
+    Real radius = 1.0;
+    Index level_start = 1;      // Number of the first cluster of the level
+    Index level_size = 1;
+    for (Index level = 1; level <= levels; ++level) {
+        leaves_below /= CLUSTER_BRANCHING;
+        level_size *= CLUSTER_BRANCHING;
+        const Index cluster = level_start + index / leaves_below;
+
+        CounterRandom random(conditions.seed, cluster, CLUSTER_STREAM);
+        position += radius * random_in_ball<Dim>(random);
+
+        radius /= lambda;
+        level_start += level_size;
+    }
+    return position;
+}
+
+} // namespace
+
+Real CounterRandom::normal() noexcept {
+    const Real radius = std::sqrt(-2.0 * std::log(uniform_positive()));
+    return radius * std::cos(2.0 * std::numbers::pi * uniform());
+}
+
+std::string_view to_string(InitialModel model) noexcept {
+    switch (model) {
+        case InitialModel::Uniform:         return "uniform";
+        case InitialModel::Plummer:         return "plummer";
+        case InitialModel::Hernquist:       return "hernquist";
+        case InitialModel::ExponentialDisk: return "disk";
+        case InitialModel::Clustered:       return "clustered";
+    }
+    return "unknown";
+}
+
+std::optional<InitialModel> parse_initial_model(std::string_view name) noexcept {
+    for (const auto model : {InitialModel::Uniform, InitialModel::Plummer, InitialModel::Hernquist,
+                             InitialModel::ExponentialDisk, InitialModel::Clustered}) {
+        if (name == to_string(model)) {
+            return model;
+        }
+    }
+    return std::nullopt;
+}
+
+template <int Dim>
+BasicParticle<Dim> generate_particle(const InitialConditions& conditions, Index index) {
+    using Vector = BasicVector<Dim>;
+
+    CounterRandom random(conditions.seed, index, PARTICLE_STREAM);
+    const Real mass = conditions.total_mass / static_cast<Real>(conditions.particle_count);
+    const Real length = conditions.scale_length;
+    const Real speed_unit = std::sqrt(GRAVITY * conditions.total_mass / length);
+
+    switch (conditions.model) {
+        case InitialModel::Uniform: {
+            // Mass in [5000, 15000), position in [0, 10), velocity in [0, 100)
+            const Real particle_mass = 5000.0 + 10000.0 * random.uniform();
+            Vector position;
+            Vector velocity;
+            for (int k = 0; k < Dim; ++k) {
+                position[k] = 10.0 * random.uniform();
+            }
+            for (int k = 0; k < Dim; ++k) {
+                velocity[k] = 100.0 * random.uniform();
+            }
+            return BasicParticle<Dim>(particle_mass, position, velocity);
+        }
+        case InitialModel::Plummer: {
+            Real radius = 0.0;
+            Real speed = 0.0;
+            plummer(random, radius, speed);
+            const Vector3D position = (radius * length) * random_direction(random);
+            const Vector3D velocity = (speed * speed_unit) * random_direction(random);
+            return BasicParticle<Dim>(mass, project<Dim>(position), project<Dim>(velocity));
+        }
+        case InitialModel::Hernquist: {
+            Real radius = 0.0;
+            Vector3D velocity;
+            hernquist(random, radius, velocity);
+            const Vector3D position = (radius * length) * random_direction(random);
+            return BasicParticle<Dim>(mass, project<Dim>(position), project<Dim>(speed_unit * velocity));
+        }
+        case InitialModel::ExponentialDisk: {
+            Vector position;
+            Vector velocity;
+            exponential_disk<Dim>(random, position, velocity);
+            return BasicParticle<Dim>(mass, length * position, speed_unit * velocity);
+        }
+        case InitialModel::Clustered:
+            return BasicParticle<Dim>(mass, length * clustered<Dim>(conditions, index), Vector{0.0});
+    }
+    return BasicParticle<Dim>();
+}
+
+template BasicParticle<2> generate_particle<2>(const InitialConditions&, Index);
+template BasicParticle<3> generate_particle<3>(const InitialConditions&, Index);
+
+template <int Dim>
+std::vector<BasicParticle<Dim>> generate_particles(const InitialConditions& conditions) {
+    std::vector<BasicParticle<Dim>> particles(conditions.particle_count);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (Index i = 0; i < particles.size(); ++i) {
+        particles[i] = generate_particle<Dim>(conditions, i);
+    }
+    return particles;
+}
+
+template std::vector<Particle2D> generate_particles<2>(const InitialConditions&);
+template std::vector<Particle3D> generate_particles<3>(const InitialConditions&);
+
+namespace {
+
+// Generate the particles in chunks of GENERATE_CHUNK (in parallel) and hand
+// each chunk to consume(first index, particles)
+template <int Dim, typename Consume>
+bool generate_chunks(const InitialConditions& conditions, Consume&& consume) {
+    std::vector<BasicParticle<Dim>> chunk(std::min(conditions.particle_count, GENERATE_CHUNK));
+    for (Index begin = 0; begin < conditions.particle_count; begin += GENERATE_CHUNK) {
+        const Index count = std::min(conditions.particle_count - begin, GENERATE_CHUNK);
+
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+        #endif
+        for (Index i = 0; i < count; ++i) {
+            chunk[i] = generate_particle<Dim>(conditions, begin + i);
+        }
+
+        if (!consume(begin, std::span<const BasicParticle<Dim>>(chunk.data(), count))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <int Dim>
+bool write_binary_conditions(std::string_view filename, SimulationConfig config,
+                             const InitialConditions& conditions) {
+    config.particle_count = conditions.particle_count;
+    auto writer = BinaryParticleFileWriter::create(filename, config, Dim);
+    return writer &&
+           generate_chunks<Dim>(conditions, [&](Index first, std::span<const BasicParticle<Dim>> particles) {
+               return writer->write(first, particles);
+           }) &&
+           writer->close();
+}
+
+template <int Dim>
+bool write_text_conditions(std::string_view filename, SimulationConfig config,
+                           const InitialConditions& conditions) {
+    std::ofstream outfile{std::string(filename)};
+    if (!outfile) {
+        std::cerr << "Error: Could not create file: " << filename << "\n";
+        return false;
+    }
+
+    outfile << conditions.particle_count << "\n"
+            << config.start_time << "\n"
+            << config.end_time << "\n"
+            << config.time_step << "\n";
+
+    const bool written = generate_chunks<Dim>(conditions, [&](Index, std::span<const BasicParticle<Dim>> particles) {
+        for (const auto& particle : particles) {
+            outfile << particle.mass();
+            for (int k = 0; k < Dim; ++k) {
+                outfile << " " << particle.position()[k];
+            }
+            for (int k = 0; k < Dim; ++k) {
+                outfile << " " << particle.velocity()[k];
+            }
+            outfile << "\n";
+        }
+        return static_cast<bool>(outfile);
+    });
+
+    if (!written) {
+        std::cerr << "Error: Failed writing file: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool write_initial_conditions(std::string_view filename, const SimulationConfig& config,
+                              const InitialConditions& conditions, int dimension, bool text) {
+    if (text) {
+        return dimension == 2 ? write_text_conditions<2>(filename, config, conditions)
+                              : write_text_conditions<3>(filename, config, conditions);
+    }
+    return dimension == 2 ? write_binary_conditions<2>(filename, config, conditions)
+                          : write_binary_conditions<3>(filename, config, conditions);
+}
+
+} // namespace barnes_hut
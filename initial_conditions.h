@@ -0,0 +1,109 @@
+#pragma once
+
+#include "file.h"
+#include "particle.h"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace barnes_hut {
+
+// Philox4x32-10 counter-based random number generator (Salmon et al. 2011).
+// Each output block is a pure function of a 128-bit counter and a 64-bit
+// key: there is no state to advance, so any block can be computed directly
+// and in any order.
+class Philox4x32 {
+public:
+    using Counter = std::array<std::uint32_t, 4>;
+    using Key = std::array<std::uint32_t, 2>;
+
+    [[nodiscard]] static constexpr Counter generate(Counter counter, Key key) noexcept {
+        for (int round = 0; round < 10; ++round) {
+            const std::uint64_t product0 = std::uint64_t{0xD2511F53} * counter[0];
+            const std::uint64_t product1 = std::uint64_t{0xCD9E8D57} * counter[2];
+            counter = {static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                       static_cast<std::uint32_t>(product1),
+                       static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                       static_cast<std::uint32_t>(product0)};
+            key[0] += 0x9E3779B9;
+            key[1] += 0xBB67AE85;
+        }
+        return counter;
+    }
+};
+
+// Random numbers for one (seed, index, stream): the counter holds the index,
+// the stream and the number of blocks drawn, the key holds the seed. The
+// values drawn for a particle therefore do not depend on which thread draws
+// them, in what order, or how many threads there are.
+class CounterRandom {
+public:
+    CounterRandom(std::uint64_t seed, std::uint64_t index, std::uint32_t stream = 0) noexcept
+        : counter_{0, stream, static_cast<std::uint32_t>(index), static_cast<std::uint32_t>(index >> 32)}
+        , key_{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)} {}
+
+    // Uniform in [0, 1), 53 random bits
+    [[nodiscard]] double uniform() noexcept {
+        if (used_ == 4) {
+            block_ = Philox4x32::generate(counter_, key_);
+            ++counter_[0];
+            used_ = 0;
+        }
+        const std::uint64_t bits = (std::uint64_t{block_[used_]} << 32) | block_[used_ + 1];
+        used_ += 2;
+        return static_cast<double>(bits >> 11) * 0x1.0p-53;
+    }
+
+    // Uniform in (0, 1)
+    [[nodiscard]] double uniform_positive() noexcept { return 1.0 - uniform(); }
+
+    // Standard normal (Box-Muller)
+    [[nodiscard]] double normal() noexcept;
+
+private:
+    Philox4x32::Counter counter_;
+    Philox4x32::Key key_;
+    Philox4x32::Counter block_{};
+    int used_ = 4;
+};
+
+enum class InitialModel {
+    Uniform,          // The legacy test data: uniform masses, positions and velocities
+    Plummer,          // Plummer sphere in equilibrium
+    Hernquist,        // Hernquist sphere, Gaussian velocities from the Jeans dispersion
+    ExponentialDisk,  // Cold exponential disk on circular orbits
+    Clustered         // Soneira-Peebles hierarchical clustering, at rest
+};
+
+[[nodiscard]] std::string_view to_string(InitialModel model) noexcept;
+[[nodiscard]] std::optional<InitialModel> parse_initial_model(std::string_view name) noexcept;
+
+// What to generate. The physical models use G = 1, total_mass and
+// scale_length (Plummer/Hernquist radius a, disk scale length, radius of the
+// outermost cluster) and are centred on the origin; in 2D they are the x-y
+// projection (the disk lies in that plane).
+struct InitialConditions {
+    InitialModel model = InitialModel::Uniform;
+    Index particle_count = 1000;
+    std::uint64_t seed = 1;
+    Real total_mass = 1.0;
+    Real scale_length = 1.0;
+};
+
+// Particle index of a model: a function of (conditions, index) alone
+template <int Dim>
+[[nodiscard]] BasicParticle<Dim> generate_particle(const InitialConditions& conditions, Index index);
+
+// All particles of a model, generated in parallel
+template <int Dim>
+[[nodiscard]] std::vector<BasicParticle<Dim>> generate_particles(const InitialConditions& conditions);
+
+// Generate a model chunk by chunk straight into a binary particle file, or
+// a text file as read by read_particle_file if text (config.particle_count
+// is taken from conditions)
+bool write_initial_conditions(std::string_view filename, const SimulationConfig& config,
+                              const InitialConditions& conditions, int dimension, bool text = false);
+
+} // namespace barnes_hut
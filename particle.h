@@ -6,8 +6,9 @@
 
 namespace barnes_hut {
 
-// Forward declaration
-class TreeNode;
+// Forward declarations
+template <int Dim> class BasicParticle;
+template <int Dim, typename Softening> class BasicBarnesHutTree;
 
 // Modern enum class (type-safe)
 enum class NodeType : std::uint8_t {
@@ -17,94 +18,113 @@ enum class NodeType : std::uint8_t {
 };
 
 // Modern Node structure with smart pointers and proper initialization
-struct alignas(64) Node {  // Cache-line aligned for better performance
+template <int Dim>
+struct alignas(64) BasicNode {  // Cache-line aligned for better performance
+    using Vector = BasicVector<Dim>;
+    static constexpr int subcells = SUBCELLS<Dim>;
+
     Index index = 0;
     NodeType type = NodeType::Empty;
-    Vector3D geo_center{0.0};
+    Vector geo_center{0.0};
     Real size = 0.0;
-    Vector3D mass_center{0.0};
+    Real max_softening = 0.0;  // Largest particle softening length in the subtree
+    Vector mass_center{0.0};
     Real mass = 0.0;
-    std::vector<class Particle*> particle_list;  // For leaf nodes
+    Real open_radius_squared = 0.0;  // Monopole accepted at this squared distance from mass_center or more
+    std::vector<BasicParticle<Dim>*> particle_list;  // For leaf nodes
     Index particle_count = 0;
     Index level = 0;
-    std::array<std::unique_ptr<Node>, NSUB> children;  // Smart pointers!
-    Node* parent = nullptr;  // Non-owning pointer
+    std::array<BasicNode*, subcells> children{};  // Non-owning, nodes live in the tree's pool
+    BasicNode* parent = nullptr;  // Non-owning pointer
 
     // Rule of 5 - default move, delete copy
-    Node() = default;
-    ~Node() = default;
-    Node(const Node&) = delete;
-    Node& operator=(const Node&) = delete;
-    Node(Node&&) noexcept = default;
-    Node& operator=(Node&&) noexcept = default;
+    BasicNode() = default;
+    ~BasicNode() = default;
+    BasicNode(const BasicNode&) = delete;
+    BasicNode& operator=(const BasicNode&) = delete;
+    BasicNode(BasicNode&&) noexcept = default;
+    BasicNode& operator=(BasicNode&&) noexcept = default;
 
     void reset() noexcept {
         index = 0;
         type = NodeType::Empty;
-        geo_center = Vector3D{0.0};
+        geo_center = Vector{0.0};
         size = 0.0;
-        mass_center = Vector3D{0.0};
+        max_softening = 0.0;
+        mass_center = Vector{0.0};
         mass = 0.0;
+        open_radius_squared = 0.0;
         particle_list.clear();
         particle_count = 0;
         level = 0;
-        for (auto& child : children) {
-            child.reset();
-        }
+        children.fill(nullptr);
         parent = nullptr;
     }
 };
 
 // Modern Particle class with move semantics and const correctness
-class Particle {
+template <int Dim>
+class BasicParticle {
 public:
+    using Vector = BasicVector<Dim>;
+    using Node = BasicNode<Dim>;
+
     // Constructors
-    Particle() noexcept
+    BasicParticle() noexcept
         : mass_(1.0)
+        , softening_(0.0)
         , position_(0.0)
         , velocity_(0.0)
         , force_(0.0)
+        , potential_(0.0)
         , id_(0)
         , parent_(nullptr) {}
 
-    Particle(Real mass, Vector3D pos, Vector3D vel) noexcept
+    BasicParticle(Real mass, Vector pos, Vector vel) noexcept
         : mass_(mass)
+        , softening_(0.0)
         , position_(pos)
         , velocity_(vel)
         , force_(0.0)
+        , potential_(0.0)
         , id_(0)
         , parent_(nullptr) {}
 
     // Rule of 5 - explicit defaults
-    ~Particle() = default;
-    Particle(const Particle&) = default;
-    Particle& operator=(const Particle&) = default;
-    Particle(Particle&&) noexcept = default;
-    Particle& operator=(Particle&&) noexcept = default;
+    ~BasicParticle() = default;
+    BasicParticle(const BasicParticle&) = default;
+    BasicParticle& operator=(const BasicParticle&) = default;
+    BasicParticle(BasicParticle&&) noexcept = default;
+    BasicParticle& operator=(BasicParticle&&) noexcept = default;
 
     // Const-correct getters (return const ref for efficiency)
     [[nodiscard]] Real mass() const noexcept { return mass_; }
-    [[nodiscard]] const Vector3D& position() const noexcept { return position_; }
-    [[nodiscard]] const Vector3D& velocity() const noexcept { return velocity_; }
-    [[nodiscard]] const Vector3D& force() const noexcept { return force_; }
+    [[nodiscard]] Real softening() const noexcept { return softening_; }
+    [[nodiscard]] const Vector& position() const noexcept { return position_; }
+    [[nodiscard]] const Vector& velocity() const noexcept { return velocity_; }
+    [[nodiscard]] const Vector& force() const noexcept { return force_; }
+    [[nodiscard]] Real potential() const noexcept { return potential_; }
     [[nodiscard]] Index id() const noexcept { return id_; }
     [[nodiscard]] const Node* parent() const noexcept { return parent_; }
 
     // Non-const accessors for modification
-    [[nodiscard]] Vector3D& position() noexcept { return position_; }
-    [[nodiscard]] Vector3D& velocity() noexcept { return velocity_; }
-    [[nodiscard]] Vector3D& force() noexcept { return force_; }
+    [[nodiscard]] Vector& position() noexcept { return position_; }
+    [[nodiscard]] Vector& velocity() noexcept { return velocity_; }
+    [[nodiscard]] Vector& force() noexcept { return force_; }
+    [[nodiscard]] Real& potential() noexcept { return potential_; }
 
     // Setters
-    void set_position(const Vector3D& pos) noexcept { position_ = pos; }
-    void set_velocity(const Vector3D& vel) noexcept { velocity_ = vel; }
-    void set_force(const Vector3D& f) noexcept { force_ = f; }
+    void set_position(const Vector& pos) noexcept { position_ = pos; }
+    void set_velocity(const Vector& vel) noexcept { velocity_ = vel; }
+    void set_force(const Vector& f) noexcept { force_ = f; }
+    void set_potential(Real phi) noexcept { potential_ = phi; }
+    void set_softening(Real length) noexcept { softening_ = length; }
     void set_id(Index identity) noexcept { id_ = identity; }
     void set_parent(Node* p) noexcept { parent_ = p; }
 
     // Leapfrog integration for velocity and position
     void integrate(Real dt) noexcept {
-        const Vector3D acceleration = force_ / mass_;
+        const Vector acceleration = force_ / mass_;
 
         // Leapfrog integration (kick-drift-kick)
         velocity_ += acceleration * (0.5 * dt);
@@ -125,16 +145,27 @@ public:
 
 private:
     Real mass_;
-    Vector3D position_;
-    Vector3D velocity_;
-    Vector3D force_;
+    Real softening_;  // Per-particle softening length (fits in the padding before position_)
+    Vector position_;
+    Vector velocity_;
+    Vector force_;
+    Real potential_;  // Gravitational potential per unit mass
     Index id_;
     Node* parent_;  // Non-owning pointer
 
     // Friend declaration for tree access
-    friend class BarnesHutTree;
+    template <int, typename> friend class BasicBarnesHutTree;
 };
 
+using Node2D = BasicNode<2>;
+using Node3D = BasicNode<3>;
+using Particle2D = BasicParticle<2>;
+using Particle3D = BasicParticle<3>;
+
+// Default-dimension aliases
+using Node = BasicNode<NDIM>;
+using Particle = BasicParticle<NDIM>;
+
 // Type alias for backward compatibility
 using particlePtr = Particle*;
 
@@ -0,0 +1,40 @@
+#
+# Particle data source shared by the visualization scripts
+#
+# Text (default): test.dat, 4 configuration lines, then mass x y z vx vy vz
+# (mass x y vx vy for 2D data: gnuplot -e "dimension=2" <script>.gnu)
+# Binary: the same columns as raw records, described by the .gp file written
+# by `convert_particles <in> <out> --gnuplot` or
+# `barnes_hut_sim ... --snapshot-format gnuplot`, which sets the dimension:
+#   gnuplot -e "descriptor='test.bin.gp'" visualize_3d.gnu
+#
+# Scripts plot @data, which expands to the file name and its read options,
+# and read the columns through the expressions below, e.g.
+# `using (@pos_x):(@pos_y)`. In 2D, z and vz are 0.
+#
+
+if (exists("descriptor")) {
+    load descriptor
+    data = sprintf("'%s' binary format='%s' endian=%s", particle_file, binary_format, binary_endian)
+} else {
+    data = "'test.dat' skip 4"
+}
+
+if (!exists("dimension")) {
+    dimension = 3
+}
+
+mass = "column(1)"
+pos_x = "column(2)"
+pos_y = "column(3)"
+if (dimension == 2) {
+    pos_z = "0"
+    vel_x = "column(4)"
+    vel_y = "column(5)"
+    vel_z = "0"
+} else {
+    pos_z = "column(4)"
+    vel_x = "column(5)"
+    vel_y = "column(6)"
+    vel_z = "column(7)"
+}
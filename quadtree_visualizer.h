@@ -210,7 +210,7 @@ private:
         // Recursively draw children
         for (const auto& child : node->children) {
             if (child) {
-                draw_node_boxes(file, child.get(), bbox);
+                draw_node_boxes(file, child, bbox);
             }
         }
     }
@@ -316,7 +316,7 @@ private:
         // Recursively draw children mass centers
         for (const auto& child : node->children) {
             if (child) {
-                draw_mass_centers(file, child.get(), bbox);
+                draw_mass_centers(file, child, bbox);
             }
         }
     }
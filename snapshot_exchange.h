@@ -0,0 +1,122 @@
+#pragma once
+
+#include "particle.h"
+#include "solver.h"
+#include "stdinc.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace barnes_hut {
+
+// What a viewer needs of one simulation state, in single precision
+struct RenderSnapshot {
+    std::vector<float> positions;  // x, y, z per particle (z = 0 in 2D)
+    std::vector<float> speed;      // |v| per particle
+    std::vector<float> force;      // |F| per particle
+    Index step = 0;
+    Real time = 0.0;
+    SolverStatistics statistics;   // Of the step that produced the state
+
+    [[nodiscard]] Index size() const noexcept { return speed.size(); }
+
+    template <int Dim>
+    void assign(std::span<const BasicParticle<Dim>> particles) {
+        const Index n = particles.size();
+        positions.resize(3 * n);
+        speed.resize(n);
+        force.resize(n);
+        for (Index i = 0; i < n; ++i) {
+            const auto& particle = particles[i];
+            for (int dim = 0; dim < 3; ++dim) {
+                positions[3 * i + dim] = (dim < Dim) ? static_cast<float>(particle.position()[dim]) : 0.0f;
+            }
+            speed[i] = static_cast<float>(particle.velocity().magnitude());
+            force[i] = static_cast<float>(particle.force().magnitude());
+        }
+    }
+};
+
+// Hands the latest RenderSnapshot from one producer thread (the simulation)
+// to one consumer thread (the renderer) without locks or waiting on either
+// side. Of three buffers the producer owns one, the consumer one, and the
+// third is the latest published state. publish() swaps the producer's buffer
+// with the shared one, acquire() swaps the consumer's with it if it is newer,
+// so a state the consumer was too slow to pick up is overwritten, and a
+// consumer faster than the producer keeps its current buffer.
+//
+//   producer: exchange.write_buffer().assign(particles); exchange.publish();
+//   consumer: if (exchange.acquire()) draw(exchange.read_buffer());
+class SnapshotExchange {
+public:
+    SnapshotExchange() = default;
+
+    // Preallocates the buffers, so that publishing does not allocate
+    explicit SnapshotExchange(Index particle_count) {
+        for (auto& buffer : buffers_) {
+            buffer.positions.reserve(3 * particle_count);
+            buffer.speed.reserve(particle_count);
+            buffer.force.reserve(particle_count);
+        }
+    }
+
+    SnapshotExchange(const SnapshotExchange&) = delete;
+    SnapshotExchange& operator=(const SnapshotExchange&) = delete;
+
+    // Producer side
+    [[nodiscard]] RenderSnapshot& write_buffer() noexcept { return buffers_[write_]; }
+
+    void publish() noexcept {
+        // Release: the buffer's contents are visible to the acquire() that takes it
+        write_ = shared_.exchange(write_ | FRESH, std::memory_order_acq_rel) & INDEX;
+        published_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <int Dim>
+    void publish(std::span<const BasicParticle<Dim>> particles, Index step, Real time,
+                 const SolverStatistics& statistics) {
+        auto& buffer = write_buffer();
+        buffer.assign(particles);
+        buffer.step = step;
+        buffer.time = time;
+        buffer.statistics = statistics;
+        publish();
+    }
+
+    // Consumer side: true if read_buffer() changed to a newer state
+    [[nodiscard]] bool acquire() noexcept {
+        if (!has_new()) {
+            return false;
+        }
+        read_ = shared_.exchange(read_, std::memory_order_acq_rel) & INDEX;
+        ++acquired_;
+        return true;
+    }
+
+    [[nodiscard]] bool has_new() const noexcept {
+        return (shared_.load(std::memory_order_relaxed) & FRESH) != 0;
+    }
+
+    // The latest acquired state (empty before the first acquire())
+    [[nodiscard]] const RenderSnapshot& read_buffer() const noexcept { return buffers_[read_]; }
+
+    // States published, and taken by the consumer; the difference were never shown
+    [[nodiscard]] Index published() const noexcept { return published_.load(std::memory_order_relaxed); }
+    [[nodiscard]] Index acquired() const noexcept { return acquired_; }
+
+private:
+    static constexpr std::uint8_t INDEX = 0x3;
+    static constexpr std::uint8_t FRESH = 0x4;  // Shared buffer not yet acquired
+
+    std::array<RenderSnapshot, 3> buffers_;
+    // Each on its own cache line: the two threads write them concurrently
+    alignas(64) std::atomic<std::uint8_t> shared_{1};
+    alignas(64) std::uint8_t write_ = 0;  // Producer only
+    std::atomic<Index> published_{0};
+    alignas(64) std::uint8_t read_ = 2;   // Consumer only
+    Index acquired_ = 0;
+};
+
+} // namespace barnes_hut
@@ -0,0 +1,492 @@
+#include "snapshot_stream.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+namespace {
+
+constexpr char STREAM_MAGIC[4] = {'B', 'H', 'S', 'S'};
+constexpr char FRAME_MAGIC[4] = {'F', 'R', 'M', 'E'};
+
+struct StreamHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t dimension;
+    std::uint32_t predictor;
+    std::uint64_t particle_count;
+    std::uint64_t keyframe_interval;
+    double quantum;
+};
+
+struct FrameHeader {
+    char magic[4];
+    std::uint32_t keyframe;
+    std::uint64_t number;
+    double time;
+    std::uint64_t payload_size;
+};
+
+// Values per bit-packed block
+constexpr std::size_t BLOCK_VALUES = 128;
+
+// Largest |position / quantum| that survives rounding to an integer exactly
+constexpr Real MAX_SCALED_POSITION = 4503599627370496.0;  // 2^52
+
+constexpr std::uint64_t zigzag(std::int64_t value) noexcept {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+constexpr std::int64_t unzigzag(std::uint64_t value) noexcept {
+    return static_cast<std::int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// Predicted quantised position; unsigned arithmetic wraps instead of overflowing
+constexpr std::uint64_t predict(std::int64_t previous, std::int64_t before_previous, bool linear) noexcept {
+    const auto p = static_cast<std::uint64_t>(previous);
+    return linear ? 2 * p - static_cast<std::uint64_t>(before_previous) : p;
+}
+
+constexpr std::size_t packed_size(std::size_t count, int width) noexcept {
+    return 1 + (count * static_cast<std::size_t>(width) + 7) / 8;
+}
+
+// Block: one width byte, then count values of width bits, least significant first
+void pack_block(const std::uint64_t* values, std::size_t count, int width, std::byte* out) {
+    *out++ = static_cast<std::byte>(width);
+
+    std::uint64_t bits = 0;
+    int filled = 0;
+    auto put = [&](std::uint64_t value, int value_width) {  // value_width <= 32
+        bits |= value << filled;
+        filled += value_width;
+        while (filled >= 8) {
+            *out++ = static_cast<std::byte>(bits & 0xff);
+            bits >>= 8;
+            filled -= 8;
+        }
+    };
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (width <= 32) {
+            put(values[i], width);
+        }
+        else {
+            put(values[i] & 0xffffffff, 32);
+            put(values[i] >> 32, width - 32);
+        }
+    }
+    if (filled > 0) {
+        *out = static_cast<std::byte>(bits);
+    }
+}
+
+void unpack_block(const std::byte* in, std::size_t count, int width, std::uint64_t* values) {
+    std::uint64_t bits = 0;
+    int filled = 0;
+    auto get = [&](int value_width) {  // value_width <= 32
+        while (filled < value_width) {
+            bits |= static_cast<std::uint64_t>(*in++) << filled;
+            filled += 8;
+        }
+        const std::uint64_t value = bits & ((std::uint64_t{1} << value_width) - 1);
+        bits >>= value_width;
+        filled -= value_width;
+        return value;
+    };
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (width <= 32) {
+            values[i] = get(width);
+        }
+        else {
+            const std::uint64_t low = get(32);
+            values[i] = low | (get(width - 32) << 32);
+        }
+    }
+}
+
+// Bit-pack values into payload, all blocks in parallel
+void encode_values(std::span<const std::uint64_t> values, std::vector<std::byte>& payload) {
+    const std::size_t blocks = (values.size() + BLOCK_VALUES - 1) / BLOCK_VALUES;
+    std::vector<int> widths(blocks);
+    std::vector<std::size_t> offsets(blocks + 1, 0);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (std::size_t b = 0; b < blocks; ++b) {
+        const std::size_t begin = b * BLOCK_VALUES;
+        const std::size_t end = std::min(begin + BLOCK_VALUES, values.size());
+        std::uint64_t combined = 0;
+        for (std::size_t i = begin; i < end; ++i) {
+            combined |= values[i];
+        }
+        widths[b] = std::bit_width(combined);
+    }
+
+    for (std::size_t b = 0; b < blocks; ++b) {
+        const std::size_t count = std::min(BLOCK_VALUES, values.size() - b * BLOCK_VALUES);
+        offsets[b + 1] = offsets[b] + packed_size(count, widths[b]);
+    }
+    payload.resize(offsets[blocks]);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (std::size_t b = 0; b < blocks; ++b) {
+        const std::size_t begin = b * BLOCK_VALUES;
+        const std::size_t count = std::min(BLOCK_VALUES, values.size() - begin);
+        pack_block(values.data() + begin, count, widths[b], payload.data() + offsets[b]);
+    }
+}
+
+// Inverse of encode_values; false if the payload does not hold values.size() values
+bool decode_values(std::span<const std::byte> payload, std::span<std::uint64_t> values) {
+    const std::size_t blocks = (values.size() + BLOCK_VALUES - 1) / BLOCK_VALUES;
+    std::vector<std::size_t> offsets(blocks);
+
+    std::size_t offset = 0;
+    for (std::size_t b = 0; b < blocks; ++b) {
+        const std::size_t count = std::min(BLOCK_VALUES, values.size() - b * BLOCK_VALUES);
+        if (offset >= payload.size() || std::to_integer<int>(payload[offset]) > 64) {
+            return false;
+        }
+        offsets[b] = offset;
+        offset += packed_size(count, std::to_integer<int>(payload[offset]));
+    }
+    if (offset != payload.size()) {
+        return false;
+    }
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (std::size_t b = 0; b < blocks; ++b) {
+        const std::size_t begin = b * BLOCK_VALUES;
+        const std::size_t count = std::min(BLOCK_VALUES, values.size() - begin);
+        const std::byte* block = payload.data() + offsets[b];
+        unpack_block(block + 1, count, std::to_integer<int>(*block), values.data() + begin);
+    }
+    return true;
+}
+
+} // namespace
+
+template <int Dim>
+std::optional<SnapshotStreamWriter<Dim>> SnapshotStreamWriter<Dim>::create(
+    std::string_view filename, Index particle_count, const SnapshotStreamOptions& options) {
+    if (!(options.quantum > 0.0) || options.keyframe_interval == 0 || particle_count == 0) {
+        std::cerr << "Error: Invalid snapshot stream options\n";
+        return std::nullopt;
+    }
+
+    SnapshotStreamWriter writer;
+    writer.filename_ = std::string(filename);
+    writer.file_.open(writer.filename_, std::ios::binary | std::ios::trunc);
+    if (!writer.file_) {
+        std::cerr << "Error: Could not create snapshot stream: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    StreamHeader header{};
+    std::copy(std::begin(STREAM_MAGIC), std::end(STREAM_MAGIC), header.magic);
+    header.version = SnapshotStream::FORMAT_VERSION;
+    header.dimension = Dim;
+    header.predictor = static_cast<std::uint32_t>(options.predictor);
+    header.particle_count = particle_count;
+    header.keyframe_interval = options.keyframe_interval;
+    header.quantum = options.quantum;
+    writer.file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    writer.particle_count_ = particle_count;
+    writer.options_ = options;
+    writer.bytes_written_ = sizeof(header);
+    writer.previous_.resize(Dim * particle_count);
+    writer.before_previous_.resize(Dim * particle_count);
+    writer.current_.resize(Dim * particle_count);
+    return writer;
+}
+
+template <int Dim>
+std::optional<SnapshotStreamWriter<Dim>> SnapshotStreamWriter<Dim>::resume(
+    std::string_view filename, Index particle_count, const SnapshotStreamOptions& options, Real time) {
+    std::error_code error;
+    if (!std::filesystem::exists(filename, error)) {
+        return create(filename, particle_count, options);
+    }
+
+    SnapshotStreamWriter writer;
+    writer.filename_ = std::string(filename);
+    std::uint64_t end = 0;
+    {
+        const auto stream = SnapshotStream::open(filename);
+        if (!stream) {
+            std::cerr << "Error: Not overwriting " << filename << " with a new snapshot stream\n";
+            return std::nullopt;
+        }
+        if (stream->dimension() != Dim || stream->particle_count() != particle_count) {
+            std::cerr << "Error: " << filename << " holds " << stream->particle_count() << " " << stream->dimension()
+                      << "D positions, not " << particle_count << " " << Dim << "D; not overwriting it\n";
+            return std::nullopt;
+        }
+
+        Index kept = 0;
+        while (kept < stream->frame_count() && stream->frame_time(kept) <= time) {
+            ++kept;
+        }
+        if (kept == 0) {
+            std::cerr << "Error: " << filename << " has no frame at or before time " << time
+                      << "; not overwriting it\n";
+            return std::nullopt;
+        }
+
+        writer.particle_count_ = particle_count;
+        writer.options_ = stream->options();
+        writer.previous_.resize(Dim * particle_count);
+        writer.before_previous_.resize(Dim * particle_count);
+        writer.current_.resize(Dim * particle_count);
+        if (!stream->replay(kept - 1, writer.previous_, writer.before_previous_, writer.history_)) {
+            return std::nullopt;
+        }
+        writer.frame_count_ = kept;
+        end = stream->frames_[kept - 1].offset + stream->frames_[kept - 1].size;
+    }  // Unmapped before the file is cut
+
+    if (options.quantum != writer.options_.quantum || options.keyframe_interval != writer.options_.keyframe_interval ||
+        options.predictor != writer.options_.predictor) {
+        std::cerr << "Warning: Continuing " << filename << " with its own quantum, keyframe interval and predictor\n";
+    }
+
+    std::filesystem::resize_file(writer.filename_, end, error);
+    if (!error) {
+        writer.file_.open(writer.filename_, std::ios::binary | std::ios::app);
+    }
+    if (error || !writer.file_) {
+        std::cerr << "Error: Could not continue snapshot stream: " << filename << "\n";
+        return std::nullopt;
+    }
+    writer.bytes_written_ = end;
+    return writer;
+}
+
+template <int Dim>
+bool SnapshotStreamWriter<Dim>::write_frame(std::span<const Particle> particles, Real time) {
+    if (particles.size() != particle_count_) {
+        std::cerr << "Error: Snapshot stream holds " << particle_count_ << " particles, got "
+                  << particles.size() << "\n";
+        return false;
+    }
+
+    const Index n = particle_count_;
+    const bool keyframe = (frame_count_ % options_.keyframe_interval == 0);
+    const bool linear = !keyframe && options_.predictor == StreamPredictor::Linear && history_ >= 2;
+    const Real quantum = options_.quantum;
+
+    // Quantise and subtract the prediction (column-major: all x, then all y, ...)
+    values_.resize(Dim * n);
+    bool in_range = true;
+
+    #ifdef _OPENMP
+    #pragma omp parallel for reduction(&& : in_range)
+    #endif
+    for (Index i = 0; i < n; ++i) {
+        for (int k = 0; k < Dim; ++k) {
+            const Real scaled = particles[i].position()[k] / quantum;
+            if (!(std::abs(scaled) < MAX_SCALED_POSITION)) {
+                in_range = false;
+                continue;
+            }
+            const std::size_t j = k * n + i;
+            current_[j] = std::llround(scaled);
+            const std::uint64_t prediction = keyframe ? 0 : predict(previous_[j], before_previous_[j], linear);
+            values_[j] = zigzag(static_cast<std::int64_t>(static_cast<std::uint64_t>(current_[j]) - prediction));
+        }
+    }
+
+    if (!in_range) {
+        std::cerr << "Error: Position out of range for snapshot stream quantum " << quantum << "\n";
+        return false;
+    }
+
+    encode_values(values_, payload_);
+
+    FrameHeader header{};
+    std::copy(std::begin(FRAME_MAGIC), std::end(FRAME_MAGIC), header.magic);
+    header.keyframe = keyframe ? 1 : 0;
+    header.number = frame_count_;
+    header.time = time;
+    header.payload_size = payload_.size();
+
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_.write(reinterpret_cast<const char*>(payload_.data()), static_cast<std::streamsize>(payload_.size()));
+    file_.flush();  // Complete frames reach the file even if the run dies
+    if (!file_) {
+        std::cerr << "Error: Failed to write snapshot stream: " << filename_ << "\n";
+        return false;
+    }
+
+    // The decoded frame is exactly current_: it becomes the prediction history
+    std::swap(before_previous_, previous_);
+    std::swap(previous_, current_);
+    history_ = keyframe ? 1 : std::min<Index>(history_ + 1, 2);
+
+    ++frame_count_;
+    bytes_written_ += sizeof(header) + payload_.size();
+    return true;
+}
+
+template class SnapshotStreamWriter<2>;
+template class SnapshotStreamWriter<3>;
+
+bool is_snapshot_stream(std::string_view filename) {
+    std::ifstream infile(std::string(filename), std::ios::binary);
+    char magic[4] = {};
+    return infile.read(magic, sizeof(magic)) &&
+           std::equal(std::begin(STREAM_MAGIC), std::end(STREAM_MAGIC), magic);
+}
+
+std::optional<SnapshotStream> SnapshotStream::open(std::string_view filename) {
+    auto mapping = MappedFile::open(filename);
+    if (!mapping) {
+        return std::nullopt;
+    }
+
+    StreamHeader header{};
+    if (mapping->size() < sizeof(header)) {
+        std::cerr << "Error: Truncated snapshot stream: " << filename << "\n";
+        return std::nullopt;
+    }
+    std::memcpy(&header, mapping->data(), sizeof(header));
+
+    if (!std::equal(std::begin(STREAM_MAGIC), std::end(STREAM_MAGIC), header.magic)) {
+        std::cerr << "Error: Not a snapshot stream: " << filename << "\n";
+        return std::nullopt;
+    }
+    if (header.version != FORMAT_VERSION || (header.dimension != 2 && header.dimension != 3) ||
+        header.predictor > static_cast<std::uint32_t>(StreamPredictor::Linear) ||
+        header.particle_count == 0 || header.keyframe_interval == 0 || !(header.quantum > 0.0)) {
+        std::cerr << "Error: Unsupported snapshot stream version or invalid header: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    SnapshotStream stream;
+    stream.dimension_ = static_cast<int>(header.dimension);
+    stream.particle_count_ = header.particle_count;
+    stream.options_.quantum = header.quantum;
+    stream.options_.keyframe_interval = header.keyframe_interval;
+    stream.options_.predictor = static_cast<StreamPredictor>(header.predictor);
+
+    // Index the frames; stop at the first incomplete one
+    std::uint64_t offset = sizeof(header);
+    while (offset < mapping->size()) {
+        FrameHeader frame{};
+        if (mapping->size() - offset < sizeof(frame)) {
+            std::cerr << "Warning: Ignoring incomplete frame at the end of " << filename << "\n";
+            break;
+        }
+        std::memcpy(&frame, mapping->data() + offset, sizeof(frame));
+        offset += sizeof(frame);
+
+        if (!std::equal(std::begin(FRAME_MAGIC), std::end(FRAME_MAGIC), frame.magic) ||
+            frame.number != stream.frames_.size() || (stream.frames_.empty() && !frame.keyframe)) {
+            std::cerr << "Error: Corrupt frame " << stream.frames_.size() << " in " << filename << "\n";
+            return std::nullopt;
+        }
+        if (mapping->size() - offset < frame.payload_size) {
+            std::cerr << "Warning: Ignoring incomplete frame at the end of " << filename << "\n";
+            break;
+        }
+
+        stream.frames_.push_back({offset, frame.payload_size, frame.time, frame.keyframe != 0});
+        offset += frame.payload_size;
+    }
+
+    stream.mapping_ = std::move(*mapping);
+    return stream;
+}
+
+template <int Dim>
+std::optional<std::vector<BasicVector<Dim>>> SnapshotStream::read_positions(Index frame) const {
+    if (Dim != dimension_) {
+        std::cerr << "Error: Snapshot stream holds " << dimension_ << "D positions, " << Dim << "D requested\n";
+        return std::nullopt;
+    }
+    if (frame >= frames_.size()) {
+        std::cerr << "Error: Frame " << frame << " out of range (" << frames_.size() << " frames)\n";
+        return std::nullopt;
+    }
+
+    const Index n = particle_count_;
+    std::vector<std::int64_t> previous(Dim * n), before_previous(Dim * n);
+    Index history = 0;
+    if (!replay(frame, previous, before_previous, history)) {
+        return std::nullopt;
+    }
+
+    std::vector<BasicVector<Dim>> positions(n);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (Index i = 0; i < n; ++i) {
+        for (int k = 0; k < Dim; ++k) {
+            positions[i][k] = static_cast<Real>(previous[k * n + i]) * options_.quantum;
+        }
+    }
+
+    return positions;
+}
+
+bool SnapshotStream::replay(Index frame, std::vector<std::int64_t>& previous,
+                            std::vector<std::int64_t>& before_previous, Index& history) const {
+    Index keyframe = frame;
+    while (!frames_[keyframe].keyframe) {
+        --keyframe;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(dimension_) * particle_count_;
+    std::vector<std::uint64_t> values(size);
+    std::vector<std::int64_t> current(size);
+    previous.resize(size);
+    before_previous.resize(size);
+    history = 0;
+
+    // Replay the frames from the keyframe exactly as the writer predicted them
+    for (Index f = keyframe; f <= frame; ++f) {
+        const std::span<const std::byte> payload(mapping_.data() + frames_[f].offset, frames_[f].size);
+        if (!decode_values(payload, values)) {
+            std::cerr << "Error: Corrupt payload in frame " << f << "\n";
+            return false;
+        }
+
+        const bool is_keyframe = (f == keyframe);
+        const bool linear = !is_keyframe && options_.predictor == StreamPredictor::Linear && history >= 2;
+
+        #ifdef _OPENMP
+        #pragma omp parallel for
+        #endif
+        for (std::size_t j = 0; j < values.size(); ++j) {
+            const std::uint64_t prediction = is_keyframe ? 0 : predict(previous[j], before_previous[j], linear);
+            current[j] = static_cast<std::int64_t>(prediction + static_cast<std::uint64_t>(unzigzag(values[j])));
+        }
+
+        std::swap(before_previous, previous);
+        std::swap(previous, current);
+        history = is_keyframe ? 1 : std::min<Index>(history + 1, 2);
+    }
+    return true;
+}
+
+template std::optional<std::vector<Vector2D>> SnapshotStream::read_positions<2>(Index) const;
+template std::optional<std::vector<Vector3D>> SnapshotStream::read_positions<3>(Index) const;
+
+} // namespace barnes_hut
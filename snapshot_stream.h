@@ -0,0 +1,133 @@
+#pragma once
+
+#include "binary_file.h"
+#include "particle.h"
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace barnes_hut {
+
+// How delta frames predict each position from the frames before it
+enum class StreamPredictor : std::uint32_t {
+    Previous = 0,  // The previous frame
+    Linear = 1     // Constant velocity from the previous two frames
+};
+
+struct SnapshotStreamOptions {
+    Real quantum = 1e-6;           // Position grid spacing; error <= quantum / 2
+    Index keyframe_interval = 32;  // Frames per keyframe (seek granularity)
+    StreamPredictor predictor = StreamPredictor::Linear;
+};
+
+// Position snapshot stream: one file holding a time series of positions.
+//
+// Layout:
+//   header       magic "BHSS", version, dimension, particle count, options
+//   frames       frame header (magic, type, number, time, payload size), payload
+//
+// Positions are rounded to integer multiples of the quantum. A keyframe stores
+// these integers, a delta frame their difference from the predicted position;
+// prediction uses the decoded frames, so errors never accumulate. Values are
+// zigzag-coded and bit-packed column by column in blocks of 128, each block
+// with the bit width of its largest value: small residuals take few bits.
+// Every keyframe_interval-th frame is a keyframe, so any frame decodes from
+// the keyframe before it. Frames are self-delimiting: a stream cut short by a
+// crash stays readable up to its last complete frame.
+template <int Dim>
+class SnapshotStreamWriter {
+public:
+    using Particle = BasicParticle<Dim>;
+
+    // Create (truncate) filename for particle_count particles
+    [[nodiscard]] static std::optional<SnapshotStreamWriter>
+    create(std::string_view filename, Index particle_count, const SnapshotStreamOptions& options);
+
+    // Continue filename for a run resumed at time: frames after time (written
+    // after the checkpoint) are cut off and new frames follow the last one at
+    // or before it, with the stream's own quantum, keyframes and predictor.
+    // Creates the stream if filename does not exist; a file that is not a
+    // stream of particle_count Dim-D positions is left alone (std::nullopt).
+    [[nodiscard]] static std::optional<SnapshotStreamWriter>
+    resume(std::string_view filename, Index particle_count, const SnapshotStreamOptions& options, Real time);
+
+    // Append a frame of the particle positions
+    bool write_frame(std::span<const Particle> particles, Real time);
+
+    [[nodiscard]] Index frame_count() const noexcept { return frame_count_; }
+    [[nodiscard]] std::uint64_t bytes_written() const noexcept { return bytes_written_; }
+
+private:
+    SnapshotStreamWriter() = default;
+
+    std::ofstream file_;
+    std::string filename_;
+    Index particle_count_ = 0;
+    SnapshotStreamOptions options_;
+    Index frame_count_ = 0;
+    std::uint64_t bytes_written_ = 0;
+
+    // Quantised positions of the last two frames and the one being written
+    // (column-major); the decoder reconstructs exactly these
+    std::vector<std::int64_t> previous_;
+    std::vector<std::int64_t> before_previous_;
+    std::vector<std::int64_t> current_;
+    Index history_ = 0;  // Frames in the history since the last keyframe
+
+    std::vector<std::uint64_t> values_;  // Zigzag-coded frame being written
+    std::vector<std::byte> payload_;
+};
+
+extern template class SnapshotStreamWriter<2>;
+extern template class SnapshotStreamWriter<3>;
+
+// Check whether filename starts with the snapshot stream magic
+[[nodiscard]] bool is_snapshot_stream(std::string_view filename);
+
+class SnapshotStream {
+public:
+    static constexpr std::uint32_t FORMAT_VERSION = 1;
+
+    // Map filename and index its frames
+    [[nodiscard]] static std::optional<SnapshotStream> open(std::string_view filename);
+
+    [[nodiscard]] int dimension() const noexcept { return dimension_; }
+    [[nodiscard]] Index particle_count() const noexcept { return particle_count_; }
+    [[nodiscard]] const SnapshotStreamOptions& options() const noexcept { return options_; }
+    [[nodiscard]] Index frame_count() const noexcept { return frames_.size(); }
+    [[nodiscard]] Real frame_time(Index frame) const noexcept { return frames_[frame].time; }
+
+    // Decode the positions of a frame (from the keyframe before it)
+    template <int Dim>
+    [[nodiscard]] std::optional<std::vector<BasicVector<Dim>>> read_positions(Index frame) const;
+
+private:
+    template <int> friend class SnapshotStreamWriter;
+
+    SnapshotStream() = default;
+
+    // Decode the keyframe run up to frame: its quantised positions (previous),
+    // those of the frame before it in the run (before_previous), and how many
+    // of the two the run has (history), as the writer held them
+    bool replay(Index frame, std::vector<std::int64_t>& previous, std::vector<std::int64_t>& before_previous,
+                Index& history) const;
+
+    struct Frame {
+        std::uint64_t offset;  // Of the payload
+        std::uint64_t size;
+        Real time;
+        bool keyframe;
+    };
+
+    MappedFile mapping_;
+    int dimension_ = NDIM;
+    Index particle_count_ = 0;
+    SnapshotStreamOptions options_;
+    std::vector<Frame> frames_;
+};
+
+} // namespace barnes_hut
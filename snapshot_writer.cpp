@@ -0,0 +1,186 @@
+#include "snapshot_writer.h"
+#include "file.h"
+#include "vtk_writer.h"
+#include <algorithm>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace barnes_hut {
+
+template <int Dim>
+AsyncSnapshotWriter<Dim>::AsyncSnapshotWriter(std::size_t max_pending, int threads)
+    : max_pending_(std::max<std::size_t>(max_pending, 1))
+    , threads_(std::max(threads, 1))
+    , thread_(&AsyncSnapshotWriter::run, this) {
+}
+
+template <int Dim>
+AsyncSnapshotWriter<Dim>::~AsyncSnapshotWriter() {
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    queue_changed_.notify_all();
+    thread_.join();
+}
+
+template <int Dim>
+typename AsyncSnapshotWriter<Dim>::Snapshot AsyncSnapshotWriter<Dim>::acquire() {
+    Snapshot snapshot;
+    std::unique_lock lock(mutex_);
+    if (queue_.size() >= max_pending_) {
+        Timer stall_timer;
+        queue_changed_.wait(lock, [this] { return queue_.size() < max_pending_; });
+        stall_seconds_ += stall_timer.elapsed();
+    }
+    if (!free_forces_.empty()) {
+        snapshot.forces = std::move(free_forces_.back());
+        free_forces_.pop_back();
+    }
+    if (!free_particles_.empty()) {
+        snapshot.particles = std::move(free_particles_.back());
+        free_particles_.pop_back();
+    }
+    return snapshot;
+}
+
+template <int Dim>
+void AsyncSnapshotWriter<Dim>::enqueue(Snapshot snapshot) {
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(std::move(snapshot));
+    }
+    queue_changed_.notify_all();
+}
+
+template <int Dim>
+void AsyncSnapshotWriter<Dim>::submit_forces(std::span<const Particle> particles, std::string message,
+                                             Real theta, Index particles_per_leaf, Index number) {
+    Snapshot snapshot = acquire();
+
+    // The only work on the simulation thread: copy the forces out
+    snapshot.forces.resize(particles.size());
+    #ifdef _OPENMP
+    #pragma omp parallel for
+    #endif
+    for (Index i = 0; i < particles.size(); ++i) {
+        snapshot.forces[i] = particles[i].force();
+    }
+    snapshot.message = std::move(message);
+    snapshot.theta = theta;
+    snapshot.particles_per_leaf = particles_per_leaf;
+    snapshot.number = number;
+
+    enqueue(std::move(snapshot));
+}
+
+template <int Dim>
+void AsyncSnapshotWriter<Dim>::submit_columns(std::span<const Particle> particles, std::string filename,
+                                              std::string message, Real time,
+                                              const ColumnSnapshotOptions& options) {
+    Snapshot snapshot = acquire();
+
+    snapshot.kind = Kind::Columns;
+    snapshot.particles.assign(particles.begin(), particles.end());
+    snapshot.filename = std::move(filename);
+    snapshot.message = std::move(message);
+    snapshot.time = time;
+    snapshot.options = options;
+
+    enqueue(std::move(snapshot));
+}
+
+template <int Dim>
+void AsyncSnapshotWriter<Dim>::submit_gnuplot(std::span<const Particle> particles, std::string filename,
+                                              bool single_precision) {
+    Snapshot snapshot = acquire();
+
+    snapshot.kind = Kind::Gnuplot;
+    snapshot.particles.assign(particles.begin(), particles.end());
+    snapshot.filename = std::move(filename);
+    snapshot.single_precision = single_precision;
+
+    enqueue(std::move(snapshot));
+}
+
+template <int Dim>
+void AsyncSnapshotWriter<Dim>::submit_vtu(std::span<const Particle> particles, std::string filename,
+                                          std::function<void()> on_written) {
+    Snapshot snapshot = acquire();
+
+    snapshot.kind = Kind::Vtu;
+    snapshot.particles.assign(particles.begin(), particles.end());
+    snapshot.filename = std::move(filename);
+    snapshot.on_written = std::move(on_written);
+
+    enqueue(std::move(snapshot));
+}
+
+template <int Dim>
+bool AsyncSnapshotWriter<Dim>::flush() {
+    std::unique_lock lock(mutex_);
+    queue_changed_.wait(lock, [this] { return queue_.empty() && !writing_; });
+    return !std::exchange(failed_, false);
+}
+
+template <int Dim>
+void AsyncSnapshotWriter<Dim>::run() {
+    // The thread count is per thread: this caps the formatters' parallel
+    // regions here, not those of the simulation
+    #ifdef _OPENMP
+    omp_set_num_threads(threads_);
+    #endif
+
+    std::unique_lock lock(mutex_);
+    while (true) {
+        queue_changed_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;  // Stopped with nothing left to write
+        }
+
+        Snapshot snapshot = std::move(queue_.front());
+        queue_.pop_front();
+        writing_ = true;
+        lock.unlock();
+        queue_changed_.notify_all();  // A queue slot is free
+
+        const std::span<const Particle> particles(snapshot.particles);
+        bool written = false;
+        switch (snapshot.kind) {
+            case Kind::Forces:
+                written = write_force_snapshot(std::span<const Vector>(snapshot.forces), snapshot.message,
+                                               snapshot.theta, snapshot.particles_per_leaf, snapshot.number);
+                break;
+            case Kind::Columns:
+                written = write_column_snapshot(snapshot.filename, particles, snapshot.message,
+                                                snapshot.time, snapshot.options);
+                break;
+            case Kind::Gnuplot:
+                written = write_gnuplot_binary(snapshot.filename, particles, snapshot.single_precision);
+                break;
+            case Kind::Vtu:
+                written = write_vtu_particles(snapshot.filename, particles);
+                break;
+        }
+        if (written && snapshot.on_written) {
+            snapshot.on_written();
+        }
+
+        lock.lock();
+        writing_ = false;
+        failed_ = failed_ || !written;
+        free_forces_.push_back(std::move(snapshot.forces));
+        free_particles_.push_back(std::move(snapshot.particles));
+        lock.unlock();
+        queue_changed_.notify_all();
+        lock.lock();
+    }
+}
+
+template class AsyncSnapshotWriter<2>;
+template class AsyncSnapshotWriter<3>;
+
+} // namespace barnes_hut
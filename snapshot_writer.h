@@ -0,0 +1,119 @@
+#pragma once
+
+#include "column_snapshot.h"
+#include "particle.h"
+#include "vektor.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace barnes_hut {
+
+// Writes snapshots on a background thread.
+//
+// submit_forces() copies the particle forces into a recycled buffer and
+// queues it; the writer thread formats and writes the file (the same file
+// write_particle_forces would produce) while the simulation continues.
+// submit_columns(), submit_gnuplot() and submit_vtu() do the same with a
+// copy of the particles for a columnar snapshot (column_snapshot.h), gnuplot
+// binary records (write_gnuplot_binary) or a VTK file (vtk_writer.h).
+// At most max_pending snapshots are queued: a further submit blocks until
+// the writer catches up, so memory stays bounded when the disk is slower
+// than the simulation.
+//
+// Thread budget: the simulation thread plus the writer thread, whose
+// formatters and encoders run OpenMP teams of at most `threads` threads
+// (default 1, i.e. serially). A full team on the writer would compete with
+// the force computation for every core and slow the step the background
+// write is meant to overlap.
+template <int Dim>
+class AsyncSnapshotWriter {
+public:
+    using Vector = BasicVector<Dim>;
+    using Particle = BasicParticle<Dim>;
+
+    explicit AsyncSnapshotWriter(std::size_t max_pending = 2, int threads = 1);
+    ~AsyncSnapshotWriter();
+
+    AsyncSnapshotWriter(const AsyncSnapshotWriter&) = delete;
+    AsyncSnapshotWriter& operator=(const AsyncSnapshotWriter&) = delete;
+
+    // Queue force snapshot number; blocks while max_pending snapshots are queued
+    void submit_forces(std::span<const Particle> particles, std::string message,
+                       Real theta, Index particles_per_leaf, Index number);
+
+    // Queue a columnar snapshot of the selected fields
+    void submit_columns(std::span<const Particle> particles, std::string filename, std::string message,
+                        Real time, const ColumnSnapshotOptions& options);
+
+    // Queue gnuplot binary records of the particles
+    void submit_gnuplot(std::span<const Particle> particles, std::string filename, bool single_precision);
+
+    // Queue a VTK unstructured grid of the particles. on_written runs on the
+    // writer thread once the file is complete (not if the write fails), and
+    // before flush() returns; e.g. to list the file in a .pvd index
+    void submit_vtu(std::span<const Particle> particles, std::string filename,
+                    std::function<void()> on_written = {});
+
+    // Wait until every queued snapshot is written; false if any write failed
+    bool flush();
+
+    // Time the submit calls spent waiting for a free queue slot
+    [[nodiscard]] double stall_seconds() const noexcept { return stall_seconds_; }
+
+private:
+    enum class Kind {
+        Forces,
+        Columns,
+        Gnuplot,
+        Vtu
+    };
+
+    struct Snapshot {
+        Kind kind = Kind::Forces;
+        std::vector<Vector> forces;       // Text force snapshot
+        std::vector<Particle> particles;  // Columnar, gnuplot and VTK snapshots
+        std::string filename;
+        std::string message;
+        Real theta = 0.0;
+        Index particles_per_leaf = 0;
+        Index number = 0;
+        Real time = 0.0;
+        ColumnSnapshotOptions options;
+        bool single_precision = false;
+        std::function<void()> on_written;
+    };
+
+    // Wait for a free queue slot and take recycled buffers
+    [[nodiscard]] Snapshot acquire();
+    void enqueue(Snapshot snapshot);
+    void run();
+
+    const std::size_t max_pending_;
+    const int threads_;  // OpenMP threads of the writer thread's parallel regions
+
+    std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::deque<Snapshot> queue_;
+    std::vector<std::vector<Vector>> free_forces_;
+    std::vector<std::vector<Particle>> free_particles_;
+    bool writing_ = false;
+    bool stop_ = false;
+    bool failed_ = false;
+
+    double stall_seconds_ = 0.0;
+
+    std::thread thread_;  // Last, so it starts after the members it uses
+};
+
+extern template class AsyncSnapshotWriter<2>;
+extern template class AsyncSnapshotWriter<3>;
+
+} // namespace barnes_hut
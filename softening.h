@@ -0,0 +1,124 @@
+#pragma once
+
+#include "stdinc.h"
+#include <string_view>
+
+namespace barnes_hut {
+
+// Force-law policies for the tree and direct backends.
+//
+// A policy maps the squared separation r2 and a softening length h to
+//   force(r2, h):     g(r) with acceleration = -G m g(r) r_vec  (Newton: 1/r^3)
+//   potential(r2, h): p(r) with potential    = -G m p(r)        (Newton: 1/r)
+//   evaluate(r2, h, g, p): both at once, sharing the square root
+// All members are static and inline, so a backend instantiated with a policy
+// has its pair kernels fully specialised at compile time.
+//
+// per_particle selects whether the softening length of an interaction is the
+// larger of the two particles' own lengths (and the global length) instead of
+// the global length alone.
+
+// Plummer sphere: 1/(r^2 + h^2)^{3/2}
+struct PlummerSoftening {
+    static constexpr std::string_view name = "plummer";
+    static constexpr bool per_particle = false;
+    static constexpr Real default_length = 1e-5;  // h: keeps close pairs finite, negligible elsewhere
+
+    [[nodiscard]] static Real force(Real r2, Real h) noexcept {
+        const Real s = r2 + h * h;
+        return 1.0 / (s * std::sqrt(s));
+    }
+
+    [[nodiscard]] static Real potential(Real r2, Real h) noexcept {
+        return 1.0 / std::sqrt(r2 + h * h);
+    }
+
+    static void evaluate(Real r2, Real h, Real& force, Real& potential) noexcept {
+        const Real inv_r = 1.0 / std::sqrt(r2 + h * h);
+        potential = inv_r;
+        force = inv_r * inv_r * inv_r;
+    }
+};
+
+// Cubic spline kernel (Monaghan & Lattanzio 1985) as used by Gadget:
+// exactly Newtonian beyond r = h, finite force inside
+struct SplineSoftening {
+    static constexpr std::string_view name = "spline";
+    static constexpr bool per_particle = false;
+    static constexpr Real default_length = 2.8e-5;  // Same depth as the Plummer default
+
+    [[nodiscard]] static Real force(Real r2, Real h) noexcept {
+        const Real r = std::sqrt(r2);
+        if (r >= h) {
+            return 1.0 / (r2 * r);
+        }
+
+        const Real h_inv = 1.0 / h;
+        const Real h3_inv = h_inv * h_inv * h_inv;
+        const Real u = r * h_inv;
+        if (u < 0.5) {
+            return h3_inv * (10.666666666667 + u * u * (32.0 * u - 38.4));
+        }
+        return h3_inv * (21.333333333333 - 48.0 * u + 38.4 * u * u
+                         - 10.666666666667 * u * u * u - 0.066666666667 / (u * u * u));
+    }
+
+    [[nodiscard]] static Real potential(Real r2, Real h) noexcept {
+        const Real r = std::sqrt(r2);
+        if (r >= h) {
+            return 1.0 / r;
+        }
+
+        const Real h_inv = 1.0 / h;
+        const Real u = r * h_inv;
+        if (u < 0.5) {
+            return -h_inv * (-2.8 + u * u * (5.333333333333 + u * u * (6.4 * u - 9.6)));
+        }
+        return -h_inv * (-3.2 + 0.066666666667 / u
+                         + u * u * (10.666666666667 + u * (-16.0 + u * (9.6 - 2.133333333333 * u))));
+    }
+
+    static void evaluate(Real r2, Real h, Real& force, Real& potential) noexcept {
+        force = SplineSoftening::force(r2, h);
+        potential = SplineSoftening::potential(r2, h);
+    }
+};
+
+// Unsoftened Newtonian gravity; coincident particles give infinite forces
+struct NoSoftening {
+    static constexpr std::string_view name = "none";
+    static constexpr bool per_particle = false;
+    static constexpr Real default_length = 0.0;
+
+    [[nodiscard]] static Real force(Real r2, Real /*h*/) noexcept {
+        return 1.0 / (r2 * std::sqrt(r2));
+    }
+
+    [[nodiscard]] static Real potential(Real r2, Real /*h*/) noexcept {
+        return 1.0 / std::sqrt(r2);
+    }
+
+    static void evaluate(Real r2, Real /*h*/, Real& force, Real& potential) noexcept {
+        const Real inv_r = 1.0 / std::sqrt(r2);
+        potential = inv_r;
+        force = inv_r * inv_r * inv_r;
+    }
+};
+
+// Kernel with per-particle softening lengths (Particle::softening())
+template <typename Kernel>
+struct PerParticleSoftening : Kernel {
+    static constexpr bool per_particle = true;
+};
+
+// Policies the backends are instantiated for
+template <typename S>
+concept SofteningPolicy = requires(Real r2, Real h, Real& out) {
+    { S::force(r2, h) } -> std::convertible_to<Real>;
+    { S::potential(r2, h) } -> std::convertible_to<Real>;
+    S::evaluate(r2, h, out, out);
+    { S::per_particle } -> std::convertible_to<bool>;
+    { S::default_length } -> std::convertible_to<Real>;
+};
+
+} // namespace barnes_hut
@@ -0,0 +1,122 @@
+#include "solver.h"
+#include "direct_sum.h"
+#include "tree.h"
+#include <sstream>
+#include <vector>
+
+namespace barnes_hut {
+
+std::string format_statistics(const SolverStatistics& stats, bool include_diagnostics) {
+    std::ostringstream oss;
+    oss << "DirectForce: " << stats.direct_force_count
+        << "; ParticleCell: " << stats.particle_cell_interactions
+        << "; NodesUsed: " << stats.nodes_used
+        << "; NodesAvailable: " << stats.nodes_available
+        << "; TimeLoad: " << stats.time_load
+        << "; TimeUpward: " << stats.time_upward
+        << "; TimeForce: " << stats.time_force
+        << "; TimeTotal: " << stats.time_total;
+
+    if (include_diagnostics) {
+        oss << "; Ekin: " << stats.kinetic_energy
+            << "; Epot: " << stats.potential_energy
+            << "; Etot: " << stats.total_energy
+            << "; P: " << stats.linear_momentum
+            << "; L: " << stats.angular_momentum
+            << "; CoM: " << stats.center_of_mass;
+    }
+    return oss.str();
+}
+
+template <int Dim, typename Softening>
+BackendSelection select_force_backend(std::span<const BasicParticle<Dim>> particles,
+                                      Real theta,
+                                      Index max_particles_per_leaf,
+                                      Real softening_length,
+                                      OpeningCriterion criterion,
+                                      bool measure) {
+    BackendSelection selection;
+
+    if (particles.size() < DIRECT_ALWAYS_BELOW) {
+        selection.backend = ForceBackend::Direct;
+        return selection;
+    }
+    if (particles.size() > TREE_ALWAYS_ABOVE) {
+        selection.backend = ForceBackend::Tree;
+        return selection;
+    }
+    if (!measure) {
+        selection.backend = (particles.size() < DIRECT_BREAK_EVEN) ? ForceBackend::Direct : ForceBackend::Tree;
+        return selection;
+    }
+
+    // Time one force evaluation of each backend on scratch copies
+    {
+        std::vector<BasicParticle<Dim>> scratch(particles.begin(), particles.end());
+        BasicBarnesHutTree<Dim, Softening> tree(scratch, 0.0, theta, max_particles_per_leaf);
+        tree.set_softening_length(softening_length);
+        tree.set_opening_criterion(criterion);
+        tree.simulation_step();
+        const auto& stats = tree.get_statistics();
+        selection.tree_seconds = stats.time_load + stats.time_upward + stats.time_force;
+    }
+    {
+        std::vector<BasicParticle<Dim>> scratch(particles.begin(), particles.end());
+        BasicDirectSummation<Dim, Softening> direct(scratch, 0.0);
+        direct.set_softening_length(softening_length);
+        direct.calculate_forces();
+        const auto& stats = direct.get_statistics();
+        selection.direct_seconds = stats.time_load + stats.time_force;
+    }
+
+    selection.measured = true;
+    selection.backend = (selection.direct_seconds <= selection.tree_seconds)
+                        ? ForceBackend::Direct : ForceBackend::Tree;
+    return selection;
+}
+
+#define SELECT_FORCE_BACKEND_INSTANTIATION(DIM, SOFTENING) \
+    template BackendSelection select_force_backend<DIM, SOFTENING>( \
+        std::span<const BasicParticle<DIM>>, Real, Index, Real, OpeningCriterion, bool);
+
+SELECT_FORCE_BACKEND_INSTANTIATION(2, PlummerSoftening)
+SELECT_FORCE_BACKEND_INSTANTIATION(2, SplineSoftening)
+SELECT_FORCE_BACKEND_INSTANTIATION(2, NoSoftening)
+SELECT_FORCE_BACKEND_INSTANTIATION(3, PlummerSoftening)
+SELECT_FORCE_BACKEND_INSTANTIATION(3, SplineSoftening)
+SELECT_FORCE_BACKEND_INSTANTIATION(3, NoSoftening)
+
+#undef SELECT_FORCE_BACKEND_INSTANTIATION
+
+std::string_view to_string(ForceBackend backend) noexcept {
+    switch (backend) {
+        case ForceBackend::Direct:
+            return "direct";
+        case ForceBackend::Tree:
+            return "tree";
+    }
+    return "unknown";
+}
+
+std::string_view to_string(OpeningCriterion criterion) noexcept {
+    switch (criterion) {
+        case OpeningCriterion::Geometric:
+            return "geometric";
+        case OpeningCriterion::Offset:
+            return "offset";
+        case OpeningCriterion::MaxDistance:
+            return "bmax";
+    }
+    return "unknown";
+}
+
+std::optional<OpeningCriterion> parse_opening_criterion(std::string_view name) noexcept {
+    for (const auto criterion : {OpeningCriterion::Geometric, OpeningCriterion::Offset, OpeningCriterion::MaxDistance}) {
+        if (name == to_string(criterion)) {
+            return criterion;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace barnes_hut
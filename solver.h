@@ -0,0 +1,189 @@
+#pragma once
+
+#include "particle.h"
+#include "vektor.h"
+#include <algorithm>
+#include <concepts>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace barnes_hut {
+
+// Per-step statistics shared by all force backends. Vector quantities are
+// 3D for every dimension (planar runs have zero z components).
+struct SolverStatistics {
+    Index direct_force_count = 0;
+    Index particle_cell_interactions = 0;
+    Index nodes_used = 0;
+    Index nodes_available = 0;
+    double time_load = 0.0;
+    double time_upward = 0.0;
+    double time_force = 0.0;
+    double time_total = 0.0;
+    double force_imbalance = 0.0;  // Busiest thread's force time over the mean, minus 1
+    Real theta = 0.0;              // Opening angle of the step (0: exact forces)
+    double step_budget = 0.0;      // Time budget the step was fitted to (0: none)
+    double force_error = 0.0;      // Latest sampled relative force error percentile (0: none yet)
+    double time_error = 0.0;       // Spent sampling force_error this step, not in time_total
+
+    // Conserved quantities (only with set_compute_potential(true)),
+    // evaluated at the positions and velocities the forces were computed for
+    Real kinetic_energy = 0.0;
+    Real potential_energy = 0.0;
+    Real total_energy = 0.0;
+    Vector3D linear_momentum{0.0};
+    Vector3D angular_momentum{0.0};
+    Vector3D center_of_mass{0.0};
+};
+
+[[nodiscard]] std::string format_statistics(const SolverStatistics& stats, bool include_diagnostics);
+
+// Interface every force backend offers to the simulation drivers
+template <typename S>
+concept NBodySolver = requires(S solver, const S const_solver, bool flag) {
+    solver.simulation_step();
+    solver.clear_tree();
+    solver.set_compute_potential(flag);
+    { const_solver.get_statistics() } -> std::convertible_to<const SolverStatistics&>;
+    { const_solver.get_statistics_string() } -> std::convertible_to<std::string>;
+};
+
+// Load imbalance of a parallel phase from each thread's busy time
+[[nodiscard]] inline double load_imbalance(std::span<const double> busy) noexcept {
+    if (busy.empty()) {
+        return 0.0;
+    }
+    double total = 0.0;
+    double slowest = 0.0;
+    for (const double seconds : busy) {
+        total += seconds;
+        slowest = std::max(slowest, seconds);
+    }
+    return total > 0.0 ? slowest * busy.size() / total - 1.0 : 0.0;
+}
+
+// Conserved-quantity sums of a range of particles
+struct ParticleMoments {
+    Real kinetic = 0.0;
+    Real potential = 0.0;
+    Real total_mass = 0.0;
+    Vector3D momentum{0.0};
+    Vector3D angular_momentum{0.0};
+    Vector3D mass_moment{0.0};
+
+    ParticleMoments& operator+=(const ParticleMoments& other) noexcept {
+        kinetic += other.kinetic;
+        potential += other.potential;
+        total_mass += other.total_mass;
+        momentum += other.momentum;
+        angular_momentum += other.angular_momentum;
+        mass_moment += other.mass_moment;
+        return *this;
+    }
+};
+
+// Particles per block of the diagnostics reduction
+inline constexpr Index MOMENT_BLOCK_SIZE = 4096;
+
+// Advance all particles by dt while reducing the conserved quantities of the
+// pre-step state into stats, in a single parallel pass. post_step(particle)
+// runs after each particle has been integrated.
+//
+// The sums have a fixed shape: each block of MOMENT_BLOCK_SIZE particles is
+// summed in index order, then the block sums pairwise. The result is the same
+// bits for any thread count or schedule.
+template <int Dim, typename PostStep>
+void integrate_with_diagnostics(std::span<BasicParticle<Dim>> particles, Real dt, SolverStatistics& stats, PostStep&& post_step) {
+    const Index n = particles.size();
+    const Index blocks = (n + MOMENT_BLOCK_SIZE - 1) / MOMENT_BLOCK_SIZE;
+    std::vector<ParticleMoments> block_moments(blocks);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (Index block = 0; block < blocks; ++block) {
+        const Index end = std::min(n, (block + 1) * MOMENT_BLOCK_SIZE);
+        ParticleMoments sums;
+        for (Index i = block * MOMENT_BLOCK_SIZE; i < end; ++i) {
+            auto& particle = particles[i];
+            const Real mass = particle.mass();
+            const Vector3D position = to_3d(particle.position());
+            const Vector3D p = mass * to_3d(particle.velocity());
+
+            sums.kinetic += 0.5 * mass * particle.velocity().squared_magnitude();
+            sums.potential += 0.5 * mass * particle.potential();
+            sums.total_mass += mass;
+            sums.momentum += p;
+            sums.angular_momentum += position.cross(p);
+            sums.mass_moment += mass * position;
+
+            particle.integrate(dt);
+            post_step(particle);
+        }
+        block_moments[block] = sums;
+    }
+
+    for (Index stride = 1; stride < blocks; stride *= 2) {
+        for (Index block = 0; block + stride < blocks; block += 2 * stride) {
+            block_moments[block] += block_moments[block + stride];
+        }
+    }
+    const ParticleMoments total = blocks > 0 ? block_moments[0] : ParticleMoments{};
+
+    stats.kinetic_energy = total.kinetic;
+    stats.potential_energy = total.potential;
+    stats.total_energy = total.kinetic + total.potential;
+    stats.linear_momentum = total.momentum;
+    stats.angular_momentum = total.angular_momentum;
+    stats.center_of_mass = (total.total_mass > 0.0) ? total.mass_moment / total.total_mass : Vector3D{0.0};
+}
+
+// When the tree walk accepts a cell's monopole instead of opening it. Each
+// criterion gives the cell an opening radius: the cell is accepted for
+// particles at least that far from its mass centre.
+enum class OpeningCriterion {
+    Geometric,   // size / theta (Barnes & Hut 1986)
+    Offset,      // size / theta + |mass centre - geometric centre| (Barnes 1994)
+    MaxDistance  // b_max / theta, b_max = mass centre to farthest corner (Salmon & Warren 1994)
+};
+
+[[nodiscard]] std::string_view to_string(OpeningCriterion criterion) noexcept;
+[[nodiscard]] std::optional<OpeningCriterion> parse_opening_criterion(std::string_view name) noexcept;
+
+// Force backend selection
+enum class ForceBackend {
+    Tree,
+    Direct
+};
+
+struct BackendSelection {
+    ForceBackend backend = ForceBackend::Tree;
+    bool measured = false;        // false: decided by the cost model alone
+    double tree_seconds = 0.0;    // Measured force time (when measured)
+    double direct_seconds = 0.0;
+};
+
+// Pick the faster backend for this particle set. Small and large N are
+// decided by the calibrated thresholds below; in between, one force
+// evaluation of each backend is timed on a copy of the particles (the tree
+// with the criterion the run will use), or, if !measure (the choice must not
+// depend on the machine's load), the measured break-even point decides.
+inline constexpr Index DIRECT_ALWAYS_BELOW = 512;
+inline constexpr Index TREE_ALWAYS_ABOVE = 32768;
+inline constexpr Index DIRECT_BREAK_EVEN = 20000;
+
+template <int Dim, typename Softening>
+[[nodiscard]] BackendSelection select_force_backend(
+    std::span<const BasicParticle<Dim>> particles,
+    Real theta,
+    Index max_particles_per_leaf,
+    Real softening_length,
+    OpeningCriterion criterion,
+    bool measure = true);
+
+[[nodiscard]] std::string_view to_string(ForceBackend backend) noexcept;
+
+} // namespace barnes_hut
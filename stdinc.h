@@ -19,10 +19,15 @@
 #include <random>
 
 // Modern C++20 constants
+// Default dimension; the tree, particles and vectors are templates on the
+// dimension with 2D and 3D instantiations chosen at run time
 inline constexpr int NDIM = 3;
 inline constexpr int NSUB = 1 << NDIM;
+
+// Children per tree node in Dim dimensions (4: quadtree, 8: octree)
+template <int Dim>
+inline constexpr int SUBCELLS = 1 << Dim;
 inline constexpr double GRAVITY = 1.0;
-inline constexpr double EPSILON_SQUARED = 1e-10;  // Softening parameter for numerical stability
 
 // Modern configuration flags
 inline constexpr bool ENABLE_TIMING = true;
@@ -36,6 +41,9 @@ using Index = std::size_t;
 using TimePoint = std::chrono::high_resolution_clock::time_point;
 using Duration = std::chrono::duration<double>;
 
+// Uniform random number in [min_val, max_val) (defined in stdinc.cpp)
+double generate_random(double min_val, double max_val);
+
 // High-precision timer class
 class Timer {
 public:
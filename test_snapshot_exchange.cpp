@@ -0,0 +1,129 @@
+/**
+ * SnapshotExchange Stress Test
+ * A producer thread publishes numbered states as fast as it can while the
+ * consumer acquires them; every acquired state must be whole (all of its
+ * values from one publish, even while the producer keeps writing) and newer
+ * than the one before, and the last published state must arrive. Needs no
+ * OpenGL, so it runs wherever the simulation builds
+ */
+
+#include "snapshot_exchange.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace barnes_hut;
+
+namespace {
+
+// Sizes vary with the step, so a state mixing two publishes shows in its
+// lengths as well as in its values
+Index state_size(Index step) noexcept {
+    return step % 7 + 1;
+}
+
+void fill_state(RenderSnapshot& buffer, Index step) {
+    const float value = static_cast<float>(step);
+    buffer.positions.assign(3 * state_size(step), value);
+    buffer.speed.assign(state_size(step), value);
+    buffer.force.assign(state_size(step), value);
+    buffer.step = step;
+    buffer.time = static_cast<Real>(step);
+    buffer.statistics = SolverStatistics{};
+    buffer.statistics.time_total = static_cast<double>(step);
+}
+
+bool is_whole(const RenderSnapshot& buffer) {
+    const Index step = buffer.step;
+    const float value = static_cast<float>(step);
+    if (buffer.size() != state_size(step) || buffer.force.size() != state_size(step) ||
+        buffer.positions.size() != 3 * state_size(step) ||
+        buffer.time != static_cast<Real>(step) || buffer.statistics.time_total != static_cast<double>(step)) {
+        return false;
+    }
+    for (const auto* values : {&buffer.positions, &buffer.speed, &buffer.force}) {
+        for (float v : *values) {
+            if (v != value) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::cout << "=== SnapshotExchange Stress Test ===\n\n";
+
+    const Index steps = (argc > 1) ? std::stoull(argv[1]) : 200000;
+    const Index particle_count = 1000;
+
+    std::vector<Particle3D> particles(particle_count);
+    for (Index i = 0; i < particle_count; ++i) {
+        particles[i].set_position(Vector3D{static_cast<Real>(i), 0.0, 0.0});
+    }
+
+    SnapshotExchange exchange(particle_count);
+    std::atomic<bool> done{false};
+
+    // Numbered states 1..steps, then the particles through publish<Dim>()
+    std::thread producer([&] {
+        for (Index step = 1; step <= steps; ++step) {
+            fill_state(exchange.write_buffer(), step);
+            exchange.publish();
+            std::this_thread::yield();  // Interleave the threads on a single core too
+        }
+        exchange.publish<3>(particles, steps + 1, 0.0, SolverStatistics{});
+        done.store(true, std::memory_order_release);
+    });
+
+    Index last = 0;
+    Index torn = 0;
+    Index out_of_order = 0;
+    for (;;) {
+        const bool finished = done.load(std::memory_order_acquire);
+        if (exchange.acquire()) {
+            const RenderSnapshot& buffer = exchange.read_buffer();
+            if (buffer.step <= last) {
+                ++out_of_order;
+            }
+            last = buffer.step;
+
+            if (buffer.step <= steps) {
+                // Check again after the producer had time to publish more:
+                // it must not write into the buffer the consumer holds
+                const bool whole = is_whole(buffer);
+                std::this_thread::yield();
+                if (!whole || !is_whole(buffer)) {
+                    ++torn;
+                }
+            }
+            else {
+                bool whole = (buffer.size() == particle_count);
+                for (Index i = 0; whole && i < particle_count; ++i) {
+                    whole = (buffer.positions[3 * i] == static_cast<float>(i));
+                }
+                if (!whole) {
+                    ++torn;
+                }
+            }
+        }
+        else if (finished) {
+            break;
+        }
+    }
+    producer.join();
+
+    std::cout << "Published: " << exchange.published() << "\n"
+              << "Acquired: " << exchange.acquired() << "\n"
+              << "Torn states: " << torn << "\n"
+              << "Out of order: " << out_of_order << "\n"
+              << "Last step: " << last << " (expected " << steps + 1 << ")\n\n";
+
+    const bool passed = (torn == 0 && out_of_order == 0 && last == steps + 1);
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed ? 0 : 1;
+}
@@ -1,7 +1,8 @@
 #include "tree.h"
+#include "accuracy.h"
+#include "benchmark.h"
 #include <algorithm>
 #include <cmath>
-#include <sstream>
 #include <limits>
 #include <iomanip>
 
@@ -11,14 +12,19 @@
 
 namespace barnes_hut {
 
-BarnesHutTree::BarnesHutTree(std::span<Particle> particles, Real timestep, Real theta, Index max_particles_per_leaf)
+template <int Dim, typename Softening>
+BasicBarnesHutTree<Dim, Softening>::BasicBarnesHutTree(std::span<Particle> particles, Real timestep, Real theta, Index max_particles_per_leaf)
     : particles_(particles)
     , dt_(timestep)
     , theta_(theta)
+    , opening_criterion_(OpeningCriterion::Geometric)
     , max_particles_per_leaf_(max_particles_per_leaf)
+    , softening_length_(Softening::default_length)
     , root_(std::make_unique<Node>())
     , current_node_index_(0)
-    , max_tree_level_(0) {
+    , max_tree_level_(0)
+    , box_size_(0.0)
+    , compute_potential_(false) {
 
     // Initialize particle IDs
     for (Index i = 0; i < particles_.size(); ++i) {
@@ -29,7 +35,8 @@ BarnesHutTree::BarnesHutTree(std::span<Particle> particles, Real timestep, Real
     node_pool_.reserve(particles_.size() * 3);
 }
 
-void BarnesHutTree::simulation_step() {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::simulation_step() {
     Timer total_timer;
     stats_ = Statistics{};
 
@@ -45,47 +52,128 @@ void BarnesHutTree::simulation_step() {
 
     // Calculate forces
     Timer force_timer;
-    #ifdef _OPENMP
-    calculate_forces_parallel();
-    #else
     calculate_forces();
-    #endif
     stats_.time_force = force_timer.elapsed();
 
+    // Sampled force error, while positions and forces still belong together
+    ++steps_;
+    if (error_interval_ > 0 && steps_ % error_interval_ == 0 && !is_periodic()) {
+        Timer error_timer;
+        sample_force_error();
+        stats_.time_error = error_timer.elapsed();
+    }
+    stats_.force_error = force_error_;
+
     // Integrate particles
     integrate_particles();
 
-    stats_.time_total = total_timer.elapsed();
+    stats_.time_total = total_timer.elapsed() - stats_.time_error;
     stats_.nodes_used = current_node_index_;
     stats_.nodes_available = node_pool_.size();
+    stats_.theta = theta_;
+    stats_.step_budget = step_budget_;
+
+    if (step_budget_ > 0.0) {
+        fit_theta_to_budget();
+    }
+}
+
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::fit_theta_to_budget() noexcept {
+    // Cost model: the walk's interactions, and so its time, scale about as
+    // theta^-2; the build, upward pass and integration do not depend on
+    // theta. The walk gets what the rest leaves of 90% of the budget (at
+    // least a tenth), and theta moves by at most 25% per step.
+    constexpr double HEADROOM = 0.9;
+    constexpr double MAX_STEP_FACTOR = 1.25;
+
+    if (!(stats_.time_force > 0.0)) {
+        return;
+    }
+    const double other = stats_.time_total - stats_.time_force;
+    const double force_budget = std::max(HEADROOM * step_budget_ - other, 0.1 * step_budget_);
+    const double factor = std::sqrt(stats_.time_force / force_budget);
+    const Real upper = std::max(min_theta_, std::min(max_theta_, max_safe_theta()));
+    theta_ = std::clamp(theta_ * std::clamp(factor, 1.0 / MAX_STEP_FACTOR, MAX_STEP_FACTOR), min_theta_, upper);
 }
 
-void BarnesHutTree::clear_tree() {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::sample_force_error() {
+    const std::span<const Particle> particles(particles_);
+    const auto targets = sample_targets(particles.size(), error_sample_);
+    const auto exact = reference_forces<Dim, Softening>(particles, targets, softening_length_);
+    force_error_ = quantile(relative_force_errors<Dim>(particles, targets, exact), error_percentile_ / 100.0);
+}
+
+template <int Dim, typename Softening>
+Real BasicBarnesHutTree<Dim, Softening>::max_safe_theta() const noexcept {
+    // A particle inside a cell of side s is within s sqrt(Dim) of the mass
+    // centre, within s sqrt(Dim) / 2 + offset of it, and within b_max of it
+    const Real diagonal = std::sqrt(static_cast<Real>(Dim));
+    switch (opening_criterion_) {
+        case OpeningCriterion::Geometric:
+            return 1.0 / diagonal;
+        case OpeningCriterion::Offset:
+            return 2.0 / diagonal;
+        case OpeningCriterion::MaxDistance:
+            return 1.0;
+    }
+    return 1.0 / diagonal;
+}
+
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::enable_periodic_boundaries(Real box_size, std::shared_ptr<const EwaldTable> ewald) {
+    box_size_ = box_size;
+    ewald_ = std::move(ewald);
+
+    if constexpr (Dim != 3) {
+        if (ewald_) {
+            std::cerr << "Warning: Ewald corrections are 3D only; using the minimum image\n";
+            ewald_.reset();
+        }
+    }
+
+    // Map all particles into the primary box
+    for (auto& particle : particles_) {
+        wrap_position(particle.position());
+    }
+}
+
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::clear_tree() {
     root_->reset();
     reset_node_pool();
 }
 
-void BarnesHutTree::find_bounding_box(Vector3D& center, Real& size) const {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::find_bounding_box(Vector& center, Real& size) const {
+    if (is_periodic()) {
+        // Fixed box, independent of the particle distribution
+        center = Vector{0.5 * box_size_};
+        size = box_size_;
+        return;
+    }
+
     if (particles_.empty()) {
-        center = Vector3D{0.0};
+        center = Vector{0.0};
         size = 1.0;
         return;
     }
 
-    Vector3D min_pos = particles_[0].position();
-    Vector3D max_pos = particles_[0].position();
+    Vector min_pos = particles_[0].position();
+    Vector max_pos = particles_[0].position();
 
     // Find bounding box
     for (const auto& particle : particles_) {
         const auto& pos = particle.position();
-        for (int dim = 0; dim < NDIM; ++dim) {
+        for (int dim = 0; dim < Dim; ++dim) {
             min_pos[dim] = std::min(min_pos[dim], pos[dim]);
             max_pos[dim] = std::max(max_pos[dim], pos[dim]);
         }
     }
 
     // Calculate center and size
-    for (int dim = 0; dim < NDIM; ++dim) {
+    for (int dim = 0; dim < Dim; ++dim) {
         const Real extent = max_pos[dim] - min_pos[dim];
         center[dim] = min_pos[dim] + extent * 0.5;
         size = std::max(size, extent);
@@ -95,9 +183,10 @@ void BarnesHutTree::find_bounding_box(Vector3D& center, Real& size) const {
     size = std::ceil(size) + 1.0;
 }
 
-void BarnesHutTree::build_tree() {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::build_tree() {
     // Find bounding box
-    Vector3D center{0.0};
+    Vector center{0.0};
     Real size = 0.0;
     find_bounding_box(center, size);
 
@@ -133,7 +222,7 @@ void BarnesHutTree::build_tree() {
                 if (child->particle_count < max_particles_per_leaf_) {
                     child->particle_count++;
                     child->particle_list.push_back(&particles_[i]);
-                    particles_[i].set_parent(child.get());
+                    particles_[i].set_parent(child);
                     current->particle_count++;
                     inserted = true;
                 }
@@ -141,30 +230,32 @@ void BarnesHutTree::build_tree() {
                     // Convert leaf to internal node
                     convert_leaf_to_internal(current, child_idx);
                     current->particle_count++;
-                    current = child.get();
+                    current = child;
                 }
             }
             else if (child->type == NodeType::Internal) {
                 current->particle_count++;
-                current = child.get();
+                current = child;
             }
         }
     }
 }
 
-int BarnesHutTree::which_child(const Vector3D& position, const Node* node) const noexcept {
+template <int Dim, typename Softening>
+int BasicBarnesHutTree<Dim, Softening>::which_child(const Vector& position, const Node* node) const noexcept {
     int child_number = 0;
 
-    for (int k = 0; k < NDIM; ++k) {
+    for (int k = 0; k < Dim; ++k) {
         if (position[k] >= node->geo_center[k]) {
             child_number += (1 << k);
         }
     }
 
-    return (child_number >= 0 && child_number < NSUB) ? child_number : -1;
+    return (child_number >= 0 && child_number < Node::subcells) ? child_number : -1;
 }
 
-void BarnesHutTree::add_leaf(Index particle_idx, Particle& particle, Node* node, int child_idx) {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::add_leaf(Index /*particle_idx*/, Particle& particle, Node* node, int child_idx) {
     node->type = NodeType::Internal;
 
     // Allocate new leaf from pool
@@ -178,7 +269,7 @@ void BarnesHutTree::add_leaf(Index particle_idx, Particle& particle, Node* node,
     new_leaf->type = NodeType::Leaf;
 
     // Calculate leaf center
-    for (int k = 0; k < NDIM; ++k) {
+    for (int k = 0; k < Dim; ++k) {
         if ((child_idx >> k) & 1) {
             new_leaf->geo_center[k] = node->geo_center[k] + new_leaf->size / 2.0;
         }
@@ -187,16 +278,17 @@ void BarnesHutTree::add_leaf(Index particle_idx, Particle& particle, Node* node,
         }
     }
 
-    // Transfer ownership to parent
-    node->children[child_idx] = std::unique_ptr<Node>(new_leaf);
+    // Link into parent (the node pool keeps ownership)
+    node->children[child_idx] = new_leaf;
     new_leaf->parent = node;
 
     // Update max tree level
     max_tree_level_ = std::max(max_tree_level_, new_leaf->level);
 }
 
-void BarnesHutTree::convert_leaf_to_internal(Node* node, int child_idx) {
-    auto* old_leaf = node->children[child_idx].get();
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::convert_leaf_to_internal(Node* node, int child_idx) {
+    auto* old_leaf = node->children[child_idx];
 
     // Save particle list
     auto temp_particle_list = std::move(old_leaf->particle_list);
@@ -205,12 +297,12 @@ void BarnesHutTree::convert_leaf_to_internal(Node* node, int child_idx) {
 
     // Re-insert particles
     for (auto* particle : temp_particle_list) {
-        const int new_child_idx = which_child(particle->position(), old_leaf);
         insert_particle(particle->id(), *particle, old_leaf);
     }
 }
 
-void BarnesHutTree::insert_particle(Index particle_idx, Particle& particle, Node* node) {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::insert_particle(Index particle_idx, Particle& particle, Node* node) {
     const int child_idx = which_child(particle.position(), node);
     auto& child = node->children[child_idx];
 
@@ -223,38 +315,43 @@ void BarnesHutTree::insert_particle(Index particle_idx, Particle& particle, Node
         if (child->particle_count < max_particles_per_leaf_) {
             child->particle_count++;
             child->particle_list.push_back(&particle);
-            particle.set_parent(child.get());
+            particle.set_parent(child);
             node->particle_count++;
         }
         else {
             convert_leaf_to_internal(node, child_idx);
             node->particle_count++;
-            insert_particle(particle_idx, particle, child.get());
+            insert_particle(particle_idx, particle, child);
         }
     }
     else if (child->type == NodeType::Internal) {
         node->particle_count++;
-        insert_particle(particle_idx, particle, child.get());
+        insert_particle(particle_idx, particle, child);
     }
 }
 
-void BarnesHutTree::compute_mass_distribution() {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::compute_mass_distribution() {
     compute_center_of_mass(root_.get());
 }
 
-void BarnesHutTree::compute_center_of_mass(Node* node) {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::compute_center_of_mass(Node* node) {
     if (!node || node->type == NodeType::Empty) {
         return;
     }
 
     if (node->type == NodeType::Leaf) {
         // Calculate center of mass for leaf
-        Vector3D cms{0.0};
+        Vector cms{0.0};
         Real total_mass = 0.0;
 
         for (const auto* particle : node->particle_list) {
             cms += particle->mass() * particle->position();
             total_mass += particle->mass();
+            if constexpr (Softening::per_particle) {
+                node->max_softening = std::max(node->max_softening, particle->softening());
+            }
         }
 
         if (total_mass > 0.0) {
@@ -264,14 +361,17 @@ void BarnesHutTree::compute_center_of_mass(Node* node) {
     }
     else if (node->type == NodeType::Internal) {
         // Recursively calculate for children
-        Vector3D cms{0.0};
+        Vector cms{0.0};
         Real total_mass = 0.0;
 
         for (auto& child : node->children) {
             if (child && child->type != NodeType::Empty) {
-                compute_center_of_mass(child.get());
+                compute_center_of_mass(child);
                 cms += child->mass * child->mass_center;
                 total_mass += child->mass;
+                if constexpr (Softening::per_particle) {
+                    node->max_softening = std::max(node->max_softening, child->max_softening);
+                }
             }
         }
 
@@ -280,114 +380,281 @@ void BarnesHutTree::compute_center_of_mass(Node* node) {
             node->mass = total_mass;
         }
     }
+
+    node->open_radius_squared = open_radius_squared(*node);
+}
+
+template <int Dim, typename Softening>
+Real BasicBarnesHutTree<Dim, Softening>::open_radius_squared(const Node& node) const noexcept {
+    // theta = 0 opens every cell
+    if (!(theta_ > 0.0)) {
+        return std::numeric_limits<Real>::max();
+    }
+
+    switch (opening_criterion_) {
+        case OpeningCriterion::Geometric:
+            break;
+        case OpeningCriterion::Offset: {
+            const Real radius = node.size / theta_ + (node.mass_center - node.geo_center).magnitude();
+            return radius * radius;
+        }
+        case OpeningCriterion::MaxDistance: {
+            Real b_max_squared = 0.0;
+            for (int dim = 0; dim < Dim; ++dim) {
+                const Real extent = 0.5 * node.size + std::abs(node.mass_center[dim] - node.geo_center[dim]);
+                b_max_squared += extent * extent;
+            }
+            return b_max_squared / (theta_ * theta_);
+        }
+    }
+
+    const Real radius = node.size / theta_;
+    return radius * radius;
+}
+
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::calculate_forces() {
+    #ifdef _OPENMP
+    calculate_forces_parallel();
+    #else
+    calculate_forces_serial();
+    #endif
 }
 
-void BarnesHutTree::calculate_forces() {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::calculate_forces_serial() {
     // Reset forces
     for (auto& particle : particles_) {
-        particle.force() = Vector3D{0.0};
+        particle.force() = Vector{0.0};
+        particle.potential() = self_potential(particle);
     }
 
     // Calculate forces for each particle
+    WalkCounts counts;
     for (auto& particle : particles_) {
         for (const auto& child : root_->children) {
             if (child && child->type != NodeType::Empty) {
-                interact(particle, child.get());
+                interact(particle, child, counts, ewald_ != nullptr);
             }
         }
     }
+
+    stats_.particle_cell_interactions = counts.particle_cell;
+    stats_.direct_force_count = counts.direct;
 }
 
-void BarnesHutTree::calculate_forces_parallel() {
+#ifdef _OPENMP
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::calculate_forces_parallel() {
     // Reset forces
     #pragma omp parallel for
     for (Index i = 0; i < particles_.size(); ++i) {
-        particles_[i].force() = Vector3D{0.0};
+        particles_[i].force() = Vector{0.0};
+        particles_[i].potential() = self_potential(particles_[i]);
     }
 
-    // Calculate forces in parallel
-    #pragma omp parallel for schedule(dynamic)
-    for (Index i = 0; i < particles_.size(); ++i) {
-        for (const auto& child : root_->children) {
-            if (child && child->type != NodeType::Empty) {
-                interact(particles_[i], child.get());
+    // Calculate forces in parallel. Each walk visits the tree in a fixed
+    // order and only writes its own particle, so the forces do not depend on
+    // the thread count; the interaction counts are summed per thread.
+    Index particle_cell = 0;
+    Index direct = 0;
+    std::vector<double> busy(omp_get_max_threads(), 0.0);
+    int team = 1;
+    #pragma omp parallel reduction(+ : particle_cell, direct)
+    {
+        #pragma omp single nowait
+        team = omp_get_num_threads();
+
+        Timer busy_timer;
+        #pragma omp for schedule(dynamic) nowait
+        for (Index i = 0; i < particles_.size(); ++i) {
+            WalkCounts counts;
+            for (const auto& child : root_->children) {
+                if (child && child->type != NodeType::Empty) {
+                    interact(particles_[i], child, counts, ewald_ != nullptr);
+                }
             }
+            particle_cell += counts.particle_cell;
+            direct += counts.direct;
         }
+        busy[omp_get_thread_num()] = busy_timer.elapsed();
     }
+
+    stats_.particle_cell_interactions = particle_cell;
+    stats_.direct_force_count = direct;
+    stats_.force_imbalance = load_imbalance(std::span<const double>(busy.data(), team));
 }
+#endif
 
-bool BarnesHutTree::is_well_separated(const Particle& particle, const Node& node) const noexcept {
-    const Real r_squared = particle.position().squared_distance(node.mass_center);
-    const Real r = std::sqrt(r_squared + EPSILON_SQUARED);
+template <int Dim, typename Softening>
+bool BasicBarnesHutTree<Dim, Softening>::is_well_separated(const Particle& particle, const Node& node) const noexcept {
+    const Real r_squared = separation(particle.position(), node.mass_center).squared_magnitude();
 
-    return (node.size / r) <= theta_;
+    // The opening radius is precomputed by the upward pass
+    return r_squared >= node.open_radius_squared;
 }
 
-void BarnesHutTree::interact(Particle& particle, const Node* node) {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::interact(Particle& particle, const Node* node, WalkCounts& counts,
+                                                  bool ewald_pending) {
     if (!node || node->type == NodeType::Empty) {
         return;
     }
 
+    // The Ewald correction is smooth (almost linear) well below the box
+    // scale, so a coarse cell gets a single correction for its whole subtree
+    if (ewald_pending && accepts_ewald_cell(particle, *node)) {
+        apply_ewald_correction(particle, separation(particle.position(), node->mass_center), node->mass);
+        ewald_pending = false;
+    }
+
     if (is_well_separated(particle, *node)) {
         // Use multipole approximation
         particle_cell_interaction(particle, *node);
+        ++counts.particle_cell;
+        if (ewald_pending) {
+            apply_ewald_correction(particle, separation(particle.position(), node->mass_center), node->mass);
+        }
     }
     else {
         // Need to go deeper
         if (node->type == NodeType::Internal) {
             for (const auto& child : node->children) {
                 if (child && child->type != NodeType::Empty) {
-                    interact(particle, child.get());
+                    interact(particle, child, counts, ewald_pending);
                 }
             }
         }
         else if (node->type == NodeType::Leaf) {
             // Direct calculation with all particles in leaf
             for (auto* other_particle : node->particle_list) {
+                if (other_particle->id() != particle.id()) {
+                    ++counts.direct;
+                }
                 direct_force_calculation(particle, *other_particle);
+                if (ewald_pending && other_particle != &particle) {
+                    apply_ewald_correction(particle,
+                                           separation(particle.position(), other_particle->position()),
+                                           other_particle->mass());
+                }
             }
         }
     }
 }
 
-void BarnesHutTree::particle_cell_interaction(Particle& particle, const Node& cell) {
-    stats_.particle_cell_interactions++;
-
-    const Real r_squared = particle.position().squared_distance(cell.mass_center);
-    const Real r_cubed = (r_squared + EPSILON_SQUARED) * std::sqrt(r_squared + EPSILON_SQUARED);
-    const Vector3D r_vec = particle.position() - cell.mass_center;
-
-    particle.force() += -GRAVITY * particle.mass() * cell.mass / r_cubed * r_vec;
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::particle_cell_interaction(Particle& particle, const Node& cell) const noexcept {
+    accumulate(particle, separation(particle.position(), cell.mass_center), cell.mass,
+               interaction_softening(particle, cell.max_softening));
 }
 
-void BarnesHutTree::direct_force_calculation(Particle& p1, Particle& p2) {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::direct_force_calculation(Particle& p1, const Particle& p2) const noexcept {
     // Don't calculate force with itself
     if (p1.id() == p2.id()) {
         return;
     }
 
-    stats_.direct_force_count++;
-
-    const Vector3D r_vec = p1.position() - p2.position();
-    const Real r_squared = r_vec.squared_magnitude();
-
-    // Numerical stability with softening
-    const Real r_cubed = (r_squared + EPSILON_SQUARED) * std::sqrt(r_squared + EPSILON_SQUARED);
-
-    const Vector3D force = -GRAVITY * p1.mass() * p2.mass() / r_cubed * r_vec;
-    p1.force() += force;
+    accumulate(p1, separation(p1.position(), p2.position()), p2.mass(),
+               interaction_softening(p1, p2.softening()));
 }
 
-void BarnesHutTree::integrate_particles() {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::integrate_particles() {
+    if (compute_potential_) {
+        // Single pass: reduce the pre-step state, then advance each particle
+        integrate_with_diagnostics(particles_, dt_, stats_, [this](Particle& particle) {
+            if (is_periodic()) {
+                wrap_position(particle.position());
+            }
+        });
+        return;
+    }
+
     #ifdef _OPENMP
     #pragma omp parallel for
     #endif
     for (Index i = 0; i < particles_.size(); ++i) {
         particles_[i].integrate(dt_);
+        if (is_periodic()) {
+            wrap_position(particles_[i].position());
+        }
     }
 }
 
-Node* BarnesHutTree::allocate_node() {
+template <int Dim, typename Softening>
+typename BasicBarnesHutTree<Dim, Softening>::Vector BasicBarnesHutTree<Dim, Softening>::separation(const Vector& a, const Vector& b) const noexcept {
+    Vector r_vec = a - b;
+
+    if (is_periodic()) {
+        // Minimum image convention
+        for (int dim = 0; dim < Dim; ++dim) {
+            r_vec[dim] -= box_size_ * std::nearbyint(r_vec[dim] / box_size_);
+        }
+    }
+
+    return r_vec;
+}
+
+template <int Dim, typename Softening>
+bool BasicBarnesHutTree<Dim, Softening>::accepts_ewald_cell(const Particle& particle, const Node& node) const noexcept {
+    if (node.size > EWALD_CELL_FRACTION * box_size_) {
+        return false;
+    }
+
+    // The whole cell must lie in one image of the particle, away from it;
+    // otherwise the per-interaction corrections keep the image choice
+    // consistent with the Newtonian terms
+    const Vector offset = separation(particle.position(), node.geo_center);
+    bool outside = false;
+    for (int dim = 0; dim < Dim; ++dim) {
+        const Real distance = std::abs(offset[dim]);
+        if (distance + 0.5 * node.size > 0.5 * box_size_) {
+            return false;
+        }
+        outside = outside || distance > 0.5 * node.size;
+    }
+    return outside;
+}
+
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::apply_ewald_correction([[maybe_unused]] Particle& particle,
+                                                     [[maybe_unused]] const Vector& r_vec,
+                                                     [[maybe_unused]] Real source_mass) const noexcept {
+    if constexpr (Dim == 3) {
+        if (compute_potential_) {
+            Real phi = 0.0;
+            const Vector correction = ewald_->correction(r_vec, box_size_, phi);
+            particle.force() += GRAVITY * particle.mass() * source_mass * correction;
+            particle.potential() += GRAVITY * source_mass * phi;
+        }
+        else {
+            particle.force() += GRAVITY * particle.mass() * source_mass * ewald_->force_correction(r_vec, box_size_);
+        }
+    }
+}
+
+template <int Dim, typename Softening>
+Real BasicBarnesHutTree<Dim, Softening>::self_potential(const Particle& particle) const noexcept {
+    // Interaction of a particle with its own periodic images
+    if (compute_potential_ && ewald_) {
+        return GRAVITY * particle.mass() * ewald_->self_potential(box_size_);
+    }
+    return 0.0;
+}
+
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::wrap_position(Vector& position) const noexcept {
+    for (int dim = 0; dim < Dim; ++dim) {
+        position[dim] -= box_size_ * std::floor(position[dim] / box_size_);
+        if (position[dim] >= box_size_) {
+            position[dim] = 0.0;
+        }
+    }
+}
+
+template <int Dim, typename Softening>
+typename BasicBarnesHutTree<Dim, Softening>::Node* BasicBarnesHutTree<Dim, Softening>::allocate_node() {
     if (current_node_index_ < node_pool_.size()) {
         auto* node = node_pool_[current_node_index_].get();
         node->reset();
@@ -403,24 +670,18 @@ Node* BarnesHutTree::allocate_node() {
     return node_ptr;
 }
 
-void BarnesHutTree::reset_node_pool() noexcept {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::reset_node_pool() noexcept {
     current_node_index_ = 0;
 }
 
-std::string BarnesHutTree::get_statistics_string() const {
-    std::ostringstream oss;
-    oss << "DirectForce: " << stats_.direct_force_count
-        << "; ParticleCell: " << stats_.particle_cell_interactions
-        << "; NodesUsed: " << stats_.nodes_used
-        << "; NodesAvailable: " << stats_.nodes_available
-        << "; TimeLoad: " << stats_.time_load
-        << "; TimeUpward: " << stats_.time_upward
-        << "; TimeForce: " << stats_.time_force
-        << "; TimeTotal: " << stats_.time_total;
-    return oss.str();
+template <int Dim, typename Softening>
+std::string BasicBarnesHutTree<Dim, Softening>::get_statistics_string() const {
+    return format_statistics(stats_, compute_potential_);
 }
 
-void BarnesHutTree::display_tree(const Node* node, std::ostream& os) const {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::display_tree(const Node* node, std::ostream& os) const {
     if (!node) {
         node = root_.get();
     }
@@ -432,9 +693,9 @@ void BarnesHutTree::display_tree(const Node* node, std::ostream& os) const {
 
     if (node->type == NodeType::Internal) {
         display_node(node, os);
-        for (int i = 0; i < NSUB; ++i) {
+        for (int i = 0; i < Node::subcells; ++i) {
             if (node->children[i] && node->children[i]->type != NodeType::Empty) {
-                display_tree(node->children[i].get(), os);
+                display_tree(node->children[i], os);
             }
         }
     }
@@ -443,7 +704,8 @@ void BarnesHutTree::display_tree(const Node* node, std::ostream& os) const {
     }
 }
 
-void BarnesHutTree::display_node(const Node* node, std::ostream& os) const {
+template <int Dim, typename Softening>
+void BasicBarnesHutTree<Dim, Softening>::display_node(const Node* node, std::ostream& os) const {
     os << std::fixed << std::setprecision(2);
     os << " Id=" << node->index
        << " L=" << node->level
@@ -471,4 +733,6 @@ void BarnesHutTree::display_node(const Node* node, std::ostream& os) const {
     }
 }
 
+BARNES_HUT_TREE_INSTANTIATIONS(template)
+
 } // namespace barnes_hut
@@ -2,6 +2,9 @@
 
 #include "particle.h"
 #include "vektor.h"
+#include "ewald.h"
+#include "softening.h"
+#include "solver.h"
 #include <vector>
 #include <memory>
 #include <string>
@@ -9,33 +12,84 @@
 
 namespace barnes_hut {
 
-// Modern Barnes-Hut tree class with CPU parallelization support
-class BarnesHutTree {
+// Modern Barnes-Hut tree class with CPU parallelization support.
+// Dim = 2 builds a quadtree, Dim = 3 an octree. Softening is the force-law
+// policy from softening.h; every combination is instantiated in tree.cpp.
+template <int Dim, typename Softening = PlummerSoftening>
+class BasicBarnesHutTree {
 public:
+    using Vector = BasicVector<Dim>;
+    using Node = BasicNode<Dim>;
+    using Particle = BasicParticle<Dim>;
+
+    static_assert(SofteningPolicy<Softening>);
+
+    static constexpr int dimension = Dim;
+
     // Constructor
-    BarnesHutTree(std::span<Particle> particles, Real timestep, Real theta, Index max_particles_per_leaf);
+    BasicBarnesHutTree(std::span<Particle> particles, Real timestep, Real theta, Index max_particles_per_leaf);
 
     // Rule of 5 - delete copy, default move
-    ~BarnesHutTree() = default;
-    BarnesHutTree(const BarnesHutTree&) = delete;
-    BarnesHutTree& operator=(const BarnesHutTree&) = delete;
-    BarnesHutTree(BarnesHutTree&&) noexcept = default;
-    BarnesHutTree& operator=(BarnesHutTree&&) noexcept = default;
+    ~BasicBarnesHutTree() = default;
+    BasicBarnesHutTree(const BasicBarnesHutTree&) = delete;
+    BasicBarnesHutTree& operator=(const BasicBarnesHutTree&) = delete;
+    BasicBarnesHutTree(BasicBarnesHutTree&&) noexcept = default;
+    BasicBarnesHutTree& operator=(BasicBarnesHutTree&&) noexcept = default;
 
     // Main simulation step
     void simulation_step();
 
+    // Periodic boundary conditions in the fixed box [0, box_size)^Dim.
+    // Distances use the minimum image; if an Ewald table is given (3D only),
+    // the contribution of all other images is added from the table.
+    void enable_periodic_boundaries(Real box_size, std::shared_ptr<const EwaldTable> ewald = nullptr);
+    [[nodiscard]] bool is_periodic() const noexcept { return box_size_ > 0.0; }
+
+    // Accumulate per-particle potentials during the walk and reduce the
+    // conserved quantities into Statistics while integrating
+    void set_compute_potential(bool enabled) noexcept { compute_potential_ = enabled; }
+    [[nodiscard]] bool computes_potential() const noexcept { return compute_potential_; }
+
+    // Opening angle, applied from the next upward pass
+    void set_theta(Real theta) noexcept { theta_ = theta; }
+    [[nodiscard]] Real theta() const noexcept { return theta_; }
+
+    // Deadline mode: after every step theta is rescaled so that, by the cost
+    // model of that step, the next one takes at most `seconds` (0: off).
+    // theta stays within [min_theta, max_theta], and below max_safe_theta().
+    void set_step_budget(double seconds, Real min_theta = 0.2, Real max_theta = 1.0) noexcept {
+        step_budget_ = seconds;
+        min_theta_ = min_theta;
+        max_theta_ = max_theta;
+    }
+    [[nodiscard]] double step_budget() const noexcept { return step_budget_; }
+
+    // Estimate the force error every `interval` steps (0: off): exact forces
+    // on `sample` evenly spaced particles against the step's tree forces, as
+    // in accuracy.h. Statistics::force_error keeps the latest percentile; the
+    // time is reported apart (time_error), so deadline mode does not count it.
+    // Not available with periodic boundaries.
+    void set_error_sampling(Index interval, Index sample = 100, double percentile = 99.0) noexcept {
+        error_interval_ = interval;
+        error_sample_ = sample;
+        error_percentile_ = percentile;
+    }
+
+    // Largest theta at which the opening criterion cannot accept a cell for
+    // a particle inside it: 1/sqrt(Dim) geometric, 2/sqrt(Dim) offset, 1 bmax
+    [[nodiscard]] Real max_safe_theta() const noexcept;
+
+    // Cell acceptance test of the walk, applied from the next upward pass
+    void set_opening_criterion(OpeningCriterion criterion) noexcept { opening_criterion_ = criterion; }
+    [[nodiscard]] OpeningCriterion opening_criterion() const noexcept { return opening_criterion_; }
+
+    // Global softening length h (per-particle policies use the largest of h
+    // and the lengths of the two interacting particles)
+    void set_softening_length(Real length) noexcept { softening_length_ = length; }
+    [[nodiscard]] Real softening_length() const noexcept { return softening_length_; }
+
     // Get statistics
-    struct Statistics {
-        Index direct_force_count = 0;
-        Index particle_cell_interactions = 0;
-        Index nodes_used = 0;
-        Index nodes_available = 0;
-        double time_load = 0.0;
-        double time_upward = 0.0;
-        double time_force = 0.0;
-        double time_total = 0.0;
-    };
+    using Statistics = SolverStatistics;
 
     [[nodiscard]] const Statistics& get_statistics() const noexcept { return stats_; }
     [[nodiscard]] std::string get_statistics_string() const;
@@ -43,32 +97,83 @@ public:
     // Clear tree for next iteration
     void clear_tree();
 
+    // Root of the tree the last simulation_step() built, until clear_tree()
+    [[nodiscard]] const Node* root() const noexcept { return root_.get(); }
+
     // Display tree (for debugging)
     void display_tree(const Node* node = nullptr, std::ostream& os = std::cout) const;
 
+    // The phases of simulation_step(), for benchmarks that time them one at
+    // a time: build_tree() (after clear_tree()), compute_mass_distribution(),
+    // calculate_forces(), then integrate_particles()
+    void build_tree();
+    void compute_mass_distribution();
+    void calculate_forces();
+    void integrate_particles();
+
+    // Single interactions of the walk: a cell's monopole, another particle
+    void particle_cell_interaction(Particle& particle, const Node& cell) const noexcept;
+    void direct_force_calculation(Particle& p1, const Particle& p2) const noexcept;
+
 private:
     // Tree construction
-    void find_bounding_box(Vector3D& center, Real& size) const;
-    void build_tree();
+    void find_bounding_box(Vector& center, Real& size) const;
     void insert_particle(Index particle_idx, Particle& particle, Node* node);
-    [[nodiscard]] int which_child(const Vector3D& position, const Node* node) const noexcept;
+    [[nodiscard]] int which_child(const Vector& position, const Node* node) const noexcept;
     void add_leaf(Index particle_idx, Particle& particle, Node* node, int child_idx);
     void convert_leaf_to_internal(Node* node, int child_idx);
 
+    // Deadline mode
+    void fit_theta_to_budget() noexcept;
+    void sample_force_error();
+
     // Tree traversal
-    void compute_mass_distribution();
     void compute_center_of_mass(Node* node);
+    [[nodiscard]] Real open_radius_squared(const Node& node) const noexcept;
 
     // Force calculation
-    void calculate_forces();
-    void calculate_forces_parallel();  // Parallel version
-    void interact(Particle& particle, const Node* node);
+    void calculate_forces_serial();
+    void calculate_forces_parallel();
+    // Interactions of one particle's walk, added to Statistics after the walks
+    struct WalkCounts {
+        Index particle_cell = 0;
+        Index direct = 0;
+    };
+
+    void interact(Particle& particle, const Node* node, WalkCounts& counts, bool ewald_pending = false);
     [[nodiscard]] bool is_well_separated(const Particle& particle, const Node& node) const noexcept;
-    void particle_cell_interaction(Particle& particle, const Node& cell);
-    void direct_force_calculation(Particle& p1, Particle& p2);
 
-    // Integration
-    void integrate_particles();
+    // Force law from the softening policy; kept in the class so it inlines into the walk
+    void accumulate(Particle& particle, const Vector& r_vec, Real source_mass, Real h) const noexcept {
+        const Real r_squared = r_vec.squared_magnitude();
+
+        if (compute_potential_) {
+            Real force_factor = 0.0;
+            Real potential_factor = 0.0;
+            Softening::evaluate(r_squared, h, force_factor, potential_factor);
+            particle.force() += (-GRAVITY * particle.mass() * source_mass * force_factor) * r_vec;
+            particle.potential() -= GRAVITY * source_mass * potential_factor;
+        }
+        else {
+            particle.force() += (-GRAVITY * particle.mass() * source_mass * Softening::force(r_squared, h)) * r_vec;
+        }
+    }
+
+    [[nodiscard]] Real interaction_softening(const Particle& particle, Real source_length) const noexcept {
+        if constexpr (Softening::per_particle) {
+            return std::max({softening_length_, particle.softening(), source_length});
+        }
+        else {
+            return softening_length_;
+        }
+    }
+
+    // Periodic helpers
+    [[nodiscard]] Vector separation(const Vector& a, const Vector& b) const noexcept;
+    [[nodiscard]] bool accepts_ewald_cell(const Particle& particle, const Node& node) const noexcept;
+    void apply_ewald_correction(Particle& particle, const Vector& r_vec, Real source_mass) const noexcept;
+    void wrap_position(Vector& position) const noexcept;
+    [[nodiscard]] Real self_potential(const Particle& particle) const noexcept;
 
     // Node management
     [[nodiscard]] Node* allocate_node();
@@ -81,7 +186,17 @@ private:
     std::span<Particle> particles_;
     Real dt_;
     Real theta_;
+    double step_budget_ = 0.0;
+    Real min_theta_ = 0.2;
+    Real max_theta_ = 1.0;
+    Index error_interval_ = 0;
+    Index error_sample_ = 100;
+    double error_percentile_ = 99.0;
+    double force_error_ = 0.0;
+    Index steps_ = 0;
+    OpeningCriterion opening_criterion_;
     Index max_particles_per_leaf_;
+    Real softening_length_;
 
     std::unique_ptr<Node> root_;
     std::vector<std::unique_ptr<Node>> node_pool_;
@@ -89,6 +204,32 @@ private:
 
     Statistics stats_;
     Index max_tree_level_;
+
+    // Largest cell (relative to the box) that receives a single Ewald correction
+    static constexpr Real EWALD_CELL_FRACTION = 0.125;
+
+    Real box_size_;  // > 0 when periodic
+    std::shared_ptr<const EwaldTable> ewald_;
+
+    bool compute_potential_;
 };
 
+#define BARNES_HUT_TREE_INSTANTIATIONS(PREFIX)                                 \
+    PREFIX class BasicBarnesHutTree<2, PlummerSoftening>;                      \
+    PREFIX class BasicBarnesHutTree<2, SplineSoftening>;                       \
+    PREFIX class BasicBarnesHutTree<2, NoSoftening>;                           \
+    PREFIX class BasicBarnesHutTree<2, PerParticleSoftening<PlummerSoftening>>; \
+    PREFIX class BasicBarnesHutTree<2, PerParticleSoftening<SplineSoftening>>; \
+    PREFIX class BasicBarnesHutTree<3, PlummerSoftening>;                      \
+    PREFIX class BasicBarnesHutTree<3, SplineSoftening>;                       \
+    PREFIX class BasicBarnesHutTree<3, NoSoftening>;                           \
+    PREFIX class BasicBarnesHutTree<3, PerParticleSoftening<PlummerSoftening>>; \
+    PREFIX class BasicBarnesHutTree<3, PerParticleSoftening<SplineSoftening>>;
+
+BARNES_HUT_TREE_INSTANTIATIONS(extern template)
+
+using BarnesHutTree2D = BasicBarnesHutTree<2>;
+using BarnesHutTree3D = BasicBarnesHutTree<3>;
+using BarnesHutTree = BasicBarnesHutTree<NDIM>;
+
 } // namespace barnes_hut
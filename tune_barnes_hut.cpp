@@ -0,0 +1,289 @@
+/**
+ * Barnes-Hut Auto-Tuner
+ * Searches opening angle, leaf size and opening criterion for the fastest
+ * step on a representative input whose sampled force error stays within a
+ * percentile bound, and writes the result as a barnes_hut_sim settings file
+ */
+
+#include "accuracy.h"
+#include "benchmark.h"
+#include "binary_file.h"
+#include "file.h"
+#include "initial_conditions.h"
+#include "tree.h"
+#include "tuning.h"
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace barnes_hut;
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " <input> [options]\n"
+              << "  input: Particle file (text or binary), or <model>:<count> for generated\n"
+              << "         uniform, plummer, hernquist, disk or clustered initial conditions\n"
+              << "\nOptions (lists are comma-separated):\n"
+              << "  --error <e>         Bound on the relative force error [default: 0.01]\n"
+              << "  --percentile <q>    Percentile of the sampled errors held to the bound [default: 99]\n"
+              << "  --theta <list>      Opening angles [default: 1.0,0.9,0.8,0.7,0.6,0.5,0.45,0.4,0.35,0.3,0.25,0.2]\n"
+              << "  --leaf <list>       Max particles per leaf [default: 1,4,8,16,32]\n"
+              << "  --mac <list>        Opening criteria: geometric, offset, bmax\n"
+              << "                      [default: geometric,offset,bmax]\n"
+              << "  --sample <k>        Particles whose errors are measured, 0 = all [default: 4096]\n"
+              << "  --dim <2|3>         Spatial dimension [default: 3, or binary file's]\n"
+              << "  --softening <name>  plummer, spline or none [default: plummer]\n"
+              << "  --softening-length <h> Softening length [default: the policy's]\n"
+              << "  --repeat <n>        Timed steps per setting [default: 3]\n"
+              << "  --output <file>     Settings file for barnes_hut_sim --config [default: tuned.cfg]\n"
+              << "\nErrors are |F_tree - F_exact| / |F_exact| against direct summation in long\n"
+              << "double on the sampled particles. The time is a full step (build, upward pass,\n"
+              << "force walk, integration) on all threads, so tune on the production machine.\n"
+              << "\nExample:\n"
+              << "  " << program_name << " data.bin --error 1e-3 --percentile 99.9 --output tuned.cfg\n"
+              << "  barnes_hut_sim data.bin --config tuned.cfg\n";
+}
+
+struct TuneOptions {
+    std::string input;
+    std::optional<InitialConditions> generate;  // Instead of reading input
+    double error_bound = 0.01;
+    double percentile = 99.0;
+    std::vector<Real> thetas{1.0, 0.9, 0.8, 0.7, 0.6, 0.5, 0.45, 0.4, 0.35, 0.3, 0.25, 0.2};
+    std::vector<Index> leaf_sizes{1, 4, 8, 16, 32};
+    std::vector<OpeningCriterion> criteria{OpeningCriterion::Geometric, OpeningCriterion::Offset,
+                                           OpeningCriterion::MaxDistance};
+    Index sample = 4096;
+    int dimension = NDIM;
+    std::string softening = "plummer";
+    Real softening_length = -1.0;  // < 0: the policy's default
+    int repetitions = 3;
+    std::string output = "tuned.cfg";
+};
+
+// The fastest theta meeting the bound for one leaf size and criterion
+struct Candidate {
+    TunedSettings settings;
+    double error = 0.0;
+    double seconds = 0.0;  // Fastest step
+};
+
+template <int Dim>
+std::optional<std::vector<BasicParticle<Dim>>> load_particles(const TuneOptions& options) {
+    if (options.generate) {
+        return generate_particles<Dim>(*options.generate);
+    }
+    const auto config = read_config_file(options.input);
+    if (!config) {
+        return std::nullopt;
+    }
+    return read_particle_file<Dim>(options.input, *config);
+}
+
+template <int Dim, typename Softening>
+int tune(const TuneOptions& options) {
+    auto loaded = load_particles<Dim>(options);
+    if (!loaded || loaded->empty()) {
+        std::cerr << "Error: No particles in " << options.input << "\n";
+        return 1;
+    }
+    auto& particles = *loaded;
+    const Index n = particles.size();
+
+    const Real softening_length = (options.softening_length >= 0.0) ? options.softening_length
+                                                                      : Softening::default_length;
+    const double quantile_level = options.percentile / 100.0;
+
+    const auto targets = sample_targets(n, options.sample);
+    std::cerr << "tune: N=" << n << ", exact forces on " << targets.size() << " particles\n";
+    const auto exact = reference_forces<Dim, Softening>(particles, targets, softening_length);
+
+    // Thetas largest (cheapest) first: for each leaf size and criterion the
+    // first theta within the bound is the fastest, and smaller ones are skipped
+    std::vector<Real> thetas = options.thetas;
+    std::sort(thetas.begin(), thetas.end(), std::greater<>());
+
+    std::vector<Candidate> candidates;
+    for (const Index leaf : options.leaf_sizes) {
+        for (const OpeningCriterion criterion : options.criteria) {
+            for (const Real theta : thetas) {
+                // A zero time step leaves the particles (and so every step) unchanged
+                BasicBarnesHutTree<Dim, Softening> tree(particles, 0.0, theta, leaf);
+                tree.set_softening_length(softening_length);
+                tree.set_opening_criterion(criterion);
+
+                tree.simulation_step();
+                tree.clear_tree();
+                const double error = quantile(relative_force_errors<Dim>(particles, targets, exact), quantile_level);
+                std::cerr << "tune: leaf=" << leaf << " mac=" << to_string(criterion) << " theta=" << theta
+                          << " error=" << error << "\n";
+                if (error > options.error_bound) {
+                    continue;
+                }
+
+                const auto seconds = time_repeated(options.repetitions, [&] {
+                    tree.simulation_step();
+                    tree.clear_tree();
+                });
+
+                Candidate candidate;
+                candidate.settings.theta = theta;
+                candidate.settings.particles_per_leaf = leaf;
+                candidate.settings.opening_criterion = criterion;
+                candidate.settings.softening = std::string(Softening::name);
+                candidate.settings.softening_length = softening_length;
+                candidate.settings.backend = "tree";  // Only the tree was timed; auto could pick direct
+                candidate.error = error;
+                candidate.seconds = *std::min_element(seconds.begin(), seconds.end());
+                candidates.push_back(candidate);
+                break;
+            }
+        }
+    }
+
+    if (candidates.empty()) {
+        std::cerr << "Error: No setting reaches a p" << options.percentile << " error of " << options.error_bound
+                  << "; add smaller --theta values\n";
+        return 1;
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.seconds < b.seconds;
+    });
+
+    std::cout << "Fastest settings within p" << options.percentile << " error " << options.error_bound
+              << " (N=" << n << ", " << benchmark_threads() << " threads):\n"
+              << "  leaf  mac        theta  error        s/step\n";
+    for (const auto& candidate : candidates) {
+        std::cout << "  " << std::left << std::setw(6) << candidate.settings.particles_per_leaf
+                  << std::setw(11) << to_string(candidate.settings.opening_criterion)
+                  << std::setw(7) << candidate.settings.theta
+                  << std::setw(13) << candidate.error
+                  << candidate.seconds << std::right << "\n";
+    }
+
+    const auto& best = candidates.front();
+    std::ostringstream comment;
+    comment << "tune_barnes_hut " << options.input << " (N=" << n << ", " << Dim << "D, "
+            << benchmark_threads() << " threads)\n"
+            << "p" << options.percentile << " relative force error " << best.error << " <= " << options.error_bound
+            << ", " << best.seconds << " s per step";
+    if (!write_tuned_settings(options.output, best.settings, comment.str())) {
+        return 1;
+    }
+    std::cout << "Wrote settings to: " << options.output << "\n";
+    return 0;
+}
+
+// Pick the force-law instantiation named on the command line
+template <int Dim>
+int tune_with_softening(const TuneOptions& options) {
+    if (options.softening == SplineSoftening::name) {
+        return tune<Dim, SplineSoftening>(options);
+    }
+    if (options.softening == NoSoftening::name) {
+        return tune<Dim, NoSoftening>(options);
+    }
+    return tune<Dim, PlummerSoftening>(options);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h") {
+        print_usage(argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+
+    TuneOptions options;
+    options.input = argv[1];
+    bool dimension_given = false;
+
+    // <model>:<count> generates the input instead of reading a file
+    const auto colon = options.input.find(':');
+    if (colon != std::string::npos) {
+        if (const auto model = parse_initial_model(std::string_view(options.input).substr(0, colon))) {
+            options.generate = InitialConditions{};
+            options.generate->model = *model;
+            options.generate->particle_count = std::stoull(options.input.substr(colon + 1));
+        }
+    }
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        bool valid = true;
+
+        if (arg == "--error" && i + 1 < argc) {
+            options.error_bound = std::stod(argv[++i]);
+            valid = options.error_bound > 0.0;
+        }
+        else if (arg == "--percentile" && i + 1 < argc) {
+            options.percentile = std::stod(argv[++i]);
+            valid = options.percentile > 0.0 && options.percentile <= 100.0;
+        }
+        else if (arg == "--theta" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.thetas, [](const std::string& item) {
+                const Real theta = std::stod(item);
+                return theta > 0.0 ? std::optional<Real>(theta) : std::nullopt;
+            });
+        }
+        else if (arg == "--leaf" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.leaf_sizes, [](const std::string& item) {
+                const Index leaf = std::stoull(item);
+                return leaf > 0 ? std::optional<Index>(leaf) : std::nullopt;
+            });
+        }
+        else if (arg == "--mac" && i + 1 < argc) {
+            valid = parse_list(argv[++i], options.criteria, [](const std::string& item) {
+                return parse_opening_criterion(item);
+            });
+        }
+        else if (arg == "--sample" && i + 1 < argc) {
+            options.sample = std::stoull(argv[++i]);
+        }
+        else if (arg == "--dim" && i + 1 < argc) {
+            options.dimension = std::stoi(argv[++i]);
+            valid = options.dimension == 2 || options.dimension == 3;
+            dimension_given = true;
+        }
+        else if (arg == "--softening" && i + 1 < argc) {
+            options.softening = argv[++i];
+            valid = options.softening == PlummerSoftening::name || options.softening == SplineSoftening::name ||
+                    options.softening == NoSoftening::name;
+        }
+        else if (arg == "--softening-length" && i + 1 < argc) {
+            options.softening_length = std::stod(argv[++i]);
+            valid = options.softening_length >= 0.0;
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            options.repetitions = std::stoi(argv[++i]);
+            valid = options.repetitions > 0;
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        }
+        else {
+            std::cerr << "Error: Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        if (!valid) {
+            std::cerr << "Error: Invalid value for " << arg << ": " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    // A binary file knows its dimension
+    if (!options.generate && !dimension_given && is_binary_particle_file(options.input)) {
+        const auto file = BinaryParticleFile::open(options.input);
+        if (!file) {
+            return 1;
+        }
+        options.dimension = file->dimension();
+    }
+
+    return (options.dimension == 2) ? tune_with_softening<2>(options) : tune_with_softening<3>(options);
+}
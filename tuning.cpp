@@ -0,0 +1,143 @@
+#include "tuning.h"
+#include "softening.h"
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace barnes_hut {
+
+namespace {
+
+std::string_view trim(std::string_view text) noexcept {
+    const auto first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    const auto last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// Whole of text as a number; std::nullopt if anything is left over
+template <typename T>
+std::optional<T> parse_number(std::string_view text) {
+    std::istringstream stream{std::string(text)};
+    T value{};
+    if (!(stream >> value) || !(stream >> std::ws).eof()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+} // namespace
+
+std::optional<TunedSettings> read_tuned_settings(std::string_view filename) {
+    std::ifstream infile{std::string(filename)};
+    if (!infile) {
+        std::cerr << "Error: Could not open settings file: " << filename << "\n";
+        return std::nullopt;
+    }
+
+    TunedSettings settings;
+    bool have_theta = false;
+    bool have_leaf = false;
+
+    std::string line;
+    for (Index line_number = 1; std::getline(infile, line); ++line_number) {
+        const std::string_view content = trim(std::string_view(line).substr(0, line.find('#')));
+        if (content.empty()) {
+            continue;
+        }
+
+        const auto equals = content.find('=');
+        const std::string_view key = trim(content.substr(0, equals));
+        const std::string_view value = (equals == std::string_view::npos) ? std::string_view{}
+                                                                          : trim(content.substr(equals + 1));
+        bool valid = !value.empty();
+
+        if (key == "theta") {
+            const auto theta = parse_number<Real>(value);
+            valid = valid && theta && *theta > 0.0;
+            settings.theta = theta.value_or(settings.theta);
+            have_theta = true;
+        }
+        else if (key == "particles_per_leaf") {
+            const auto leaf = parse_number<Index>(value);
+            valid = valid && leaf && *leaf > 0 && value.front() != '-';
+            settings.particles_per_leaf = leaf.value_or(settings.particles_per_leaf);
+            have_leaf = true;
+        }
+        else if (key == "mac") {
+            const auto criterion = parse_opening_criterion(value);
+            valid = valid && criterion;
+            settings.opening_criterion = criterion.value_or(settings.opening_criterion);
+        }
+        else if (key == "softening") {
+            valid = valid && (value == PlummerSoftening::name || value == SplineSoftening::name ||
+                              value == NoSoftening::name);
+            settings.softening = value;
+        }
+        else if (key == "backend") {
+            valid = valid && (value == "auto" || value == "tree" || value == "direct");
+            settings.backend = value;
+        }
+        else if (key == "softening_length") {
+            const auto length = parse_number<Real>(value);
+            valid = valid && length && *length >= 0.0;
+            settings.softening_length = length.value_or(settings.softening_length);
+        }
+        else {
+            std::cerr << "Error: " << filename << ":" << line_number << ": Unknown setting: " << key << "\n";
+            return std::nullopt;
+        }
+
+        if (!valid) {
+            std::cerr << "Error: " << filename << ":" << line_number << ": Invalid value for " << key << "\n";
+            return std::nullopt;
+        }
+    }
+
+    if (!have_theta || !have_leaf) {
+        std::cerr << "Error: " << filename << " must set theta and particles_per_leaf\n";
+        return std::nullopt;
+    }
+    return settings;
+}
+
+bool write_tuned_settings(std::string_view filename, const TunedSettings& settings, std::string_view comment) {
+    std::ofstream outfile{std::string(filename)};
+    if (!outfile) {
+        std::cerr << "Error: Could not create settings file: " << filename << "\n";
+        return false;
+    }
+
+    while (!comment.empty()) {
+        const auto newline = comment.find('\n');
+        outfile << "# " << comment.substr(0, newline) << "\n";
+        comment = (newline == std::string_view::npos) ? std::string_view{} : comment.substr(newline + 1);
+    }
+
+    // Shortest round-trip form: --config reproduces the tuned values exactly
+    auto exact = [](Real value) {
+        char text[32];
+        const auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+        return std::string(text, end);
+    };
+
+    outfile << "theta = " << exact(settings.theta) << "\n"
+            << "particles_per_leaf = " << settings.particles_per_leaf << "\n"
+            << "mac = " << to_string(settings.opening_criterion) << "\n"
+            << "softening = " << settings.softening << "\n"
+            << "backend = " << settings.backend << "\n";
+    if (settings.softening_length >= 0.0) {
+        outfile << "softening_length = " << exact(settings.softening_length) << "\n";
+    }
+
+    if (!outfile) {
+        std::cerr << "Error: Failed writing settings file: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace barnes_hut
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "solver.h"
+#include "stdinc.h"
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace barnes_hut {
+
+// Tree force settings found by tune_barnes_hut, read by barnes_hut_sim --config.
+//
+// File format: one "key = value" per line, '#' starts a comment:
+//   theta                opening angle (> 0)
+//   particles_per_leaf   max particles per leaf (> 0)
+//   mac                  opening criterion: geometric, offset or bmax
+//   softening            force law: plummer, spline or none
+//   softening_length     softening length (>= 0)
+// theta and particles_per_leaf are required, the rest default as on the
+// command line.
+struct TunedSettings {
+    Real theta = 0.5;
+    Index particles_per_leaf = 1;
+    OpeningCriterion opening_criterion = OpeningCriterion::Geometric;
+    std::string softening = "plummer";
+    Real softening_length = -1.0;  // < 0: the policy's default
+    std::string backend = "auto";  // auto, tree or direct; the tuner writes tree, the backend it timed
+};
+
+// std::nullopt (with a message naming the line) if the file cannot be read
+// or holds an unknown key or invalid value
+[[nodiscard]] std::optional<TunedSettings> read_tuned_settings(std::string_view filename);
+
+// Write settings, preceded by comment (one "# " line per line of comment)
+bool write_tuned_settings(std::string_view filename, const TunedSettings& settings, std::string_view comment = {});
+
+} // namespace barnes_hut
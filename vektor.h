@@ -7,15 +7,24 @@
 
 namespace barnes_hut {
 
-// Modern 3D vector class with C++20 features
-class Vector3D {
+// Fixed-size vector of Dim reals (Dim = 2 or 3) with C++20 features
+template <int Dim>
+class BasicVector {
+    static_assert(Dim == 2 || Dim == 3, "BasicVector supports 2 and 3 dimensions");
+
 public:
+    static constexpr int dimension = Dim;
+
     // Constructors
-    constexpr Vector3D() noexcept : data_{0.0, 0.0, 0.0} {}
+    constexpr BasicVector() noexcept : data_{} {}
 
-    constexpr explicit Vector3D(Real value) noexcept : data_{value, value, value} {}
+    constexpr explicit BasicVector(Real value) noexcept {
+        data_.fill(value);
+    }
 
-    constexpr Vector3D(Real x, Real y, Real z) noexcept : data_{x, y, z} {}
+    constexpr BasicVector(Real x, Real y) noexcept requires (Dim == 2) : data_{x, y} {}
+
+    constexpr BasicVector(Real x, Real y, Real z) noexcept requires (Dim == 3) : data_{x, y, z} {}
 
     // Modern accessors with bounds checking in debug mode
     [[nodiscard]] constexpr Real& operator[](std::size_t i) noexcept {
@@ -28,127 +37,102 @@ public:
 
     [[nodiscard]] constexpr Real& x() noexcept { return data_[0]; }
     [[nodiscard]] constexpr Real& y() noexcept { return data_[1]; }
-    [[nodiscard]] constexpr Real& z() noexcept { return data_[2]; }
+    [[nodiscard]] constexpr Real& z() noexcept requires (Dim == 3) { return data_[2]; }
 
     [[nodiscard]] constexpr Real x() const noexcept { return data_[0]; }
     [[nodiscard]] constexpr Real y() const noexcept { return data_[1]; }
-    [[nodiscard]] constexpr Real z() const noexcept { return data_[2]; }
+    [[nodiscard]] constexpr Real z() const noexcept requires (Dim == 3) { return data_[2]; }
 
     // Unary operators
-    [[nodiscard]] constexpr Vector3D operator-() const noexcept {
-        return Vector3D{-data_[0], -data_[1], -data_[2]};
+    [[nodiscard]] constexpr BasicVector operator-() const noexcept {
+        return generate([&](int k) { return -data_[k]; });
     }
 
     // Dot product
-    [[nodiscard]] constexpr Real dot(const Vector3D& other) const noexcept {
-        return data_[0] * other.data_[0] +
-               data_[1] * other.data_[1] +
-               data_[2] * other.data_[2];
+    [[nodiscard]] constexpr Real dot(const BasicVector& other) const noexcept {
+        Real sum = 0.0;
+        for (int k = 0; k < Dim; ++k) sum += data_[k] * other.data_[k];
+        return sum;
     }
 
-    [[nodiscard]] constexpr Real operator*(const Vector3D& other) const noexcept {
+    [[nodiscard]] constexpr Real operator*(const BasicVector& other) const noexcept {
         return dot(other);
     }
 
     // Cross product
-    [[nodiscard]] constexpr Vector3D cross(const Vector3D& other) const noexcept {
-        return Vector3D{
+    [[nodiscard]] constexpr BasicVector cross(const BasicVector& other) const noexcept requires (Dim == 3) {
+        return BasicVector{
             data_[1] * other.data_[2] - data_[2] * other.data_[1],
             data_[2] * other.data_[0] - data_[0] * other.data_[2],
             data_[0] * other.data_[1] - data_[1] * other.data_[0]
         };
     }
 
+    // Planar cross product (z component of the 3D cross product)
+    [[nodiscard]] constexpr Real cross(const BasicVector& other) const noexcept requires (Dim == 2) {
+        return data_[0] * other.data_[1] - data_[1] * other.data_[0];
+    }
+
     // Vector addition
-    [[nodiscard]] constexpr Vector3D operator+(const Vector3D& other) const noexcept {
-        return Vector3D{
-            data_[0] + other.data_[0],
-            data_[1] + other.data_[1],
-            data_[2] + other.data_[2]
-        };
+    [[nodiscard]] constexpr BasicVector operator+(const BasicVector& other) const noexcept {
+        return generate([&](int k) { return data_[k] + other.data_[k]; });
     }
 
     // Vector subtraction
-    [[nodiscard]] constexpr Vector3D operator-(const Vector3D& other) const noexcept {
-        return Vector3D{
-            data_[0] - other.data_[0],
-            data_[1] - other.data_[1],
-            data_[2] - other.data_[2]
-        };
+    [[nodiscard]] constexpr BasicVector operator-(const BasicVector& other) const noexcept {
+        return generate([&](int k) { return data_[k] - other.data_[k]; });
     }
 
     // Scalar multiplication
-    [[nodiscard]] constexpr Vector3D operator*(Real scalar) const noexcept {
-        return Vector3D{
-            data_[0] * scalar,
-            data_[1] * scalar,
-            data_[2] * scalar
-        };
+    [[nodiscard]] constexpr BasicVector operator*(Real scalar) const noexcept {
+        return generate([&](int k) { return data_[k] * scalar; });
     }
 
-    friend constexpr Vector3D operator*(Real scalar, const Vector3D& vec) noexcept {
+    friend constexpr BasicVector operator*(Real scalar, const BasicVector& vec) noexcept {
         return vec * scalar;
     }
 
     // Scalar division
-    [[nodiscard]] constexpr Vector3D operator/(Real scalar) const noexcept {
-        return Vector3D{
-            data_[0] / scalar,
-            data_[1] / scalar,
-            data_[2] / scalar
-        };
+    [[nodiscard]] constexpr BasicVector operator/(Real scalar) const noexcept {
+        return generate([&](int k) { return data_[k] / scalar; });
     }
 
     // Scalar addition
-    [[nodiscard]] constexpr Vector3D operator+(Real scalar) const noexcept {
-        return Vector3D{
-            data_[0] + scalar,
-            data_[1] + scalar,
-            data_[2] + scalar
-        };
+    [[nodiscard]] constexpr BasicVector operator+(Real scalar) const noexcept {
+        return generate([&](int k) { return data_[k] + scalar; });
     }
 
-    friend constexpr Vector3D operator+(Real scalar, const Vector3D& vec) noexcept {
+    friend constexpr BasicVector operator+(Real scalar, const BasicVector& vec) noexcept {
         return vec + scalar;
     }
 
     // Compound assignment operators
-    constexpr Vector3D& operator+=(const Vector3D& other) noexcept {
-        data_[0] += other.data_[0];
-        data_[1] += other.data_[1];
-        data_[2] += other.data_[2];
+    constexpr BasicVector& operator+=(const BasicVector& other) noexcept {
+        for (int k = 0; k < Dim; ++k) data_[k] += other.data_[k];
         return *this;
     }
 
-    constexpr Vector3D& operator-=(const Vector3D& other) noexcept {
-        data_[0] -= other.data_[0];
-        data_[1] -= other.data_[1];
-        data_[2] -= other.data_[2];
+    constexpr BasicVector& operator-=(const BasicVector& other) noexcept {
+        for (int k = 0; k < Dim; ++k) data_[k] -= other.data_[k];
         return *this;
     }
 
-    constexpr Vector3D& operator*=(Real scalar) noexcept {
-        data_[0] *= scalar;
-        data_[1] *= scalar;
-        data_[2] *= scalar;
+    constexpr BasicVector& operator*=(Real scalar) noexcept {
+        for (int k = 0; k < Dim; ++k) data_[k] *= scalar;
         return *this;
     }
 
-    constexpr Vector3D& operator/=(Real scalar) noexcept {
-        data_[0] /= scalar;
-        data_[1] /= scalar;
-        data_[2] /= scalar;
+    constexpr BasicVector& operator/=(Real scalar) noexcept {
+        for (int k = 0; k < Dim; ++k) data_[k] /= scalar;
         return *this;
     }
 
     // Comparison operators
-    [[nodiscard]] constexpr bool operator==(const Vector3D& other) const noexcept {
-        return data_[0] == other.data_[0] &&
-               data_[1] == other.data_[1] &&
-               data_[2] == other.data_[2];
+    [[nodiscard]] constexpr bool operator==(const BasicVector& other) const noexcept {
+        return data_ == other.data_;
     }
 
-    [[nodiscard]] constexpr bool operator!=(const Vector3D& other) const noexcept {
+    [[nodiscard]] constexpr bool operator!=(const BasicVector& other) const noexcept {
         return !(*this == other);
     }
 
@@ -162,21 +146,18 @@ public:
     }
 
     // Distance functions
-    [[nodiscard]] constexpr Real squared_distance(const Vector3D& other) const noexcept {
-        const Real dx = data_[0] - other.data_[0];
-        const Real dy = data_[1] - other.data_[1];
-        const Real dz = data_[2] - other.data_[2];
-        return dx * dx + dy * dy + dz * dz;
+    [[nodiscard]] constexpr Real squared_distance(const BasicVector& other) const noexcept {
+        return (*this - other).squared_magnitude();
     }
 
-    [[nodiscard]] Real distance(const Vector3D& other) const noexcept {
+    [[nodiscard]] Real distance(const BasicVector& other) const noexcept {
         return std::sqrt(squared_distance(other));
     }
 
     // Normalization
-    [[nodiscard]] Vector3D normalized() const noexcept {
+    [[nodiscard]] BasicVector normalized() const noexcept {
         const Real mag = magnitude();
-        if (mag < 1e-10) return Vector3D{0.0};
+        if (mag < 1e-10) return BasicVector{0.0};
         return *this / mag;
     }
 
@@ -185,34 +166,64 @@ public:
     }
 
     // Stream operators
-    friend std::ostream& operator<<(std::ostream& os, const Vector3D& vec) {
-        return os << vec.data_[0] << "  " << vec.data_[1] << "  " << vec.data_[2];
+    friend std::ostream& operator<<(std::ostream& os, const BasicVector& vec) {
+        os << vec.data_[0];
+        for (int k = 1; k < Dim; ++k) os << "  " << vec.data_[k];
+        return os;
     }
 
-    friend std::istream& operator>>(std::istream& is, Vector3D& vec) {
-        return is >> vec.data_[0] >> vec.data_[1] >> vec.data_[2];
+    friend std::istream& operator>>(std::istream& is, BasicVector& vec) {
+        for (int k = 0; k < Dim; ++k) is >> vec.data_[k];
+        return is;
     }
 
     // Print method
     void print(std::ostream& os = std::cout) const {
-        os << data_[0] << " " << data_[1] << " " << data_[2] << " ";
+        for (int k = 0; k < Dim; ++k) os << data_[k] << " ";
     }
 
     // Direct access to underlying data (for potential SIMD optimization)
-    [[nodiscard]] constexpr const std::array<Real, 3>& data() const noexcept {
+    [[nodiscard]] constexpr const std::array<Real, Dim>& data() const noexcept {
         return data_;
     }
 
-    [[nodiscard]] constexpr std::array<Real, 3>& data() noexcept {
+    [[nodiscard]] constexpr std::array<Real, Dim>& data() noexcept {
         return data_;
     }
 
 private:
-    alignas(32) std::array<Real, 3> data_;  // Aligned for SIMD operations
+    // Build a vector from per-component values through the scalar
+    // constructors, which keeps temporaries in registers
+    template <typename F>
+    [[nodiscard]] static constexpr BasicVector generate(F&& component) noexcept {
+        if constexpr (Dim == 2) {
+            return BasicVector{component(0), component(1)};
+        }
+        else {
+            return BasicVector{component(0), component(1), component(2)};
+        }
+    }
+
+    alignas(Dim == 3 ? 32 : 16) std::array<Real, Dim> data_;  // Aligned for SIMD operations
 };
 
+using Vector2D = BasicVector<2>;
+using Vector3D = BasicVector<3>;
+
+// Embed a vector in 3D (z = 0 for planar vectors), e.g. for diagnostics
+template <int Dim>
+[[nodiscard]] constexpr Vector3D to_3d(const BasicVector<Dim>& v) noexcept {
+    if constexpr (Dim == 3) {
+        return v;
+    }
+    else {
+        return Vector3D{v[0], v[1], 0.0};
+    }
+}
+
 // Utility functions
-[[nodiscard]] inline constexpr Real dot(const Vector3D& a, const Vector3D& b) noexcept {
+template <int Dim>
+[[nodiscard]] constexpr Real dot(const BasicVector<Dim>& a, const BasicVector<Dim>& b) noexcept {
     return a.dot(b);
 }
 
@@ -220,19 +231,23 @@ private:
     return a.cross(b);
 }
 
-[[nodiscard]] inline constexpr Real squared_magnitude(const Vector3D& v) noexcept {
+template <int Dim>
+[[nodiscard]] constexpr Real squared_magnitude(const BasicVector<Dim>& v) noexcept {
     return v.squared_magnitude();
 }
 
-[[nodiscard]] inline Real magnitude(const Vector3D& v) noexcept {
+template <int Dim>
+[[nodiscard]] Real magnitude(const BasicVector<Dim>& v) noexcept {
     return v.magnitude();
 }
 
-[[nodiscard]] inline constexpr Real squared_distance(const Vector3D& a, const Vector3D& b) noexcept {
+template <int Dim>
+[[nodiscard]] constexpr Real squared_distance(const BasicVector<Dim>& a, const BasicVector<Dim>& b) noexcept {
     return a.squared_distance(b);
 }
 
-[[nodiscard]] inline Real distance(const Vector3D& a, const Vector3D& b) noexcept {
+template <int Dim>
+[[nodiscard]] Real distance(const BasicVector<Dim>& a, const BasicVector<Dim>& b) noexcept {
     return a.distance(b);
 }
 
@@ -76,6 +76,39 @@ __global__ void prepare_vertices_kernel(
     vertices[idx].a = 1.0f;
 }
 
+/**
+ * @brief Convert snapshot arrays to vertex data with color mapping
+ */
+__global__ void prepare_snapshot_vertices_kernel(
+    const float* positions,
+    const float* speed,
+    const float* force,
+    CudaRenderer::VertexData* vertices,
+    size_t count,
+    CudaRenderer::Config config
+) {
+    const size_t idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if (idx >= count) return;
+
+    vertices[idx].x = positions[3 * idx];
+    vertices[idx].y = positions[3 * idx + 1];
+    vertices[idx].z = positions[3 * idx + 2];
+
+    float3 color;
+    if (config.color_by_velocity) {
+        color = color::velocity_to_color(speed[idx] * config.velocity_scale, config.max_velocity);
+    } else if (config.color_by_force) {
+        color = color::force_to_color(force[idx] * config.force_scale, config.max_force);
+    } else {
+        color = make_float3(1.0f, 1.0f, 1.0f);
+    }
+
+    vertices[idx].r = color.x;
+    vertices[idx].g = color.y;
+    vertices[idx].b = color.z;
+    vertices[idx].a = 1.0f;
+}
+
 /**
  * @brief Compute velocity statistics using parallel reduction
  */
@@ -150,6 +183,25 @@ void prepare_particle_vertices(
     CUDA_CHECK_VOID(cudaGetLastError());
 }
 
+void prepare_snapshot_vertices(
+    const float* positions,
+    const float* speed,
+    const float* force,
+    CudaRenderer::VertexData* vertices,
+    size_t count,
+    const CudaRenderer::Config& config,
+    cudaStream_t stream
+) {
+    const int threads = 256;
+    const int blocks = (count + threads - 1) / threads;
+
+    prepare_snapshot_vertices_kernel<<<blocks, threads, 0, stream>>>(
+        positions, speed, force, vertices, count, config
+    );
+
+    CUDA_CHECK_VOID(cudaGetLastError());
+}
+
 void compute_velocity_statistics(
     const barnes_hut::Particle* particles,
     size_t count,
@@ -184,6 +236,7 @@ void compute_velocity_statistics(
 
 CudaRenderer::CudaRenderer()
     : d_particles_(nullptr)
+    , d_snapshot_(nullptr)
     , cuda_vbo_resource_(nullptr)
     , stream_(nullptr)
     , particle_count_(0)
@@ -329,6 +382,62 @@ bool CudaRenderer::update_particles(
     return true;
 }
 
+bool CudaRenderer::update_snapshot(
+    const float* positions,
+    const float* speed,
+    const float* force,
+    size_t count,
+    const Config& config
+) {
+    if (!initialized_ || !cuda_vbo_resource_) {
+        return false;
+    }
+
+    cudaEvent_t start, stop;
+    CUDA_CHECK(cudaEventCreate(&start));
+    CUDA_CHECK(cudaEventCreate(&stop));
+    CUDA_CHECK(cudaEventRecord(start, stream_));
+
+    config_ = config;
+
+    // Copy the snapshot arrays to device: positions, then speed, then force
+    float* d_positions = d_snapshot_;
+    float* d_speed = d_positions + 3 * particle_count_;
+    float* d_force = d_speed + particle_count_;
+    CUDA_CHECK(cudaMemcpyAsync(d_positions, positions, 3 * count * sizeof(float), cudaMemcpyHostToDevice, stream_));
+    CUDA_CHECK(cudaMemcpyAsync(d_speed, speed, count * sizeof(float), cudaMemcpyHostToDevice, stream_));
+    CUDA_CHECK(cudaMemcpyAsync(d_force, force, count * sizeof(float), cudaMemcpyHostToDevice, stream_));
+
+    // Map OpenGL buffer for CUDA access
+    CUDA_CHECK(cudaGraphicsMapResources(1, &cuda_vbo_resource_, stream_));
+
+    VertexData* d_vertices = nullptr;
+    size_t num_bytes = 0;
+    CUDA_CHECK(cudaGraphicsResourceGetMappedPointer(
+        (void**)&d_vertices,
+        &num_bytes,
+        cuda_vbo_resource_
+    ));
+
+    kernels::prepare_snapshot_vertices(d_positions, d_speed, d_force, d_vertices, count, config_, stream_);
+
+    // Unmap OpenGL buffer
+    CUDA_CHECK(cudaGraphicsUnmapResources(1, &cuda_vbo_resource_, stream_));
+
+    CUDA_CHECK(cudaEventRecord(stop, stream_));
+    CUDA_CHECK(cudaEventSynchronize(stop));
+
+    float milliseconds = 0;
+    CUDA_CHECK(cudaEventElapsedTime(&milliseconds, start, stop));
+    stats_.last_update_time_ms = milliseconds;
+    stats_.particle_count = count;
+
+    CUDA_CHECK(cudaEventDestroy(start));
+    CUDA_CHECK(cudaEventDestroy(stop));
+
+    return true;
+}
+
 void CudaRenderer::cleanup() {
     if (cuda_vbo_resource_) {
         unregister_gl_buffer();
@@ -350,6 +459,12 @@ bool CudaRenderer::allocate_device_memory() {
         particle_count_ * sizeof(barnes_hut::Particle)
     ));
 
+    // Snapshot arrays: 3 position floats, speed and force per particle
+    CUDA_CHECK(cudaMalloc(
+        &d_snapshot_,
+        particle_count_ * 5 * sizeof(float)
+    ));
+
     return true;
 }
 
@@ -358,6 +473,10 @@ void CudaRenderer::free_device_memory() {
         CUDA_CHECK_VOID(cudaFree(d_particles_));
         d_particles_ = nullptr;
     }
+    if (d_snapshot_) {
+        CUDA_CHECK_VOID(cudaFree(d_snapshot_));
+        d_snapshot_ = nullptr;
+    }
 }
 
 } // namespace visualization
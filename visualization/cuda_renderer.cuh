@@ -74,6 +74,23 @@ public:
         const Config& config
     );
 
+    /**
+     * @brief Update particle data from single-precision arrays (a RenderSnapshot)
+     * @param positions x, y, z per particle
+     * @param speed Velocity magnitude per particle
+     * @param force Force magnitude per particle
+     * @param count Number of particles
+     * @param config Rendering configuration
+     * @return true if update successful
+     */
+    bool update_snapshot(
+        const float* positions,
+        const float* speed,
+        const float* force,
+        size_t count,
+        const Config& config
+    );
+
     /**
      * @brief Get rendering configuration (mutable)
      */
@@ -100,6 +117,7 @@ public:
 private:
     // CUDA resources
     void* d_particles_;                    // Device particle data
+    float* d_snapshot_;                    // Device snapshot: positions, speed, force
     cudaGraphicsResource* cuda_vbo_resource_; // CUDA-GL interop resource
     cudaStream_t stream_;                  // CUDA stream for async operations
 
@@ -132,6 +150,23 @@ void prepare_particle_vertices(
     cudaStream_t stream
 );
 
+/**
+ * @brief Convert snapshot arrays to vertex data with color mapping
+ * @param positions x, y, z per particle
+ * @param speed Velocity magnitude per particle
+ * @param force Force magnitude per particle
+ * @param vertices Output vertex array (OpenGL buffer)
+ */
+void prepare_snapshot_vertices(
+    const float* positions,
+    const float* speed,
+    const float* force,
+    CudaRenderer::VertexData* vertices,
+    size_t count,
+    const CudaRenderer::Config& config,
+    cudaStream_t stream
+);
+
 /**
  * @brief Compute velocity statistics on GPU
  */
@@ -7,13 +7,23 @@
  * - CUDA-accelerated particle rendering
  * - OpenGL 4.5+ modern graphics pipeline
  * - Real-time interactive visualization
+ *
+ * The simulation runs on its own thread and publishes each new state through
+ * a SnapshotExchange; the render loop draws the latest published state, so
+ * neither waits for the other.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
+#include <string>
+#include <thread>
 #include <GLFW/glfw3.h>
 
 #include "file.h"
+#include "snapshot_exchange.h"
 #include "tree.h"
 #include "window_manager.h"
 #include "camera.h"
@@ -25,13 +35,16 @@ using namespace visualization;
 
 /**
  * @brief Application state and configuration
+ *
+ * The atomics are set by the input callbacks and read by the simulation thread.
  */
 struct AppState {
-    bool paused = false;
-    bool single_step = false;
+    std::atomic<bool> paused{false};
+    std::atomic<bool> single_step{false};
     bool show_help = false;
-    int simulation_speed = 1;  // Steps per frame
+    std::atomic<int> simulation_speed{1};  // Steps per published state
     float time_scale = 1.0f;
+    double target_fps = 0.0;   // > 0: deadline mode, theta adapts to hold this frame rate
 
     struct {
         bool color_by_velocity = true;
@@ -76,20 +89,31 @@ void display_statistics(
                   << "\rTime: " << std::setw(8) << current_time
                   << " | FPS: " << std::setw(6) << static_cast<int>(window.get_fps())
                   << " | Sim: " << std::setw(6) << sim_stats.time_total * 1000.0 << "ms"
-                  << " | Paused: " << (app_state.paused ? "YES" : "NO ")
-                  << " | Speed: " << app_state.simulation_speed << "x"
+                  << " | Theta: " << std::setw(5) << sim_stats.theta;
+        if (sim_stats.step_budget > 0.0) {
+            std::cout << " | Budget: " << std::setw(6) << sim_stats.step_budget * 1000.0 << "ms";
+        }
+        if (sim_stats.force_error > 0.0) {
+            std::cout << " | p99 error: " << std::scientific << std::setprecision(2) << sim_stats.force_error
+                      << std::fixed << std::setprecision(3);
+        }
+        std::cout << " | Paused: " << (app_state.paused ? "YES" : "NO ")
+                  << " | Speed: " << app_state.simulation_speed.load() << "x"
                   << std::flush;
     }
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cout << "Usage: " << argv[0] << " <filename> <theta> <particles_per_leaf>\n"
+    const bool fps_given = (argc == 6 && std::string(argv[4]) == "--fps");
+    if (argc != 4 && !fps_given) {
+        std::cout << "Usage: " << argv[0] << " <filename> <theta> <particles_per_leaf> [--fps <target>]\n"
                   << "  filename: Input file with particle data\n"
                   << "  theta: Barnes-Hut opening angle (e.g., 0.5)\n"
                   << "  particles_per_leaf: Max particles in leaf node (e.g., 10)\n"
+                  << "  --fps: Deadline mode; theta (0.2 to 1.0, bmax criterion) adapts so that every frame shows a new state\n"
                   << "\nExample:\n"
-                  << "  " << argv[0] << " data.dat 0.5 10\n";
+                  << "  " << argv[0] << " data.dat 0.5 10\n"
+                  << "  " << argv[0] << " data.dat 0.5 10 --fps 30\n";
         return 1;
     }
 
@@ -128,7 +152,11 @@ int main(int argc, char* argv[]) {
     std::cout << "  Simulation time: " << config.start_time << " -> " << config.end_time << "\n";
     std::cout << "  Time step: " << config.time_step << "\n";
     std::cout << "  Theta: " << theta << "\n";
-    std::cout << "  Particles per leaf: " << particles_per_leaf << "\n\n";
+    std::cout << "  Particles per leaf: " << particles_per_leaf << "\n";
+    if (fps_given) {
+        std::cout << "  Target frame rate: " << argv[5] << " FPS (theta adapts)\n";
+    }
+    std::cout << "\n";
 
     // ========================================================================
     // Initialize Visualization
@@ -270,39 +298,82 @@ int main(int argc, char* argv[]) {
     BarnesHutTree tree(particles, config.time_step, theta, particles_per_leaf);
 
     // ========================================================================
-    // Main Simulation and Rendering Loop
+    // Simulation Thread
     // ========================================================================
 
-    std::cout << "Starting visualization loop...\n\n";
+    if (fps_given) {
+        app_state.target_fps = std::stod(argv[5]);
+        if (!(app_state.target_fps > 0.0)) {
+            std::cerr << "Error: Target frame rate must be > 0\n";
+            return 1;
+        }
+    }
 
+    // The bmax criterion lets the deadline fitter use theta up to 1.0; the
+    // geometric one must stay below 1/sqrt(3) (BasicBarnesHutTree::max_safe_theta)
+    // The accuracy that buys is sampled every 10 steps
+    if (app_state.target_fps > 0.0) {
+        tree.set_opening_criterion(OpeningCriterion::MaxDistance);
+        tree.set_error_sampling(10);
+    }
+
+    // The first frames show the initial state
+    SnapshotExchange exchange(particle_count);
+    exchange.publish<NDIM>(particles, 0, config.start_time, tree.get_statistics());
+
+    // Owned by the simulation thread until it is joined
     Real current_time = config.start_time;
     Index step = 0;
 
-    while (!window.should_close() && current_time < config.end_time) {
-        window.begin_frame();
+    std::atomic<bool> stop_simulation{false};
+    std::atomic<bool> simulation_done{false};
 
-        // ====================================================================
-        // Simulation Step(s)
-        // ====================================================================
+    std::thread simulation([&] {
+        while (!stop_simulation.load(std::memory_order_relaxed) && current_time < config.end_time) {
+            const bool step_once = app_state.single_step.exchange(false);
+            if (app_state.paused && !step_once) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                continue;
+            }
+
+            // Deadline mode: a new state every frame. Rendering runs
+            // concurrently, so the steps get the whole frame time
+            const int speed = app_state.simulation_speed;
+            if (app_state.target_fps > 0.0) {
+                tree.set_step_budget(1.0 / (app_state.target_fps * speed));
+            }
 
-        if (!app_state.paused || app_state.single_step) {
-            for (int i = 0; i < app_state.simulation_speed; ++i) {
+            for (int i = 0; i < speed && current_time < config.end_time; ++i) {
                 tree.simulation_step();
+                tree.clear_tree();
                 current_time += config.time_step;
                 step++;
-
-                if (current_time >= config.end_time) {
-                    break;
-                }
             }
 
-            app_state.single_step = false;
-            tree.clear_tree();
+            exchange.publish<NDIM>(particles, step, current_time, tree.get_statistics());
         }
+        simulation_done.store(true, std::memory_order_release);
+    });
 
-        // ====================================================================
-        // Update Visualization
-        // ====================================================================
+    // ========================================================================
+    // Rendering Loop
+    // ========================================================================
+
+    std::cout << "Starting visualization loop...\n\n";
+
+    bool drawn_color_by_velocity = !app_state.render_config.color_by_velocity;  // Forces the first upload
+
+    while (!window.should_close()) {
+        // Read before acquire(): once the simulation is done, its last state
+        // is either acquired now or was drawn in an earlier frame
+        const bool simulation_finished = simulation_done.load(std::memory_order_acquire);
+        const bool fresh = exchange.acquire();
+        if (simulation_finished && !fresh) {
+            break;
+        }
+        const RenderSnapshot& snapshot = exchange.read_buffer();
+
+        window.begin_frame();
 
         // Update camera
         camera.update();
@@ -313,8 +384,12 @@ int main(int argc, char* argv[]) {
         cuda_config.color_by_force = app_state.render_config.color_by_force;
         cuda_config.point_size = app_state.render_config.point_size;
 
-        // Update particle data on GPU via CUDA
-        cuda_renderer.update_particles(particles.data(), particle_count, cuda_config);
+        // Upload a new state, or recolor the one on screen
+        if (fresh || cuda_config.color_by_velocity != drawn_color_by_velocity) {
+            cuda_renderer.update_snapshot(snapshot.positions.data(), snapshot.speed.data(),
+                                          snapshot.force.data(), snapshot.size(), cuda_config);
+            drawn_color_by_velocity = cuda_config.color_by_velocity;
+        }
 
         // Update OpenGL renderer camera
         gl_renderer.set_camera(
@@ -324,20 +399,24 @@ int main(int argc, char* argv[]) {
         );
 
         // Render particles
-        gl_renderer.render(particle_count);
+        gl_renderer.render(snapshot.size());
 
         // ====================================================================
         // Display Statistics
         // ====================================================================
 
-        display_statistics(tree.get_statistics(), window, app_state, current_time);
+        display_statistics(snapshot.statistics, window, app_state, snapshot.time);
 
         window.end_frame();
     }
 
+    stop_simulation.store(true, std::memory_order_relaxed);
+    simulation.join();
+
     std::cout << "\n\n=== Simulation Complete ===\n";
     std::cout << "Total steps: " << step << "\n";
     std::cout << "Final time: " << current_time << "\n";
+    std::cout << "States drawn: " << exchange.acquired() << " of " << exchange.published() << " published\n";
 
     // Cleanup
     cuda_renderer.cleanup();
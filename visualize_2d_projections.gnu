@@ -4,11 +4,16 @@
 # XY, XZ, YZ projections with hexagonal binning
 #
 
-set terminal pngcairo enhanced font "Arial,11" size 2400,800 background rgb 'black'
+# Data file format: mass x y z vx vy vz, or mass x y vx vy in 2D
+# (text or binary, see particle_data.gnu)
+load 'particle_data.gnu'
+
+# Multi-plot layout: 2D data has only the XY projection
+panels = (dimension == 2) ? 1 : 3
+set terminal pngcairo enhanced font "Arial,11" size 800*panels,800 background rgb 'black'
 set output 'particles_2d_projections.png'
 
-# Multi-plot layout
-set multiplot layout 1,3 title "Barnes-Hut Simulation - 2D Projections" \
+set multiplot layout 1,panels title "Barnes-Hut Simulation - 2D Projections" \
     textcolor rgb 'white' font "Arial,18"
 
 # Modern viridis-like palette
@@ -30,27 +35,30 @@ set ytics textcolor rgb 'white'
 set size square
 
 # Density plot with points colored by mass
-plot 'test.dat' skip 4 using 2:3:1 with points \
+plot @data using (@pos_x):(@pos_y):(@mass) with points \
     pointtype 7 pointsize 0.8 palette notitle
 
-#===============================================
-# XZ Projection
-#===============================================
-set title "XZ Projection" textcolor rgb 'white' font "Arial,14"
-set xlabel "X Position" textcolor rgb 'white'
-set ylabel "Z Position" textcolor rgb 'white'
+# XZ and YZ Projections (3D only)
+if (dimension == 3) {
+    #===============================================
+    # XZ Projection
+    #===============================================
+    set title "XZ Projection" textcolor rgb 'white' font "Arial,14"
+    set xlabel "X Position" textcolor rgb 'white'
+    set ylabel "Z Position" textcolor rgb 'white'
 
-plot 'test.dat' skip 4 using 2:4:1 with points \
-    pointtype 7 pointsize 0.8 palette notitle
+    plot @data using (@pos_x):(@pos_z):(@mass) with points \
+        pointtype 7 pointsize 0.8 palette notitle
 
-#===============================================
-# YZ Projection
-#===============================================
-set title "YZ Projection" textcolor rgb 'white' font "Arial,14"
-set xlabel "Y Position" textcolor rgb 'white'
-set ylabel "Z Position" textcolor rgb 'white'
+    #===============================================
+    # YZ Projection
+    #===============================================
+    set title "YZ Projection" textcolor rgb 'white' font "Arial,14"
+    set xlabel "Y Position" textcolor rgb 'white'
+    set ylabel "Z Position" textcolor rgb 'white'
 
-plot 'test.dat' skip 4 using 3:4:1 with points \
-    pointtype 7 pointsize 0.8 palette notitle
+    plot @data using (@pos_y):(@pos_z):(@mass) with points \
+        pointtype 7 pointsize 0.8 palette notitle
+}
 
 unset multiplot
@@ -39,13 +39,14 @@ set key outside right textcolor rgb 'white'
 # Using pointtype 7 (filled circle) with size based on mass
 set style fill transparent solid 0.6
 
-# Data file format: mass x y z vx vy vz
-# Skip first 4 lines (config data)
+# Data file format: mass x y z vx vy vz, or mass x y vx vy in 2D
+# (text or binary, see particle_data.gnu)
 set datafile commentschars "#"
+load 'particle_data.gnu'
 
 # 3D scatter plot with color mapping based on z-coordinate
-splot 'test.dat' skip 4 using 2:3:4:4 with points \
+splot @data using (@pos_x):(@pos_y):(@pos_z):(@pos_z) with points \
     pointtype 7 pointsize 0.5 \
     palette notitle, \
-    '' skip 4 using 2:3:4:(sprintf("%.0f", $1)) every 100 with labels \
+    @data using (@pos_x):(@pos_y):(@pos_z):(sprintf("%.0f", @mass)) every 100 with labels \
     textcolor rgb 'yellow' font "Arial,8" offset 1,1 notitle
@@ -3,6 +3,8 @@
 # Master visualization script for Barnes-Hut simulation
 # Generates all plots using Gnuplot 6
 #
+# Usage: ./visualize_all.sh [descriptor.gp]
+#
 
 echo "=== Barnes-Hut Visualization Suite ==="
 echo ""
@@ -18,8 +20,18 @@ GNUPLOT_VERSION=$(gnuplot --version | grep -oP '\d+\.\d+' | head -1)
 echo "Using gnuplot version: $GNUPLOT_VERSION"
 echo ""
 
+# Optional gnuplot binary descriptor (see particle_data.gnu)
+GNUPLOT_ARGS=()
+if [ -n "$1" ]; then
+    if [ ! -f "$1" ]; then
+        echo "Error: descriptor $1 not found"
+        exit 1
+    fi
+    echo "Using binary particle data described by: $1"
+    GNUPLOT_ARGS=(-e "descriptor='$1'")
+    echo ""
 # Check if data file exists
-if [ ! -f "test.dat" ]; then
+elif [ ! -f "test.dat" ]; then
     echo "Generating test data..."
     ./generate_data test.dat 1000 0.0 1.0 0.01
     echo ""
@@ -30,7 +42,7 @@ echo ""
 
 # 1. 3D Scatter Plot
 echo "[1/5] Creating 3D scatter plot..."
-gnuplot visualize_3d.gnu
+gnuplot "${GNUPLOT_ARGS[@]}" visualize_3d.gnu
 if [ $? -eq 0 ]; then
     echo "  ✓ particles_3d.png created"
 else
@@ -39,7 +51,7 @@ fi
 
 # 2. 2D Projections
 echo "[2/5] Creating 2D projections..."
-gnuplot visualize_2d_projections.gnu
+gnuplot "${GNUPLOT_ARGS[@]}" visualize_2d_projections.gnu
 if [ $? -eq 0 ]; then
     echo "  ✓ particles_2d_projections.png created"
 else
@@ -48,7 +60,7 @@ fi
 
 # 3. Density Heatmap
 echo "[3/5] Creating density heatmap..."
-gnuplot visualize_density_heatmap.gnu
+gnuplot "${GNUPLOT_ARGS[@]}" visualize_density_heatmap.gnu
 if [ $? -eq 0 ]; then
     echo "  ✓ particles_density_heatmap.png created"
 else
@@ -57,7 +69,7 @@ fi
 
 # 4. Velocity Field
 echo "[4/5] Creating velocity field..."
-gnuplot visualize_velocity_field.gnu
+gnuplot "${GNUPLOT_ARGS[@]}" visualize_velocity_field.gnu
 if [ $? -eq 0 ]; then
     echo "  ✓ particles_velocity_field.png created"
 else
@@ -69,7 +81,7 @@ read -p "[5/5] Create animation? (y/n): " -n 1 -r
 echo ""
 if [[ $REPLY =~ ^[Yy]$ ]]; then
     echo "Creating animation (this may take a while)..."
-    gnuplot visualize_animation.gnu
+    gnuplot "${GNUPLOT_ARGS[@]}" visualize_animation.gnu
     if [ $? -eq 0 ]; then
         echo "  ✓ particles_animation.gif created"
     else
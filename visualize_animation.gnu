@@ -10,15 +10,19 @@ set terminal gif animate delay 10 size 1200,1200 \
 
 set output 'particles_animation.gif'
 
+# Data file format: mass x y z vx vy vz, or mass x y vx vy in 2D
+# (text or binary, see particle_data.gnu)
+load 'particle_data.gnu'
+
 # Styling
 set border linecolor rgb 'white' linewidth 2
 set grid linecolor rgb '#404040' linewidth 1
 
 # Fixed ranges for consistent animation
-stats 'test.dat' skip 4 using 2 nooutput
+stats @data using (@pos_x) nooutput
 xmin = STATS_min
 xmax = STATS_max
-stats 'test.dat' skip 4 using 3 nooutput
+stats @data using (@pos_y) nooutput
 ymin = STATS_min
 ymax = STATS_max
 
@@ -48,7 +52,7 @@ do for [t=0:100:5] {
     angle = t * 3.6
     set view 60, angle
 
-    plot 'test.dat' skip 4 using 2:3:1 with points \
+    plot @data using (@pos_x):(@pos_y):(@mass) with points \
         pointtype 7 pointsize 1.0 palette notitle
 }
 
@@ -7,6 +7,10 @@
 set terminal pngcairo enhanced font "Arial,12" size 1600,1200 background rgb 'black'
 set output 'particles_density_heatmap.png'
 
+# Data file format: mass x y z vx vy vz, or mass x y vx vy in 2D
+# (text or binary, see particle_data.gnu)
+load 'particle_data.gnu'
+
 # Gnuplot 6 hexagonal binning for density estimation
 set view map
 set size ratio -1
@@ -39,10 +43,10 @@ set dgrid3d 50,50 qnorm 2
 set pm3d map interpolate 0,0
 
 # Plot with smoothed density
-splot 'test.dat' skip 4 using 2:3:(1) with pm3d notitle
+splot @data using (@pos_x):(@pos_y):(1) with pm3d notitle
 
 # Alternative: Point density visualization
 # unset dgrid3d
 # set style fill transparent solid 0.3
-# plot 'test.dat' skip 4 using 2:3 with points pointtype 7 pointsize 1 \
+# plot @data using (@pos_x):(@pos_y) with points pointtype 7 pointsize 1 \
 #     linecolor rgb '#fde724' notitle
@@ -30,13 +30,16 @@ set key textcolor rgb 'white'
 # Size ratio
 set size ratio -1
 
+# Data file format: mass x y z vx vy vz, or mass x y vx vy in 2D
+# (text or binary, see particle_data.gnu)
+load 'particle_data.gnu'
+
 # Arrow style for vectors
 set style arrow 1 head filled size screen 0.01,15 linewidth 1.5
 
 # Calculate velocity magnitude and plot vectors
-# Data format: mass x y z vx vy vz
 # Sample every Nth particle to avoid clutter
-plot 'test.dat' skip 4 every 10 using 2:3:(0.05*$5):(0.05*$6):(sqrt($5**2+$6**2)) \
+plot @data every 10 using (@pos_x):(@pos_y):(0.05*@vel_x):(0.05*@vel_y):(sqrt((@vel_x)**2+(@vel_y)**2)) \
     with vectors arrowstyle 1 palette title "Velocity Vectors", \
-    '' skip 4 every 10 using 2:3 with points \
+    @data every 10 using (@pos_x):(@pos_y) with points \
     pointtype 7 pointsize 0.5 linecolor rgb 'white' title "Particles"
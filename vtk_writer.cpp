@@ -0,0 +1,306 @@
+#include "vtk_writer.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace barnes_hut {
+
+namespace {
+
+// Values are copied into the appended section CHUNK elements at a time
+constexpr Index CHUNK = Index{1} << 14;
+
+// VTK cell types
+constexpr std::uint8_t VTK_VERTEX = 1;
+constexpr std::uint8_t VTK_PIXEL = 8;
+constexpr std::uint8_t VTK_VOXEL = 11;
+
+template <typename T> constexpr std::string_view vtk_type();
+template <> constexpr std::string_view vtk_type<double>() { return "Float64"; }
+template <> constexpr std::string_view vtk_type<std::int32_t>() { return "Int32"; }
+template <> constexpr std::string_view vtk_type<std::int64_t>() { return "Int64"; }
+template <> constexpr std::string_view vtk_type<std::uint64_t>() { return "UInt64"; }
+template <> constexpr std::string_view vtk_type<std::uint8_t>() { return "UInt8"; }
+
+// DataArray elements of the XML header, with the offsets of their data in
+// the appended section; arrays must be appended in the order they are listed
+class AppendedLayout {
+public:
+    template <typename T>
+    std::string array(std::string_view name, int components, Index count) {
+        std::ostringstream element;
+        element << "<DataArray type=\"" << vtk_type<T>() << "\" Name=\"" << name << "\"";
+        if (components > 1) {
+            element << " NumberOfComponents=\"" << components << "\"";
+        }
+        element << " format=\"appended\" offset=\"" << offset_ << "\"/>\n";
+        offset_ += sizeof(std::uint64_t) + count * components * sizeof(T);
+        return element.str();
+    }
+
+private:
+    std::uint64_t offset_ = 0;
+};
+
+// Append an array of count elements: its byte count, then the components
+// value(i, out) stores for each element i, filled in parallel chunk by chunk
+template <typename T, typename Value>
+void append_array(std::ostream& outfile, Index count, int components, Value value) {
+    const std::uint64_t bytes = count * components * sizeof(T);
+    outfile.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+
+    std::vector<T> buffer(std::min(count, CHUNK) * components);
+    for (Index begin = 0; begin < count; begin += CHUNK) {
+        const Index chunk = std::min(count - begin, CHUNK);
+
+        #ifdef _OPENMP
+        #pragma omp parallel for
+        #endif
+        for (Index i = 0; i < chunk; ++i) {
+            value(begin + i, buffer.data() + i * components);
+        }
+
+        outfile.write(reinterpret_cast<const char*>(buffer.data()),
+                      static_cast<std::streamsize>(chunk * components * sizeof(T)));
+    }
+}
+
+template <int Dim>
+void store_vector(const BasicVector<Dim>& vector, double* out) noexcept {
+    for (int k = 0; k < 3; ++k) {
+        out[k] = k < Dim ? vector[k] : 0.0;
+    }
+}
+
+void write_vtu_header(std::ostream& outfile) {
+    outfile << "<?xml version=\"1.0\"?>\n"
+            << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\""
+            << (std::endian::native == std::endian::little ? "LittleEndian" : "BigEndian")
+            << "\" header_type=\"UInt64\">\n"
+            << "<UnstructuredGrid>\n";
+}
+
+void begin_appended_data(std::ostream& outfile) {
+    outfile << "</Piece>\n"
+            << "</UnstructuredGrid>\n"
+            << "<AppendedData encoding=\"raw\">\n_";
+}
+
+bool end_appended_data(std::ofstream& outfile, std::string_view filename) {
+    outfile << "\n</AppendedData>\n"
+            << "</VTKFile>\n";
+    if (!outfile) {
+        std::cerr << "Error: Failed writing output file: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+template <int Dim>
+bool write_vtu_particles_impl(std::string_view filename, std::span<const BasicParticle<Dim>> particles) {
+    std::ofstream outfile(std::string(filename), std::ios::binary);
+    if (!outfile) {
+        std::cerr << "Error: Could not create output file: " << filename << "\n";
+        return false;
+    }
+
+    const Index n = particles.size();
+    AppendedLayout layout;
+
+    write_vtu_header(outfile);
+    outfile << "<Piece NumberOfPoints=\"" << n << "\" NumberOfCells=\"" << n << "\">\n"
+            << "<PointData Scalars=\"mass\" Vectors=\"velocity\">\n"
+            << layout.array<double>("mass", 1, n)
+            << layout.array<double>("velocity", 3, n)
+            << layout.array<double>("force", 3, n)
+            << layout.array<std::uint64_t>("id", 1, n)
+            << "</PointData>\n"
+            << "<Points>\n"
+            << layout.array<double>("position", 3, n)
+            << "</Points>\n"
+            << "<Cells>\n"
+            << layout.array<std::int64_t>("connectivity", 1, n)
+            << layout.array<std::int64_t>("offsets", 1, n)
+            << layout.array<std::uint8_t>("types", 1, n)
+            << "</Cells>\n";
+    begin_appended_data(outfile);
+
+    append_array<double>(outfile, n, 1, [&](Index i, double* out) { *out = particles[i].mass(); });
+    append_array<double>(outfile, n, 3, [&](Index i, double* out) { store_vector(particles[i].velocity(), out); });
+    append_array<double>(outfile, n, 3, [&](Index i, double* out) { store_vector(particles[i].force(), out); });
+    append_array<std::uint64_t>(outfile, n, 1, [&](Index i, std::uint64_t* out) { *out = particles[i].id(); });
+    append_array<double>(outfile, n, 3, [&](Index i, double* out) { store_vector(particles[i].position(), out); });
+    append_array<std::int64_t>(outfile, n, 1, [](Index i, std::int64_t* out) { *out = i; });
+    append_array<std::int64_t>(outfile, n, 1, [](Index i, std::int64_t* out) { *out = i + 1; });
+    append_array<std::uint8_t>(outfile, n, 1, [](Index, std::uint8_t* out) { *out = VTK_VERTEX; });
+
+    if (!end_appended_data(outfile, filename)) {
+        return false;
+    }
+
+    std::cout << "Wrote VTK particles to: " << filename << "\n";
+    return true;
+}
+
+template <int Dim>
+bool write_vtu_tree_impl(std::string_view filename, const BasicNode<Dim>* root) {
+    using Node = BasicNode<Dim>;
+
+    // Pixel and voxel corners: bit k of the corner index selects the upper
+    // bound along axis k
+    constexpr Index corners = Index{1} << Dim;
+
+    // The non-empty nodes in the order draw_node_boxes visits them
+    std::vector<const Node*> nodes;
+    std::vector<const Node*> pending;
+    if (root) {
+        pending.push_back(root);
+    }
+    while (!pending.empty()) {
+        const Node* node = pending.back();
+        pending.pop_back();
+        if (node->type == NodeType::Empty) {
+            continue;
+        }
+
+        nodes.push_back(node);
+        for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+            if (*child) {
+                pending.push_back(*child);
+            }
+        }
+    }
+
+    std::ofstream outfile(std::string(filename), std::ios::binary);
+    if (!outfile) {
+        std::cerr << "Error: Could not create output file: " << filename << "\n";
+        return false;
+    }
+
+    const Index cells = nodes.size();
+    const Index points = cells * corners;
+    AppendedLayout layout;
+
+    write_vtu_header(outfile);
+    outfile << "<Piece NumberOfPoints=\"" << points << "\" NumberOfCells=\"" << cells << "\">\n"
+            << "<CellData Scalars=\"level\">\n"
+            << layout.array<std::int32_t>("level", 1, cells)
+            << layout.array<double>("mass", 1, cells)
+            << layout.array<std::uint64_t>("particle_count", 1, cells)
+            << "</CellData>\n"
+            << "<Points>\n"
+            << layout.array<double>("position", 3, points)
+            << "</Points>\n"
+            << "<Cells>\n"
+            << layout.array<std::int64_t>("connectivity", 1, points)
+            << layout.array<std::int64_t>("offsets", 1, cells)
+            << layout.array<std::uint8_t>("types", 1, cells)
+            << "</Cells>\n";
+    begin_appended_data(outfile);
+
+    append_array<std::int32_t>(outfile, cells, 1, [&](Index i, std::int32_t* out) {
+        *out = static_cast<std::int32_t>(nodes[i]->level);
+    });
+    append_array<double>(outfile, cells, 1, [&](Index i, double* out) { *out = nodes[i]->mass; });
+    append_array<std::uint64_t>(outfile, cells, 1, [&](Index i, std::uint64_t* out) {
+        *out = nodes[i]->particle_count;
+    });
+    append_array<double>(outfile, points, 3, [&](Index i, double* out) {
+        const Node& node = *nodes[i / corners];
+        const Index corner = i % corners;
+        const Real half_size = node.size / 2.0;
+        for (int k = 0; k < 3; ++k) {
+            out[k] = k < Dim ? node.geo_center[k] + (((corner >> k) & 1) ? half_size : -half_size) : 0.0;
+        }
+    });
+    append_array<std::int64_t>(outfile, points, 1, [](Index i, std::int64_t* out) { *out = i; });
+    append_array<std::int64_t>(outfile, cells, 1, [](Index i, std::int64_t* out) { *out = (i + 1) * corners; });
+    append_array<std::uint8_t>(outfile, cells, 1, [](Index, std::uint8_t* out) {
+        *out = Dim == 3 ? VTK_VOXEL : VTK_PIXEL;
+    });
+
+    if (!end_appended_data(outfile, filename)) {
+        return false;
+    }
+
+    std::cout << "Wrote VTK tree boxes to: " << filename << " (" << cells << " nodes)\n";
+    return true;
+}
+
+} // namespace
+
+bool write_vtu_particles(std::string_view filename, std::span<const Particle2D> particles) {
+    return write_vtu_particles_impl(filename, particles);
+}
+
+bool write_vtu_particles(std::string_view filename, std::span<const Particle3D> particles) {
+    return write_vtu_particles_impl(filename, particles);
+}
+
+bool write_vtu_tree(std::string_view filename, const Node2D* root) {
+    return write_vtu_tree_impl(filename, root);
+}
+
+bool write_vtu_tree(std::string_view filename, const Node3D* root) {
+    return write_vtu_tree_impl(filename, root);
+}
+
+void PvdSeries::resume(Real time) {
+    entries_.clear();
+
+    std::ifstream infile(filename_);
+    std::string line;
+    while (std::getline(infile, line)) {
+        const auto start = line.find("<DataSet ");
+        const auto timestep = line.find("timestep=\"", start);
+        if (start == std::string::npos || timestep == std::string::npos) {
+            continue;
+        }
+        if (std::strtod(line.c_str() + timestep + 10, nullptr) <= time) {
+            entries_.push_back(line.substr(start));
+        }
+    }
+}
+
+bool PvdSeries::add(Real time, std::string_view dataset, int part) {
+    // Shortest round-trip form, so resume() compares exact times
+    char timestep[32];
+    const auto end = std::to_chars(timestep, timestep + sizeof(timestep), time).ptr;
+
+    std::ostringstream entry;
+    entry << "<DataSet timestep=\"" << std::string_view(timestep, end - timestep)
+          << "\" part=\"" << part << "\" file=\"" << dataset << "\"/>";
+    entries_.push_back(entry.str());
+
+    return write();
+}
+
+bool PvdSeries::write() const {
+    std::ofstream outfile(filename_);
+    if (!outfile) {
+        std::cerr << "Error: Could not create output file: " << filename_ << "\n";
+        return false;
+    }
+
+    outfile << "<?xml version=\"1.0\"?>\n"
+            << "<VTKFile type=\"Collection\" version=\"1.0\">\n"
+            << "<Collection>\n";
+    for (const auto& entry : entries_) {
+        outfile << "  " << entry << "\n";
+    }
+    outfile << "</Collection>\n"
+            << "</VTKFile>\n";
+
+    if (!outfile) {
+        std::cerr << "Error: Failed writing output file: " << filename_ << "\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace barnes_hut
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "particle.h"
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace barnes_hut {
+
+// VTK XML unstructured grid (.vtu) files for ParaView.
+//
+// Array data goes to a raw appended section (UInt64 byte-count headers,
+// native byte order) in the order the XML header lists the arrays. Values
+// are copied from the particles or nodes in chunks straight into that
+// section: one O(N) pass with no number formatting. 2D data is written
+// with z = 0, as VTK points and vectors always have three components.
+
+// Particles as vertex cells with the point arrays mass, velocity, force and id
+bool write_vtu_particles(std::string_view filename, std::span<const Particle2D> particles);
+bool write_vtu_particles(std::string_view filename, std::span<const Particle3D> particles);
+
+// Boxes of the non-empty tree nodes below root (the nodes
+// QuadtreeVisualizer::draw_node_boxes draws) as voxel cells, pixel cells
+// in 2D, with the cell arrays level, mass and particle_count
+bool write_vtu_tree(std::string_view filename, const Node2D* root);
+bool write_vtu_tree(std::string_view filename, const Node3D* root);
+
+// ParaView time series index (.pvd).
+//
+// Every add() rewrites the index, so it is complete after each snapshot.
+// Datasets of one time with different parts (e.g. particles and tree boxes)
+// appear as one multiblock data set.
+class PvdSeries {
+public:
+    explicit PvdSeries(std::string filename) : filename_(std::move(filename)) {}
+
+    // Keep the datasets an existing index lists up to time (resuming a run)
+    void resume(Real time);
+
+    bool add(Real time, std::string_view dataset, int part = 0);
+
+    [[nodiscard]] const std::string& filename() const noexcept { return filename_; }
+
+private:
+    bool write() const;
+
+    std::string filename_;
+    std::vector<std::string> entries_;  // DataSet elements
+};
+
+} // namespace barnes_hut